@@ -4,25 +4,62 @@
 
 #include <sys/types.h>
 #include <sys/socket.h>
+#include <sys/stat.h>
 #include <errno.h>
 #include <unistd.h>
 
-static int createNonblocking()
+static int createNonblocking(sa_family_t family)
 {
-    int sockfd = ::socket(AF_INET, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+    int sockfd = ::socket(family, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
     if (sockfd < 0)
     {
         LOG_FATAL("%s:%s:%d listen socket create err:%d \n", __FILE__, __FUNCTION__, __LINE__, errno);
     }
+    return sockfd;
+}
+
+// [socket文件是不是上次留下的]  connect被拒绝(ECONNREFUSED)说明没有进程在上面listen；
+// 连上了、队列满(EAGAIN)或者其他错误都当作还在用，不能删
+static bool isStaleUnixSocket(const InetAddress &addr)
+{
+    int fd = ::socket(AF_UNIX, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+    if (fd < 0)
+    {
+        return false;
+    }
+    bool stale = ::connect(fd, addr.getSockAddr(), addr.getSockLen()) < 0 && errno == ECONNREFUSED;
+    ::close(fd);
+    return stale;
 }
 
 Acceptor::Acceptor(EventLoop *loop, const InetAddress &listenAddr, bool reuseport)
-    : loop_(loop), acceptSocket_(createNonblocking()) // 创建了一个非阻塞的sockfd封装为socket
+    : loop_(loop), acceptSocket_(createNonblocking(listenAddr.family())) // 创建了一个非阻塞的sockfd封装为socket
       ,
-      acceptChannel_(loop, acceptSocket_.fd()), listenning_(false)
+      acceptChannel_(loop, acceptSocket_.fd()), listenning_(false), unix_(listenAddr.isUnix())
 {
-    acceptSocket_.setReuseAddr(true);
-    acceptSocket_.setReusePort(true);
+    if (listenAddr.isUnix())
+    {
+        // 文件路径的Unix域socket：上次进程没删掉的socket文件会让bind失败，确认没人在听才删；抽象命名空间不用
+        std::string path = listenAddr.unixPath();
+        struct stat st;
+        if (!path.empty() && path[0] != '@')
+        {
+            if (::stat(path.c_str(), &st) == 0 && S_ISSOCK(st.st_mode))
+            {
+                if (!isStaleUnixSocket(listenAddr))
+                {
+                    LOG_FATAL("%s:%s:%d %s is in use by another server \n", __FILE__, __FUNCTION__, __LINE__, path.c_str());
+                }
+                ::unlink(path.c_str());
+            }
+            unixPath_ = path;
+        }
+    }
+    else
+    {
+        acceptSocket_.setReuseAddr(true);
+        acceptSocket_.setReusePort(true);
+    }
     acceptSocket_.bindAddress(listenAddr); // bind
     // TcpServer::start() Acceptor.listen  有新用户的连接，要执行一个回调（connfd=》channel=》subloop）
     // baseLoop => acceptChannel_(listenfd) =>
@@ -33,12 +70,25 @@ Acceptor::~Acceptor()
 {
     acceptChannel_.disableAll(); //把aceeptChannel从base loop的poller取消注册读写事件了
     acceptChannel_.remove();     //从poller中删除
+    if (!unixPath_.empty())
+    {
+        ::unlink(unixPath_.c_str());
+    }
 }
 
-void Acceptor::listen()
+void Acceptor::listen(const ListenOptions &options)
 {
     listenning_ = true;
-    acceptSocket_.listen();         // listen开始监听
+    if (!unix_ && options.deferAcceptSeconds > 0 && !acceptSocket_.setDeferAccept(options.deferAcceptSeconds))
+    {
+        LOG_ERROR("%s:%s:%d TCP_DEFER_ACCEPT err:%d \n", __FILE__, __FUNCTION__, __LINE__, errno);
+    }
+    // TCP_FASTOPEN要在listen之前设置
+    if (!unix_ && options.fastOpenQueue > 0 && !acceptSocket_.setFastOpen(options.fastOpenQueue))
+    {
+        LOG_ERROR("%s:%s:%d TCP_FASTOPEN err:%d \n", __FILE__, __FUNCTION__, __LINE__, errno);
+    }
+    acceptSocket_.listen(options.backlog); // listen开始监听
     acceptChannel_.enableReading(); // 把acceptChannel_ 注册到Poller里面才能监听
 }
 
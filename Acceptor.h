@@ -4,10 +4,24 @@
 #include "Channel.h"
 
 #include <functional>
+#include <string>
 
 class EventLoop;
 class InetAddress;
 
+/**
+ * [监听socket的选项]  TcpServer在start时交给Acceptor::listen。
+ * TCP_DEFER_ACCEPT和TCP_FASTOPEN只对TCP有效，Unix域socket上忽略
+ */
+struct ListenOptions
+{
+    ListenOptions() : backlog(1024), deferAcceptSeconds(0), fastOpenQueue(0) {}
+
+    int backlog;            // listen的全连接队列长度，超过net.core.somaxconn时按somaxconn算
+    int deferAcceptSeconds; // >0时打开TCP_DEFER_ACCEPT：连接带着第一批数据才唤醒acceptor
+    int fastOpenQueue;      // >0时打开TCP_FASTOPEN；还要net.ipv4.tcp_fastopen打开服务端(0x2)
+};
+
 class Acceptor : noncopyable
 {
 public:
@@ -21,7 +35,7 @@ public:
     }
 
     bool listenning() const { return listenning_; }
-    void listen();
+    void listen(const ListenOptions &options = ListenOptions());
 
 private:
     void handleRead();
@@ -32,4 +46,6 @@ private:
     Channel acceptChannel_;                       //
     NewConnectionCallback newConnectionCallback_; //处理新连接的回调函数
     bool listenning_;
+    std::string unixPath_; // 绑在文件路径上的Unix域socket，析构时删掉socket文件
+    bool unix_;
 };
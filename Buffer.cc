@@ -1,9 +1,33 @@
 #include "Buffer.h"
+#include "SimdScan.h"
 
 #include <errno.h>
 #include <sys/uio.h>
 #include <unistd.h>
 
+const char Buffer::kCRLF[] = "\r\n";
+
+// [查找都转发给SimdScan]，运行时按CPU选择AVX2/SSE2/标量实现
+const char *Buffer::find(const char *start, char c) const
+{
+    return simd::findChar(start, beginWrite(), c);
+}
+
+const char *Buffer::find(const char *start, const char *delim, size_t delimLen) const
+{
+    return simd::findDelim(start, beginWrite(), delim, delimLen);
+}
+
+const char *Buffer::findFirstOf(const char *start, const simd::CharClass &cc) const
+{
+    return simd::findFirstOf(start, beginWrite(), cc);
+}
+
+const char *Buffer::findFirstNotOf(const char *start, const simd::CharClass &cc) const
+{
+    return simd::findFirstNotOf(start, beginWrite(), cc);
+}
+
 /**
  * 从fd上读取数据  Poller工作在LT模式:底层数据没有如果没读完，poller会一直触发
  * Buffer缓冲区是有大小的！ 但是从fd上读数据的时候，却不知道tcp数据最终的大小,如何处理？
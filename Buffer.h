@@ -4,6 +4,13 @@
 #include <string>
 #include <algorithm>
 
+#include "StringPiece.h"
+
+namespace simd
+{
+    class CharClass;
+}
+
 // [网络库底层的缓冲器类型定义]
 class Buffer
 {
@@ -18,6 +25,14 @@ public:
     {
     }
 
+    // [交换底层存储]  不拷贝数据，比如把一整块响应的所有权交给TcpConnection
+    void swap(Buffer &rhs)
+    {
+        buffer_.swap(rhs.buffer_);
+        std::swap(readerIndex_, rhs.readerIndex_);
+        std::swap(writerIndex_, rhs.writerIndex_);
+    }
+
     size_t readableBytes() const //可读数据长度
     {
         return writerIndex_ - readerIndex_;
@@ -33,12 +48,56 @@ public:
         return readerIndex_;
     }
 
+    size_t capacity() const // 底层实际占用的内存，统计用
+    {
+        return buffer_.capacity();
+    }
+
     // [返回缓冲区中可读数据的起始地址]
     const char *peek() const
     {
         return begin() + readerIndex_;
     }
 
+    // [可读数据的只读视图，不拷贝]  视图在下一次retrieve/append/readFd之前有效
+    StringPiece toStringPiece() const
+    {
+        return StringPiece(peek(), readableBytes());
+    }
+
+    // [可读区里面从offset开始、长度len的切片]，越界部分截断
+    StringPiece slice(size_t offset, size_t len) const
+    {
+        return toStringPiece().substr(offset, len);
+    }
+
+    // [查找"\r\n"]  返回\r的位置，找不到返回nullptr
+    const char *findCRLF() const
+    {
+        return find(peek(), kCRLF, 2);
+    }
+    const char *findCRLF(const char *start) const
+    {
+        return find(start, kCRLF, 2);
+    }
+
+    // [查找'\n']  单字节直接用memchr
+    const char *findEOL() const
+    {
+        return find(peek(), '\n');
+    }
+    const char *findEOL(const char *start) const
+    {
+        return find(start, '\n');
+    }
+
+    // [从start开始在可读区里查找字符c/分隔符delim]  start必须在[peek(), beginWrite()]之间
+    const char *find(const char *start, char c) const;
+    const char *find(const char *start, const char *delim, size_t delimLen) const;
+    // [字符类扫描]  比如找头部里的':'或者跳过空白" \t"
+    const char *findFirstOf(const char *start, const simd::CharClass &cc) const;
+    const char *findFirstNotOf(const char *start, const simd::CharClass &cc) const;
+
     // onMessage string <- Buffer
     void retrieve(size_t len)
     {
@@ -54,6 +113,12 @@ public:
         }
     }
 
+    // [把[peek(), end)这段数据标记为已读]  配合findCRLF/findEOL使用，解析完一行只移动下标
+    void retrieveUntil(const char *end)
+    {
+        retrieve(end - peek());
+    }
+
     void retrieveAll() //数据读取后，缓冲区进行复位操作
     {
         readerIndex_ = writerIndex_ = kCheapPrepend;
@@ -90,6 +155,12 @@ public:
         writerIndex_ += len;
     }
 
+    // string和字符串常量都可以隐式转成StringPiece
+    void append(const StringPiece &str)
+    {
+        append(str.data(), str.size());
+    }
+
     char *beginWrite()
     {
         return begin() + writerIndex_;
@@ -99,6 +170,12 @@ public:
     {
         return begin() + writerIndex_;
     }
+
+    // 直接往beginWrite()写了len字节以后调用(比如SSL_read解密到这里)
+    void hasWritten(size_t len)
+    {
+        writerIndex_ += len;
+    }
 //把读取数据和写数据的操作封装到buffer类里面了
     // 【从fd上读取数据】
     ssize_t readFd(int fd, int *saveErrno);
@@ -106,6 +183,8 @@ public:
     ssize_t writeFd(int fd, int *saveErrno);
 
 private:
+    static const char kCRLF[];
+
     char *begin()
     {
         // vector底层数组首元素的地址，也就是数组的起始地址
@@ -2,6 +2,7 @@
 
 #include <memory>
 #include <functional>
+#include <stdint.h>
 //下面定义指针和引用，所以需要类的前置声明
 class Buffer;
 class TcpConnection;
@@ -18,3 +19,5 @@ using MessageCallback = std::function<void(const TcpConnectionPtr &, Buffer *, T
 //@@@@@[有读写消息时候的回调函数]
 using HighWaterMarkCallback = std::function<void(const TcpConnectionPtr &, size_t)>;
 //高水位的回调函数
+
+using TimerId = uint64_t; // 定时器的标识，EventLoop::cancel用
@@ -53,7 +53,7 @@ void Channel::handleEvent(Timestamp receiveTime)
 // 根据poller通知的channel发生的具体事件， 由channel负责调用具体的回调操作
 void Channel::handleEventWithGuard(Timestamp receiveTime)
 {
-    LOG_INFO("channel handleEvent revents:%d\n", revents_);
+    LOG_DEBUG("channel handleEvent revents:%d\n", revents_);
     if ((revents_ & EPOLLHUP) && !(revents_ & EPOLLIN)) //出问题了,调用closeCallback
     {
         if (closeCallback_)
@@ -29,11 +29,13 @@ public:
     void setErrorCallback(EventCallback cb) { errorCallback_ = std::move(cb); }
 
     // 【防止当channel被手动remove掉，channel还在执行回调操作】
+    // 每次handleEvent都要lock一次weak_ptr(原子操作)；由loop保证生命周期的对象(比如TcpConnection)不用tie
     void tie(const std::shared_ptr<void> &);
 
     int fd() const { return fd_; }
     int events() const { return events_; }
-    int set_revents(int revt) { revents_ = revt; } // poller监听后设置事件
+    int revents() const { return revents_; }
+    void set_revents(int revt) { revents_ = revt; } // poller监听后设置事件
 
     // [设置fd相应的事件状态]:enable使能 ，disable使不能
     void enableReading()
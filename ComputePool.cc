@@ -0,0 +1,197 @@
+#include "ComputePool.h"
+#include "EventLoop.h"
+#include "Logger.h"
+#include "Timestamp.h"
+
+
+namespace
+{
+    std::atomic<uint64_t> s_poolCount(0);
+
+    // [最近一次submit用的inbox]  IO loop线程总是往自己的loop投，基本都能命中
+    struct InboxCache
+    {
+        uint64_t poolId = 0;
+        EventLoop *loop = nullptr;
+        std::weak_ptr<void> inbox;
+    };
+    thread_local InboxCache t_inboxCache;
+}
+
+void ComputePool::Histogram::add(int64_t us)
+{
+    count.fetch_add(1, std::memory_order_relaxed);
+    sum.fetch_add(us, std::memory_order_relaxed);
+    int64_t old = max.load(std::memory_order_relaxed);
+    while (us > old && !max.compare_exchange_weak(old, us, std::memory_order_relaxed))
+    {
+    }
+}
+
+double ComputePool::Histogram::avg() const
+{
+    uint64_t n = count.load(std::memory_order_relaxed);
+    return n == 0 ? 0.0 : static_cast<double>(sum.load(std::memory_order_relaxed)) / n;
+}
+
+ComputePool::ComputePool(const std::string &name)
+    : name_(name),
+      id_(++s_poolCount),
+      maxQueueSize_(kDefaultMaxQueueSize),
+      executor_(name),
+      started_(false),
+      pending_(0),
+      submitted_(0),
+      rejected_(0),
+      doneStats_(std::make_shared<DoneStats>())
+{
+    executor_.setThreadNum(0);
+}
+
+ComputePool::~ComputePool()
+{
+    if (started_)
+    {
+        stop();
+    }
+}
+
+void ComputePool::start()
+{
+    executor_.start();
+    started_ = true;
+}
+
+void ComputePool::stop()
+{
+    started_ = false;
+    executor_.stop(); // 拒绝新的submit，队列里剩下的work都会执行，done照常投递
+}
+
+std::shared_ptr<ComputePool::Inbox> ComputePool::inboxFor(EventLoop *loop)
+{
+    InboxCache &cache = t_inboxCache;
+    if (cache.poolId == id_ && cache.loop == loop)
+    {
+        std::shared_ptr<void> cached = cache.inbox.lock();
+        if (cached)
+        {
+            return std::static_pointer_cast<Inbox>(cached);
+        }
+    }
+    std::shared_ptr<Inbox> inbox;
+    {
+        std::unique_lock<std::mutex> lock(mutex_);
+        std::shared_ptr<Inbox> &slot = inboxes_[loop];
+        if (!slot)
+        {
+            slot = std::make_shared<Inbox>(loop, doneStats_);
+        }
+        inbox = slot;
+    }
+    cache.poolId = id_;
+    cache.loop = loop;
+    cache.inbox = inbox;
+    return inbox;
+}
+
+bool ComputePool::submit(EventLoop *loop, Task work, Task done)
+{
+    bool accepted = started_.load(std::memory_order_relaxed);
+    if (accepted && pending_.fetch_add(1, std::memory_order_relaxed) >= maxQueueSize_)
+    {
+        pending_.fetch_sub(1, std::memory_order_relaxed);
+        accepted = false;
+    }
+    if (!accepted)
+    {
+        rejected_.fetch_add(1, std::memory_order_relaxed);
+        LOG_DEBUG("ComputePool %s rejected a task \n", name_.c_str());
+        return false;
+    }
+    submitted_.fetch_add(1, std::memory_order_relaxed);
+
+    std::shared_ptr<Inbox> inbox = inboxFor(loop);
+    int64_t submitTime = Timestamp::monotonicMicros();
+    // std::function要求可拷贝，work/done放进shared_ptr里带过去，不拷贝用户的可调用对象
+    std::shared_ptr<std::pair<Task, Task>> job = std::make_shared<std::pair<Task, Task>>(std::move(work), std::move(done));
+    if (!executor_.submit([this, job, inbox, submitTime]()
+                          { runJob(job->first, job->second, inbox, submitTime); }))
+    {
+        // 没start，或者和stop()撞上了：started_是relaxed读的，以executor的结果为准
+        pending_.fetch_sub(1, std::memory_order_relaxed);
+        submitted_.fetch_sub(1, std::memory_order_relaxed);
+        rejected_.fetch_add(1, std::memory_order_relaxed);
+        return false;
+    }
+    return true;
+}
+
+size_t ComputePool::queueSize() const
+{
+    return pending_.load(std::memory_order_relaxed);
+}
+
+// 在计算线程里执行
+void ComputePool::runJob(Task &work, Task &done, const std::shared_ptr<Inbox> &inbox, int64_t submitTime)
+{
+    pending_.fetch_sub(1, std::memory_order_relaxed);
+    int64_t start = Timestamp::monotonicMicros();
+    queueTime_.add(start - submitTime);
+    if (work)
+    {
+        work();
+    }
+    runTime_.add(Timestamp::monotonicMicros() - start);
+
+    // 这个loop的收件箱原来是空的才需要投递一次drain，否则前面投递的那次会一起取走
+    bool first;
+    {
+        std::unique_lock<std::mutex> lock(inbox->mutex);
+        first = inbox->done.empty();
+        inbox->done.push_back(std::make_pair(std::move(done), submitTime));
+    }
+    if (first)
+    {
+        std::shared_ptr<Inbox> holder = inbox;
+        inbox->loop->queueInLoop([holder]()
+                                 { drainInbox(holder); });
+    }
+}
+
+// 在inbox->loop线程里执行，只通过inbox访问状态
+void ComputePool::drainInbox(const std::shared_ptr<Inbox> &inbox)
+{
+    std::vector<std::pair<Task, int64_t>> done;
+    {
+        std::unique_lock<std::mutex> lock(inbox->mutex);
+        done.swap(inbox->done);
+    }
+    DoneStats &stats = *inbox->stats;
+    stats.batches.fetch_add(1, std::memory_order_relaxed);
+    for (std::pair<Task, int64_t> &item : done)
+    {
+        if (item.first)
+        {
+            item.first();
+        }
+        stats.totalTime.add(Timestamp::monotonicMicros() - item.second);
+    }
+}
+
+ComputePool::Stats ComputePool::stats() const
+{
+    Stats s;
+    s.submitted = submitted_.load(std::memory_order_relaxed);
+    s.rejected = rejected_.load(std::memory_order_relaxed);
+    s.completed = doneStats_->totalTime.count.load(std::memory_order_relaxed);
+    s.batches = doneStats_->batches.load(std::memory_order_relaxed);
+    s.queueDepth = queueSize();
+    s.avgQueueUs = queueTime_.avg();
+    s.maxQueueUs = static_cast<double>(queueTime_.max.load(std::memory_order_relaxed));
+    s.avgRunUs = runTime_.avg();
+    s.maxRunUs = static_cast<double>(runTime_.max.load(std::memory_order_relaxed));
+    s.avgTotalUs = doneStats_->totalTime.avg();
+    s.maxTotalUs = static_cast<double>(doneStats_->totalTime.max.load(std::memory_order_relaxed));
+    return s;
+}
@@ -0,0 +1,114 @@
+#pragma once
+
+#include "noncopyable.h"
+#include "WorkStealingExecutor.h"
+
+#include <atomic>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <vector>
+#include <stdint.h>
+
+class EventLoop;
+
+/**
+ * [计算线程池]  把压缩、加解密、JSON这类耗CPU的活从subloop里挪出去，避免一个慢请求卡住loop上所有连接。
+ * - submit(loop, work, done): work在计算线程执行，done回到loop线程执行
+ * - 底层是WorkStealingExecutor，没有全局队列锁；work里可以通过executor()->submit继续拆子任务
+ * - 有界队列，满了submit直接返回false(不阻塞loop)，调用者决定怎么拒绝，比如回503
+ * - 完成通知按loop攒批：同一个loop上积压的多个done只触发一次queueInLoop/wakeup
+ * - 统计排队时间、执行时间和submit到done执行完的端到端时间
+ * stop()在loop还在跑的时候调用：已经接受的work都会执行完，done照常投递回loop；之后submit一律返回false。
+ * 投递到loop里的drain只持有收件箱和完成统计的shared_ptr，不碰线程池对象，线程池可以先于loop析构
+ */
+class ComputePool : noncopyable
+{
+public:
+    using Task = std::function<void()>;
+
+    struct Stats
+    {
+        uint64_t submitted;
+        uint64_t rejected;  // 队列满被拒绝的
+        uint64_t completed; // done已经在loop里执行完的
+        uint64_t batches;   // 完成通知投递到loop的次数，completed/batches就是平均批大小
+        size_t queueDepth;
+        double avgQueueUs, maxQueueUs; // 在队列里等计算线程的时间
+        double avgRunUs, maxRunUs;     // work的执行时间
+        double avgTotalUs, maxTotalUs; // submit到done执行完
+    };
+
+    static const size_t kDefaultMaxQueueSize = 65536;
+
+    explicit ComputePool(const std::string &name = std::string("ComputePool"));
+    ~ComputePool();
+
+    // start之前设置
+    void setThreadNum(int numThreads) { executor_.setThreadNum(numThreads); }
+    void setMaxQueueSize(size_t maxSize) { maxQueueSize_ = maxSize; }
+
+    void start();
+    void stop(); // 不再接受submit，等已经接受的work都执行完、done都投递回各自的loop
+
+    bool started() const { return started_; }
+    int threadNum() const { return executor_.threadNum(); }
+    WorkStealingExecutor *executor() { return &executor_; }
+
+    // 线程安全。返回false时work和done都不会执行
+    bool submit(EventLoop *loop, Task work, Task done);
+
+    size_t queueSize() const;
+    Stats stats() const;
+
+private:
+    // 原子地累加和更新最大值，只用relaxed
+    struct Histogram
+    {
+        Histogram() : count(0), sum(0), max(0) {}
+        void add(int64_t us);
+        double avg() const;
+        std::atomic<uint64_t> count;
+        std::atomic<int64_t> sum;
+        std::atomic<int64_t> max;
+    };
+
+    // [在loop线程里更新的统计]  drain可能在线程池析构之后才执行，所以单独放在shared_ptr里
+    struct DoneStats
+    {
+        DoneStats() : batches(0) {}
+        std::atomic<uint64_t> batches;
+        Histogram totalTime;
+    };
+
+    // [发往同一个loop的完成通知]  loop里一次取走全部
+    struct Inbox
+    {
+        Inbox(EventLoop *l, const std::shared_ptr<DoneStats> &s) : loop(l), stats(s) {}
+        EventLoop *loop;
+        std::shared_ptr<DoneStats> stats;
+        std::mutex mutex;
+        std::vector<std::pair<Task, int64_t>> done; // (done回调, submit时间)
+    };
+
+    std::shared_ptr<Inbox> inboxFor(EventLoop *loop);
+    void runJob(Task &work, Task &done, const std::shared_ptr<Inbox> &inbox, int64_t submitTime);
+    static void drainInbox(const std::shared_ptr<Inbox> &inbox);
+
+    std::string name_;
+    const uint64_t id_; // 区分线程池实例，线程局部的inbox缓存用
+    size_t maxQueueSize_;
+    WorkStealingExecutor executor_;
+    std::atomic<bool> started_;
+    std::atomic<size_t> pending_; // 已提交还没开始执行的work数
+    std::mutex mutex_;            // 只保护inboxes_，每个线程有缓存，正常只在第一次submit时加锁
+    std::unordered_map<EventLoop *, std::shared_ptr<Inbox>> inboxes_;
+
+    std::atomic<uint64_t> submitted_;
+    std::atomic<uint64_t> rejected_;
+    Histogram queueTime_;
+    Histogram runTime_;
+    std::shared_ptr<DoneStats> doneStats_;
+};
@@ -0,0 +1,34 @@
+#pragma once
+
+#include <functional>
+#include <memory>
+#include <sys/types.h>
+
+class Buffer;
+
+/**
+ * [连接的数据变换层]  挂在socket和用户的inputBuffer/send之间，比如TLS：socket上读到的密文解密成明文
+ * 放进inputBuffer，用户send的明文加密以后再进outputBuffer。TcpConnection在loop线程里调用，实现不用加锁。
+ * output里是要原样写给对端的字节，TcpConnection照常走outputBuffer/EPOLLOUT发出去
+ */
+class ConnectionFilter
+{
+public:
+    virtual ~ConnectionFilter() = default;
+
+    /**
+     * 代替Buffer::readFd：从fd读数据，明文追加到input，需要回给对端的字节(握手、告警)追加到output。
+     * 返回值和readFd一样：>0是从fd读到的字节数(可能没解出明文)，0表示对端关闭或者协议出错要关连接，<0看savedErrno
+     */
+    virtual ssize_t readFd(int fd, Buffer *input, Buffer *output, int *savedErrno) = 0;
+    // 用户要发的明文，变换以后追加到output
+    virtual void encode(const void *data, size_t len, Buffer *output) = 0;
+    // 半关闭之前要发的字节(TLS的close_notify)，多次调用只生效一次
+    virtual void encodeShutdown(Buffer *output) = 0;
+    // 握手完成之前TcpConnection不会调用connectionCallback，用户也就拿不到连接去send
+    virtual bool established() const = 0;
+    // established第一次变成true时调用一次；outputDrained表示之前的output已经全部写进了内核
+    virtual void onEstablished(int /*fd*/, bool /*outputDrained*/) {}
+};
+
+using ConnectionFilterFactory = std::function<std::unique_ptr<ConnectionFilter>()>;
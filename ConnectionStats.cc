@@ -0,0 +1,48 @@
+#include "ConnectionStats.h"
+#include "Timestamp.h"
+
+ConnectionStats::ConnectionStats()
+    : createdUs_(Timestamp::monotonicMicros()),
+      bytesIn_(0),
+      bytesOut_(0),
+      reads_(0),
+      writes_(0),
+      messages_(0),
+      outputQueue_(0),
+      maxOutputQueue_(0),
+      writeBlockedUs_(0),
+      blockedSince_(0),
+      callbackUs_(0),
+      maxCallbackUs_(0)
+{
+}
+
+void ConnectionStats::onWriteUnblocked(int64_t nowUs)
+{
+    int64_t since = blockedSince_.load(std::memory_order_relaxed);
+    if (since != 0)
+    {
+        add(&writeBlockedUs_, nowUs - since);
+        blockedSince_.store(0, std::memory_order_relaxed);
+    }
+}
+
+void ConnectionStats::fill(ConnectionStatsSnapshot *s, int64_t nowUs) const
+{
+    s->bytesIn = bytesIn_.load(std::memory_order_relaxed);
+    s->bytesOut = bytesOut_.load(std::memory_order_relaxed);
+    s->reads = reads_.load(std::memory_order_relaxed);
+    s->writes = writes_.load(std::memory_order_relaxed);
+    s->messages = messages_.load(std::memory_order_relaxed);
+    s->outputQueue = outputQueue_.load(std::memory_order_relaxed);
+    s->maxOutputQueue = maxOutputQueue_.load(std::memory_order_relaxed);
+    s->writeBlockedUs = writeBlockedUs_.load(std::memory_order_relaxed);
+    int64_t since = blockedSince_.load(std::memory_order_relaxed);
+    if (since != 0 && nowUs > since)
+    {
+        s->writeBlockedUs += nowUs - since;
+    }
+    s->callbackUs = callbackUs_.load(std::memory_order_relaxed);
+    s->maxCallbackUs = maxCallbackUs_.load(std::memory_order_relaxed);
+    s->ageUs = nowUs - createdUs_;
+}
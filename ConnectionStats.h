@@ -0,0 +1,95 @@
+#pragma once
+
+#include "noncopyable.h"
+
+#include <atomic>
+#include <string>
+#include <stdint.h>
+
+/**
+ * [某一时刻的连接统计]  TcpConnection::stats()返回，可以拷贝到任何线程
+ */
+struct ConnectionStatsSnapshot
+{
+    ConnectionStatsSnapshot()
+        : bytesIn(0), bytesOut(0), reads(0), writes(0), messages(0),
+          outputQueue(0), maxOutputQueue(0), writeBlockedUs(0),
+          callbackUs(0), maxCallbackUs(0), ageUs(0) {}
+
+    std::string name;
+    std::string peer;
+    uint64_t bytesIn;
+    uint64_t bytesOut;
+    uint64_t reads;          // 读到数据的read次数
+    uint64_t writes;         // 写出数据的write次数
+    uint64_t messages;       // messageCallback调用次数
+    uint64_t outputQueue;    // 当前outputBuffer里积压的字节数
+    uint64_t maxOutputQueue;
+    uint64_t writeBlockedUs; // 等EPOLLOUT的总时间，包括正在等的这一次：对端收得慢就会很大
+    uint64_t callbackUs;     // messageCallback总耗时
+    uint64_t maxCallbackUs;
+    uint64_t ageUs;          // 连接建立了多久
+};
+
+/**
+ * [每个连接一份的统计]  只有连接所在的loop线程写，relaxed的load+store，没有原子RMW；
+ * 其他线程读到的每个字段是原子的，字段之间不保证是同一时刻
+ */
+class ConnectionStats : noncopyable
+{
+public:
+    ConnectionStats();
+
+    // 以下只在loop线程调用
+    void onRead(size_t n)
+    {
+        add(&bytesIn_, n);
+        add(&reads_, 1);
+    }
+    void onWrite(size_t n)
+    {
+        add(&bytesOut_, n);
+        add(&writes_, 1);
+    }
+    void onMessageCallback(int64_t us)
+    {
+        add(&messages_, 1);
+        add(&callbackUs_, us);
+        if (static_cast<uint64_t>(us) > maxCallbackUs_.load(std::memory_order_relaxed))
+        {
+            maxCallbackUs_.store(us, std::memory_order_relaxed);
+        }
+    }
+    void setOutputQueue(size_t n)
+    {
+        outputQueue_.store(n, std::memory_order_relaxed);
+        if (n > maxOutputQueue_.load(std::memory_order_relaxed))
+        {
+            maxOutputQueue_.store(n, std::memory_order_relaxed);
+        }
+    }
+    void onWriteBlocked(int64_t nowUs) { blockedSince_.store(nowUs, std::memory_order_relaxed); }
+    void onWriteUnblocked(int64_t nowUs);
+
+    // 任何线程
+    void fill(ConnectionStatsSnapshot *s, int64_t nowUs) const;
+
+private:
+    static void add(std::atomic<uint64_t> *counter, uint64_t delta)
+    {
+        counter->store(counter->load(std::memory_order_relaxed) + delta, std::memory_order_relaxed);
+    }
+
+    const int64_t createdUs_;
+    std::atomic<uint64_t> bytesIn_;
+    std::atomic<uint64_t> bytesOut_;
+    std::atomic<uint64_t> reads_;
+    std::atomic<uint64_t> writes_;
+    std::atomic<uint64_t> messages_;
+    std::atomic<uint64_t> outputQueue_;
+    std::atomic<uint64_t> maxOutputQueue_;
+    std::atomic<uint64_t> writeBlockedUs_;
+    std::atomic<int64_t> blockedSince_; // 0表示当前没有在等EPOLLOUT
+    std::atomic<uint64_t> callbackUs_;
+    std::atomic<uint64_t> maxCallbackUs_;
+};
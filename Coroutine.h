@@ -0,0 +1,344 @@
+#pragma once
+
+/**
+ * [C++20协程接口]  建在回调接口之上的一层薄封装，只有头文件，库本身仍然按C++11编译，
+ * 只用回调的用户不受影响。使用方需要 -std=c++20:
+ *
+ *     co::Task<> session(co::Connection conn)
+ *     {
+ *         while (true)
+ *         {
+ *             std::string line = co_await conn.readUntil("\r\n");
+ *             if (line.empty())
+ *                 co_return;                              // 对端关闭
+ *             co_await co::sleep(conn.getLoop(), 0.01);
+ *             if (!co_await conn.write(line))
+ *                 co_return;
+ *         }
+ *     }
+ *     co::serve(&server, session);  // 每个新连接启动一个协程
+ *
+ * - 协程帧只在连接所在的loop线程里恢复：读由messageCallback唤醒，写由writeCompleteCallback唤醒，
+ *   sleep由本loop的timerfd唤醒，中间没有跨线程的跳转
+ * - 同一个连接同一时刻只能有一个读和一个写在等待
+ * - serve会占用TcpServer的connection/message/writeComplete回调和连接的context
+ */
+#if !defined(__cpp_impl_coroutine) || __cpp_impl_coroutine < 201902L
+#error "Coroutine.h需要C++20协程支持(-std=c++20)"
+#endif
+
+#include "TcpServer.h"
+#include "TcpConnection.h"
+#include "EventLoop.h"
+#include "Buffer.h"
+#include "StringPiece.h"
+
+#include <coroutine>
+#include <exception>
+#include <functional>
+#include <memory>
+#include <optional>
+#include <string>
+#include <utility>
+
+namespace co
+{
+    template <typename T = void>
+    class Task;
+
+    namespace detail
+    {
+        // [协程帧结束时]  有等待者就对称转移回去；被spawn出来的协程没人等，自己销毁
+        struct FinalAwaiter
+        {
+            bool await_ready() const noexcept { return false; }
+            template <typename Promise>
+            std::coroutine_handle<> await_suspend(std::coroutine_handle<Promise> h) noexcept
+            {
+                Promise &promise = h.promise();
+                if (promise.detached)
+                {
+                    h.destroy();
+                    return std::noop_coroutine();
+                }
+                if (promise.continuation)
+                {
+                    return promise.continuation;
+                }
+                return std::noop_coroutine();
+            }
+            void await_resume() const noexcept {}
+        };
+
+        struct PromiseBase
+        {
+            std::suspend_always initial_suspend() const noexcept { return {}; } // 惰性启动
+            FinalAwaiter final_suspend() const noexcept { return {}; }
+            void unhandled_exception() const noexcept { std::terminate(); } // 和库一样不用异常
+
+            std::coroutine_handle<> continuation;
+            bool detached = false;
+        };
+
+        template <typename T>
+        struct Promise : PromiseBase
+        {
+            Task<T> get_return_object() noexcept;
+            void return_value(T value) { result.emplace(std::move(value)); }
+            std::optional<T> result;
+        };
+
+        template <>
+        struct Promise<void> : PromiseBase
+        {
+            Task<void> get_return_object() noexcept;
+            void return_void() const noexcept {}
+        };
+    } // namespace detail
+
+    /**
+     * [协程任务]  惰性启动，被co_await时才开始执行，结束时直接转回等待者(对称转移，不增加栈深度)。
+     * 顶层的Task<void>交给spawn启动
+     */
+    template <typename T>
+    class Task
+    {
+    public:
+        using promise_type = detail::Promise<T>;
+        using Handle = std::coroutine_handle<promise_type>;
+
+        explicit Task(Handle h) noexcept : handle_(h) {}
+        Task(Task &&other) noexcept : handle_(std::exchange(other.handle_, nullptr)) {}
+        Task &operator=(Task &&other) noexcept
+        {
+            if (this != &other)
+            {
+                if (handle_)
+                    handle_.destroy();
+                handle_ = std::exchange(other.handle_, nullptr);
+            }
+            return *this;
+        }
+        Task(const Task &) = delete;
+        Task &operator=(const Task &) = delete;
+        ~Task()
+        {
+            if (handle_)
+                handle_.destroy();
+        }
+
+        bool await_ready() const noexcept { return false; }
+        std::coroutine_handle<> await_suspend(std::coroutine_handle<> awaiting) noexcept
+        {
+            handle_.promise().continuation = awaiting;
+            return handle_;
+        }
+        T await_resume()
+        {
+            if constexpr (!std::is_void<T>::value)
+            {
+                return std::move(*handle_.promise().result);
+            }
+        }
+
+        // 交出协程帧的所有权，spawn用
+        Handle release() noexcept { return std::exchange(handle_, nullptr); }
+
+    private:
+        Handle handle_;
+    };
+
+    namespace detail
+    {
+        template <typename T>
+        Task<T> Promise<T>::get_return_object() noexcept
+        {
+            return Task<T>(std::coroutine_handle<Promise<T>>::from_promise(*this));
+        }
+
+        inline Task<void> Promise<void>::get_return_object() noexcept
+        {
+            return Task<void>(std::coroutine_handle<Promise<void>>::from_promise(*this));
+        }
+    } // namespace detail
+
+    // [在当前线程启动一个顶层协程]  执行到第一个挂起点返回，协程结束时自己释放协程帧
+    inline void spawn(Task<void> task)
+    {
+        Task<void>::Handle h = task.release();
+        h.promise().detached = true;
+        h.resume();
+    }
+
+    // [co_await co::sleep(loop, seconds)]  在loop线程里调用，到期后在同一个loop里恢复
+    class SleepAwaiter
+    {
+    public:
+        SleepAwaiter(EventLoop *loop, double seconds) : loop_(loop), seconds_(seconds) {}
+        bool await_ready() const noexcept { return seconds_ <= 0; }
+        void await_suspend(std::coroutine_handle<> h)
+        {
+            loop_->runAfter(seconds_, [h]()
+                            { h.resume(); });
+        }
+        void await_resume() const noexcept {}
+
+    private:
+        EventLoop *loop_;
+        double seconds_;
+    };
+
+    inline SleepAwaiter sleep(EventLoop *loop, double seconds) { return SleepAwaiter(loop, seconds); }
+
+    namespace detail
+    {
+        // [挂在TcpConnection的context上]  记录当前在等待的读/写协程，只在loop线程里访问
+        struct ConnState
+        {
+            std::coroutine_handle<> reader;
+            std::coroutine_handle<> writer;
+            size_t need = 0;   // read(n)要等的字节数
+            std::string delim; // readUntil的分隔符，非空时优先于need
+            bool closed = false;
+
+            // 当前inputBuffer能满足读请求就返回要取走的字节数，否则返回0
+            size_t satisfiable(Buffer *buf) const
+            {
+                if (!delim.empty())
+                {
+                    const char *found = buf->find(buf->peek(), delim.data(), delim.size());
+                    return found == nullptr ? 0 : found - buf->peek() + delim.size();
+                }
+                return buf->readableBytes() >= need ? need : 0;
+            }
+
+            static void resume(std::coroutine_handle<> *slot)
+            {
+                if (*slot)
+                {
+                    std::exchange(*slot, nullptr).resume();
+                }
+            }
+        };
+    } // namespace detail
+
+    /**
+     * [协程里的连接]  持有TcpConnectionPtr，协程没结束之前连接对象不会析构。
+     * 所有co_await都必须在连接所在的loop线程里发起(serve启动的协程天然满足)
+     */
+    class Connection
+    {
+    public:
+        class ReadAwaiter
+        {
+        public:
+            ReadAwaiter(Connection *conn, size_t n, std::string delim)
+                : conn_(conn), n_(n), delim_(std::move(delim)) {}
+
+            bool await_ready()
+            {
+                detail::ConnState *state = conn_->state();
+                state->need = n_;
+                state->delim = delim_;
+                return state->closed || state->satisfiable(conn_->conn_->inputBuffer()) > 0;
+            }
+            void await_suspend(std::coroutine_handle<> h) { conn_->state()->reader = h; }
+            // 连接关闭且数据不够时返回空串
+            std::string await_resume()
+            {
+                Buffer *buf = conn_->conn_->inputBuffer();
+                size_t len = conn_->state()->satisfiable(buf);
+                return len == 0 ? std::string() : buf->retrieveAsString(len);
+            }
+
+        private:
+            Connection *conn_;
+            size_t n_;
+            std::string delim_;
+        };
+
+        class WriteAwaiter
+        {
+        public:
+            WriteAwaiter(Connection *conn, const StringPiece &data) : conn_(conn), data_(data), sent_(false) {}
+
+            bool await_ready() const noexcept { return false; }
+            // 发出去以后等writeComplete，即数据全部交给内核；连接已经断了或正在shutdown就不发也不挂起
+            bool await_suspend(std::coroutine_handle<> h)
+            {
+                detail::ConnState *state = conn_->state();
+                if (state->closed || !conn_->conn_->connected())
+                {
+                    return false;
+                }
+                conn_->conn_->send(data_.data(), data_.size());
+                sent_ = true;
+                state->writer = h;
+                return true;
+            }
+            // 返回false表示数据没有交给send()，或者连接在写完之前断开了
+            bool await_resume() const { return sent_ && !conn_->state()->closed; }
+
+        private:
+            Connection *conn_;
+            StringPiece data_;
+            bool sent_;
+        };
+
+        explicit Connection(const TcpConnectionPtr &conn) : conn_(conn) {}
+
+        // 读满n个字节
+        ReadAwaiter read(size_t n) { return ReadAwaiter(this, n, std::string()); }
+        // 读到delim为止，返回的数据包含delim
+        ReadAwaiter readUntil(const StringPiece &delim) { return ReadAwaiter(this, 0, delim.as_string()); }
+        // data在co_await结束之前必须有效
+        WriteAwaiter write(const StringPiece &data) { return WriteAwaiter(this, data); }
+
+        void shutdown() { conn_->shutdown(); }
+        bool connected() const { return conn_->connected(); }
+        EventLoop *getLoop() const { return conn_->getLoop(); }
+        const TcpConnectionPtr &get() const { return conn_; }
+
+    private:
+        detail::ConnState *state() const
+        {
+            return static_cast<detail::ConnState *>(conn_->getContext().get());
+        }
+
+        TcpConnectionPtr conn_;
+    };
+
+    using Handler = std::function<Task<void>(Connection)>;
+
+    // [把协程处理函数装到TcpServer上]  在server.start()之前调用
+    inline void serve(TcpServer *server, Handler handler)
+    {
+        server->setConnectionCallback([handler](const TcpConnectionPtr &conn)
+                                      {
+            if (conn->connected())
+            {
+                conn->setContext(std::make_shared<detail::ConnState>());
+                spawn(handler(Connection(conn)));
+                return;
+            }
+            // 断开时唤醒还在等待的读写，让协程看到连接已关闭并结束
+            detail::ConnState *state = static_cast<detail::ConnState *>(conn->getContext().get());
+            if (state != nullptr)
+            {
+                state->closed = true;
+                detail::ConnState::resume(&state->reader);
+                detail::ConnState::resume(&state->writer);
+            } });
+        server->setMessageCallback([](const TcpConnectionPtr &conn, Buffer *buf, Timestamp)
+                                   {
+            detail::ConnState *state = static_cast<detail::ConnState *>(conn->getContext().get());
+            if (state->reader && state->satisfiable(buf) > 0)
+            {
+                detail::ConnState::resume(&state->reader);
+            } });
+        server->setWriteCompleteCallback([](const TcpConnectionPtr &conn)
+                                         {
+            detail::ConnState *state = static_cast<detail::ConnState *>(conn->getContext().get());
+            detail::ConnState::resume(&state->writer); });
+    }
+} // namespace co
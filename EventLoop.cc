@@ -2,12 +2,16 @@
 #include "Logger.h"
 #include "Poller.h"
 #include "Channel.h"
+#include "TimerQueue.h"
+#include "Tracer.h"
 
 #include <sys/eventfd.h>
+#include <signal.h>
 #include <unistd.h>
 #include <fcntl.h>
 #include <errno.h>
 #include <memory>
+#include <algorithm>
 // one loop peer thread 每个线程一个事件循环
 /* 作用：防止一个线程创建多个EventLoop   thread_local
 创建了一个全局的eventloop类型的指针变量，但是用__thread关键字修饰
@@ -18,6 +22,20 @@
 __thread EventLoop *t_loopInThisThread = nullptr;
 
 const int kPollTimeMs = 10000; // 定义默认的Poller IO复用接口的超时时间10s
+
+/* 【忽略SIGPIPE】  往对端已经关闭的连接write会收到SIGPIPE，默认动作是杀掉整个进程；
+忽略以后write返回EPIPE，由TcpConnection按错误处理。Unix域socket上对端一关马上就是EPIPE，
+TCP要等收到RST，所以以前不容易碰到。和muduo一样在库加载时设置一次 */
+namespace
+{
+    class IgnoreSigPipe
+    {
+    public:
+        IgnoreSigPipe() { ::signal(SIGPIPE, SIG_IGN); }
+    };
+    IgnoreSigPipe s_ignoreSigPipe; // 内部链接，不和用户的符号冲突
+}
+
 // 【全局函数:创建wakeupfd，用来notify唤醒subReactor处理新来的channel 】
 int createEventfd()
 {
@@ -30,15 +48,19 @@ int createEventfd()
 }
 
 EventLoop::EventLoop()
-    : looping_(false), quit_(false),
+    : looping_(false), quit_(false), polling_(false),
       callingPendingFunctors_(false),
       threadId_(CurrentThread::tid()) //通过封装的系统调用，获取线程id
       ,
+      metrics_(threadId_),
+      pollReturnNanos_(0),
+      busyPollNanos_(0),
       poller_(Poller::newDefaultPoller(this)) //调用封装的poller的函数创建
       ,
       wakeupFd_(createEventfd()) //调用全局函数eventfd创建wakeupfd
       ,
-      wakeupChannel_(new Channel(this, wakeupFd_))
+      wakeupChannel_(new Channel(this, wakeupFd_)),
+      timerQueue_(new TimerQueue(this))
 // channel打包wakeupfd,下面设置它感兴趣的事件
 //相当于每个sub reactor 都监听了wekeupchanenl，所以当main reactor去notify 那个wekeupfd，那么sub reactor就被唤醒了
 {
@@ -74,17 +96,64 @@ void EventLoop::loop()
 
     LOG_INFO("EventLoop %p start looping \n", this);
 
+    int64_t lastActiveNanos = 0; // 最后一次有事件或任务的那一圈结束的时间，忙轮询从这里开始算预算
     while (!quit_)
     {
         activeChannels_.clear(); //每次进来vector要clear
+        int timeoutMs = kPollTimeMs;
+        const int64_t busyPollNanos = busyPollNanos_.load(std::memory_order_relaxed);
+        const bool spinning = busyPollNanos > 0 && Timestamp::monotonicNanos() - lastActiveNanos < busyPollNanos;
+        if (spinning)
+        {
+            // 不会睡，polling_保持false，无锁任务源的生产者不用写eventfd，下面doPendingFunctors每圈都会drain
+            timeoutMs = 0;
+        }
+        /* 先声明自己要睡了，再检查一遍无锁任务源：生产者是先入队再看polling_，
+        两边都有seq_cst屏障，所以要么这里看到了新任务，要么生产者看到polling_去写eventfd */
+        else if (!pendingSources_.empty())
+        {
+            polling_.store(true);
+            std::atomic_thread_fence(std::memory_order_seq_cst);
+            for (PendingSource *source : pendingSources_)
+            {
+                if (source->hasPending())
+                {
+                    timeoutMs = 0;
+                    break;
+                }
+            }
+        }
         // eventloop调的poller监听两类fd ：  一种是client的fd ，
         // 一种wakeupfd：mainreactor和sub reactor通信的fd
-        pollReturnTime_ = poller_->poll(kPollTimeMs, &activeChannels_);
+        int64_t pollStart = Timestamp::monotonicNanos();
+        pollReturnTime_ = poller_->poll(timeoutMs, &activeChannels_);
+        polling_.store(false, std::memory_order_relaxed);
+        int64_t pollEnd = Timestamp::monotonicNanos();
+        pollReturnNanos_ = pollEnd;
+        int numEvents = static_cast<int>(activeChannels_.size());
+        metrics_.onPoll(numEvents, (pollEnd - pollStart) / 1000);
+        const bool tracing = Tracer::enabled();
+        if (tracing)
+        {
+            Tracer::record(Tracer::kPoll, pollStart, pollEnd - pollStart, numEvents);
+        }
         for (Channel *channel : activeChannels_)
         {
             //【Poller监听哪些channel发生事件了，然后上报给EventLoop，通知channel处理相应的事件 】
-            channel->handleEvent(pollReturnTime_);
+            if (tracing)
+            {
+                int64_t start = Timestamp::monotonicNanos();
+                int revents = channel->revents(); // handleEvent里可能析构channel，先取出来
+                int fd = channel->fd();
+                channel->handleEvent(pollReturnTime_);
+                Tracer::record(Tracer::kChannel, start, Timestamp::monotonicNanos() - start, fd, revents);
+            }
+            else
+            {
+                channel->handleEvent(pollReturnTime_);
+            }
         }
+        int64_t handleEnd = Timestamp::monotonicNanos();
         // 执行当前EventLoop事件循环需要处理的回调操作
         /**
          * IO线程(即main reactor -main loop)的工作是接受新用户的连接，acceptr返回一个与客户端
@@ -94,7 +163,22 @@ void EventLoop::loop()
          *      mainLoop 事先注册一个回调cb（需要subloop来执行）
          *      wakeup subloop后，执行下面的方法，执行之前mainloop注册的cb操作
          */
-        doPendingFunctors();
+        size_t functors = doPendingFunctors();
+        int64_t functorsEnd = Timestamp::monotonicNanos();
+        metrics_.onIteration((handleEnd - pollEnd) / 1000, (functorsEnd - handleEnd) / 1000, functors);
+        const bool active = numEvents > 0 || functors > 0;
+        if (active)
+        {
+            lastActiveNanos = functorsEnd;
+        }
+        if (spinning)
+        {
+            metrics_.onSpin(active, (functorsEnd - pollStart) / 1000);
+        }
+        if (tracing && functors > 0)
+        {
+            Tracer::record(Tracer::kFunctors, handleEnd, functorsEnd - handleEnd, functors);
+        }
     }
 
     LOG_INFO("EventLoop %p stop looping. \n", this);
@@ -121,6 +205,21 @@ void EventLoop::quit()
     }
 }
 
+TimerId EventLoop::runAfter(double delay, Functor cb)
+{
+    return timerQueue_->addTimer(std::move(cb), delay, 0.0);
+}
+
+TimerId EventLoop::runEvery(double interval, Functor cb)
+{
+    return timerQueue_->addTimer(std::move(cb), interval, interval);
+}
+
+void EventLoop::cancel(TimerId timerId)
+{
+    timerQueue_->cancel(timerId);
+}
+
 // 【在当前loop中执行cb】
 void EventLoop::runInLoop(Functor cb)
 {
@@ -140,6 +239,7 @@ void EventLoop::queueInLoop(Functor cb)
         std::unique_lock<std::mutex> lock(mutex_);
         pendingFunctors_.emplace_back(cb); //在vector底层内存直接构造cb
     }
+    metrics_.onQueueInLoop();
 
     // 【唤醒相应的，需要执行上面回调操作的loop的线程了】
     // || callingPendingFunctors_的意思是：当前loop正在执行回调，但是loop又有了新的回调
@@ -153,6 +253,7 @@ void EventLoop::handleRead()
 {
     uint64_t one = 1;
     ssize_t n = read(wakeupFd_, &one, sizeof one);
+    metrics_.onWakeupReceived();
     if (n != sizeof one)
     {
         LOG_ERROR("EventLoop::handleRead() reads %lu bytes instead of 8", n);
@@ -164,6 +265,11 @@ void EventLoop::wakeup()
 {
     uint64_t one = 1;
     ssize_t n = write(wakeupFd_, &one, sizeof one);
+    metrics_.onWakeupSent();
+    if (Tracer::enabled())
+    {
+        Tracer::record(Tracer::kWakeup, Timestamp::monotonicNanos(), -1, wakeupFd_);
+    }
     /*这里读到什么不重要：  重要的是每个subreactor监听了wekeup channel(wakeupfd),
     那么main reactor就可以通过给wekeupChannel  write，那么sub reactor就可以感知到了wakeup上有读事件了。
     那么sub reactor就被唤醒了，就可以从main reactor拿到新用户的连接去处理了
@@ -175,6 +281,50 @@ void EventLoop::wakeup()
     }
 }
 
+void EventLoop::wakeupIfPolling()
+{
+    std::atomic_thread_fence(std::memory_order_seq_cst);
+    if (polling_.load(std::memory_order_relaxed))
+    {
+        wakeup();
+    }
+}
+
+void EventLoop::addPendingSource(PendingSource *source)
+{
+    pendingSources_.push_back(source);
+}
+
+void EventLoop::removePendingSource(PendingSource *source)
+{
+    pendingSources_.erase(std::remove(pendingSources_.begin(), pendingSources_.end(), source),
+                          pendingSources_.end());
+}
+
+void EventLoop::cancelFlush(DeferredFlush *target)
+{
+    pendingFlushes_.erase(std::remove(pendingFlushes_.begin(), pendingFlushes_.end(), target),
+                          pendingFlushes_.end());
+    std::replace(flushing_.begin(), flushing_.end(), target, static_cast<DeferredFlush *>(nullptr));
+}
+
+void EventLoop::doDeferredFlushes()
+{
+    // flush里可能再登记(比如又send了)，循环到没有为止
+    while (!pendingFlushes_.empty())
+    {
+        flushing_.swap(pendingFlushes_);
+        for (size_t i = 0; i < flushing_.size(); ++i)
+        {
+            if (flushing_[i] != nullptr) // 被cancelFlush取消的
+            {
+                flushing_[i]->flush();
+            }
+        }
+        flushing_.clear();
+    }
+}
+
 // EventLoop的方法 =》 Poller的方法
 void EventLoop::updateChannel(Channel *channel)
 {
@@ -191,7 +341,7 @@ bool EventLoop::hasChannel(Channel *channel)
     return poller_->hasChannel(channel);
 }
 
-void EventLoop::doPendingFunctors() // 执行回调
+size_t EventLoop::doPendingFunctors() // 执行回调
 {
     std::vector<Functor> functors;  //定义一个局部回调的vector，然后使用swap操作
     callingPendingFunctors_ = true; //原子变量
@@ -202,10 +352,25 @@ void EventLoop::doPendingFunctors() // 执行回调
         //直接交换，后面去局部functors处理即可，然后loop就可以并发操作了
     }
 
+    /* [再批量处理无锁任务源]  一定要在swap之后、执行functors之前：ShardRouter队列满时会退化到
+    queueInLoop，这样swap出来的functor之前入队的无锁任务一定在这里先执行完，保证FIFO */
+    for (size_t i = 0; i < pendingSources_.size(); ++i)
+    {
+        pendingSources_[i]->drain();
+    }
+
     for (const Functor &functor : functors)
     {
         functor(); // 执行当前loop需要执行的回调操作
     }
 
+    /* [最后做本轮登记的flush]  放在functors之后，functor里的send(跨线程投递过来的发送)也能合进去；
+    callingPendingFunctors_还是true，flush里queueInLoop的回调会wakeup，不会拖到下一次poll超时 */
+    if (!pendingFlushes_.empty())
+    {
+        doDeferredFlushes();
+    }
+
     callingPendingFunctors_ = false;
+    return functors.size();
 }
@@ -9,9 +9,35 @@
 #include "noncopyable.h"
 #include "Timestamp.h"
 #include "CurrentThread.h"
+#include "Callbacks.h"
+#include "LoopMetrics.h"
 
 class Channel;
 class Poller;
+class TimerQueue;
+
+/**
+ * [挂在loop上的无锁任务源]  除了pendingFunctors_以外，其他模块(比如ShardRouter的SPSC队列)
+ * 也可以把自己的待处理任务交给loop：drain在doPendingFunctors里批量执行，
+ * hasPending在阻塞poll之前检查，有任务就不睡。生产者入队以后调用EventLoop::wakeupIfPolling
+ */
+class PendingSource
+{
+public:
+    virtual ~PendingSource() = default;
+    virtual void drain() = 0;
+    virtual bool hasPending() const = 0;
+};
+/**
+ * [本轮末尾的批量刷新]  在loop线程里用deferFlush登记，本轮pendingFunctors执行完以后、下一次poll之前
+ * 调用一次flush，登记一次只调用一次。TcpConnection的auto-cork用它把一轮里的多次send合成一次write
+ */
+class DeferredFlush
+{
+public:
+    virtual ~DeferredFlush() = default;
+    virtual void flush() = 0;
+};
 //【 时间循环类】 主要包含了两个大模块 Channel   Poller（epoll的抽象）
 class EventLoop : noncopyable
 {
@@ -21,27 +47,56 @@ public:
     ~EventLoop();
     void loop(); //开启事件循环
     void quit(); //退出事件循环
+    // [本轮poll返回时缓存的时间]  每轮只取一次时钟，loop线程里的回调用它代替Timestamp::now()
     Timestamp pollReturnTime() const { return pollReturnTime_; }
+    int64_t pollReturnNanos() const { return pollReturnNanos_; } // 单调时钟，算耗时用
+    /**
+     * [自适应忙轮询]  最后一次有事件或任务以后的budgetUs微秒内，用timeout=0的poll空转而不睡眠，
+     * 请求陆续到来时省掉每次睡眠+唤醒的上下文切换；超过预算没有活就退回阻塞poll。
+     * 0关闭(默认)。空转会占满一个核，只给延迟敏感、核数够的服务用。任何线程都可以调用
+     */
+    void setBusyPoll(int budgetUs) { busyPollNanos_.store(static_cast<int64_t>(budgetUs) * 1000, std::memory_order_relaxed); }
+    int busyPollMicros() const { return static_cast<int>(busyPollNanos_.load(std::memory_order_relaxed) / 1000); }
+    // [定时器]  线程安全，回调在loop线程里执行；单位是秒，支持小数
+    TimerId runAfter(double delay, Functor cb);
+    TimerId runEvery(double interval, Functor cb);
+    void cancel(TimerId timerId);
+
     void runInLoop(Functor cb);   //[在当前loop中执行cb]
     void queueInLoop(Functor cb); // [把cb放入队列中，唤醒loop所在的线程，执行cb]
     void wakeup();                // [用来唤醒loop所在的线程的(main reactor唤醒sub reactor)]
+    // [只有loop正阻塞(或即将阻塞)在poll里时才写eventfd]  给无锁的生产者用，loop忙的时候没有系统调用
+    void wakeupIfPolling();
+    // 只能在loop线程里调用，source的生命周期要比loop长或者先removePendingSource
+    void addPendingSource(PendingSource *source);
+    void removePendingSource(PendingSource *source);
+    // 只能在loop线程里调用；同一个target在flush之前重复登记由调用方避免，target析构前要cancelFlush
+    void deferFlush(DeferredFlush *target) { pendingFlushes_.push_back(target); }
+    void cancelFlush(DeferredFlush *target);
     // EventLoop的方法 =》 Poller的方法
     void updateChannel(Channel *channel);
     void removeChannel(Channel *channel);
     bool hasChannel(Channel *channel);
+    // [运行时指标]  任何线程都可以读，EventLoopThreadPool::metrics()汇总整个线程池
+    const LoopMetrics &metrics() const { return metrics_; }
     // [判断EventLoop对象是否在自己的线程里面]
     bool isInLoopThread() const { return threadId_ == CurrentThread::tid(); }
 
 private:
     void handleRead();        // wake up
-    void doPendingFunctors(); // [执行回调]
+    size_t doPendingFunctors(); // [执行回调]  返回执行的functor个数
+    void doDeferredFlushes();
     using ChannelList = std::vector<Channel *>;
     std::atomic_bool looping_; // 原子操作，通过CAS实现的
     std::atomic_bool quit_;    // 标识退出loop循环
+    std::atomic_bool polling_; // 标识loop准备阻塞在poll里，wakeupIfPolling根据它决定是否写eventfd
 
     const pid_t threadId_; // 【 记录当前loop所在线程的id:one loop peer thread 】
+    LoopMetrics metrics_;
 
     Timestamp pollReturnTime_;       // poller返回发生事件的channels的时间点
+    int64_t pollReturnNanos_;
+    std::atomic<int64_t> busyPollNanos_;
     std::unique_ptr<Poller> poller_; //[Plloer]相当于就是epoll抽象
     // muduo库中多路事件分发器的核心IO复用模块
     /* main reactor 给sub reactor分配新连接的时候采用的轮询操作。
@@ -53,10 +108,14 @@ private:
     /* 主要作用，当mainLoop获取一个新用户的channel，
     通过轮询算法选择一个subloop，通过该成员唤醒subloop处理channel */
     std::unique_ptr<Channel> wakeupChannel_; // wakeupfd封装到wakeupchannel里面
+    std::unique_ptr<TimerQueue> timerQueue_; // timerfd，定时器事件也走poller
 
     //[通道Channel]里面有fd、感兴趣的事件以及实际发生的事件
     ChannelList activeChannels_;              // [ChannelList保存一堆channel]
     std::atomic_bool callingPendingFunctors_; //【标识当前loop是否有需要执行的回调操作】
     std::vector<Functor> pendingFunctors_;    // [存储loop需要执行的所有的回调操作]
     std::mutex mutex_;                        // [互斥锁，用来保护上面vector容器的线程安全操作]
+    std::vector<PendingSource *> pendingSources_; // 只在loop线程里访问
+    std::vector<DeferredFlush *> pendingFlushes_; // 只在loop线程里访问
+    std::vector<DeferredFlush *> flushing_;       // 正在flush的这一批，和pendingFlushes_交换着用，不重新分配
 };
@@ -1,5 +1,6 @@
 #include "EventLoopThreadPool.h"
 #include "EventLoopThread.h"
+#include "EventLoop.h"
 
 #include <memory>
 
@@ -59,6 +60,26 @@ std::vector<EventLoop *> EventLoopThreadPool::getAllLoops()
     }
     else
     {
-        loops_;
+        return loops_;
     }
 }
+
+std::vector<LoopMetricsSnapshot> EventLoopThreadPool::metricsSnapshots()
+{
+    std::vector<LoopMetricsSnapshot> snapshots;
+    for (EventLoop *loop : getAllLoops())
+    {
+        snapshots.push_back(loop->metrics().snapshot());
+    }
+    return snapshots;
+}
+
+LoopMetricsSnapshot EventLoopThreadPool::metrics()
+{
+    LoopMetricsSnapshot total;
+    for (const LoopMetricsSnapshot &s : metricsSnapshots())
+    {
+        total.merge(s);
+    }
+    return total;
+}
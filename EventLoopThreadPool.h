@@ -1,5 +1,6 @@
 #pragma once
 #include "noncopyable.h"
+#include "LoopMetrics.h"
 
 #include <functional>
 #include <string>
@@ -26,6 +27,10 @@ public:
 
     std::vector<EventLoop *> getAllLoops(); //返回池里面所有loop
 
+    // [指标]  每个subloop一份快照(没有subloop时就是baseLoop)，以及它们的汇总；任何线程都可以调用
+    std::vector<LoopMetricsSnapshot> metricsSnapshots();
+    LoopMetricsSnapshot metrics();
+
     bool started() const { return started_; }
     const std::string name() const { return name_; }
 
@@ -1,29 +1,109 @@
 #include "InetAddress.h"
+#include "Logger.h"
 
 #include <strings.h>
 #include <string.h> //bzero
+#include <stddef.h>
 
 InetAddress::InetAddress(uint16_t port, std::string ip)
 {
-    bzero(&addr_, sizeof addr_); //内存清0，防止出错
+    bzero(&unix_, sizeof unix_); //内存清0，防止出错；unix_是union里最大的
+    if (ip.find(':') != std::string::npos)
+    {
+        addr6_.sin6_family = AF_INET6;
+        addr6_.sin6_port = htons(port);
+        ::inet_pton(AF_INET6, ip.c_str(), &addr6_.sin6_addr);
+        len_ = sizeof addr6_;
+        return;
+    }
     addr_.sin_family = AF_INET;
     addr_.sin_port = htons(port);
     addr_.sin_addr.s_addr = inet_addr(ip.c_str());
     // inet_addr函数有二个作用1：把字符串的点分十进制表示转换成整数表示，2转成网络字节序
+    len_ = sizeof addr_;
+}
+
+InetAddress::InetAddress(const sockaddr_in &addr)
+{
+    bzero(&unix_, sizeof unix_);
+    addr_ = addr;
+    len_ = sizeof addr_;
+}
+
+InetAddress::InetAddress(const sockaddr_in6 &addr)
+{
+    bzero(&unix_, sizeof unix_);
+    addr6_ = addr;
+    len_ = sizeof addr6_;
+}
+
+InetAddress InetAddress::fromUnixPath(const std::string &path)
+{
+    InetAddress result;
+    bzero(&result.unix_, sizeof result.unix_);
+    result.unix_.sun_family = AF_UNIX;
+    bool abstract = !path.empty() && path[0] == '@';
+    // 文件路径要留一个'\0'；抽象命名空间第一个字节是'\0'，后面的名字不需要结尾
+    if (path.size() >= sizeof result.unix_.sun_path)
+    {
+        LOG_FATAL("InetAddress::fromUnixPath path too long: %s \n", path.c_str());
+    }
+    memcpy(result.unix_.sun_path, path.data(), path.size());
+    if (abstract)
+    {
+        result.unix_.sun_path[0] = '\0';
+        result.len_ = static_cast<socklen_t>(offsetof(sockaddr_un, sun_path) + path.size());
+    }
+    else
+    {
+        result.len_ = static_cast<socklen_t>(offsetof(sockaddr_un, sun_path) + path.size() + 1);
+    }
+    return result;
+}
+
+InetAddress InetAddress::fromSockAddr(const sockaddr *addr, socklen_t len)
+{
+    InetAddress result;
+    bzero(&result.unix_, sizeof result.unix_);
+    if (len > sizeof result.unix_)
+    {
+        len = sizeof result.unix_;
+    }
+    memcpy(&result.unix_, addr, len);
+    result.len_ = len;
+    return result;
 }
 
 std::string InetAddress::toIp() const
 { //网络字节序转成本机字节序然后返回
-    // addr_
     char buf[64] = {0};
-    ::inet_ntop(AF_INET, &addr_.sin_addr, buf, sizeof buf);
+    if (family() == AF_INET6)
+    {
+        ::inet_ntop(AF_INET6, &addr6_.sin6_addr, buf, sizeof buf);
+    }
+    else if (family() == AF_INET)
+    {
+        ::inet_ntop(AF_INET, &addr_.sin_addr, buf, sizeof buf);
+    }
     return buf;
 }
 
 std::string InetAddress::toIpPort() const
 {
-    // ip:port返回
+    // ip:port返回，IPv6的ip加上方括号
+    if (family() == AF_UNIX)
+    {
+        return "unix:" + unixPath();
+    }
     char buf[64] = {0};
+    if (family() == AF_INET6)
+    {
+        buf[0] = '[';
+        ::inet_ntop(AF_INET6, &addr6_.sin6_addr, buf + 1, sizeof buf - 1);
+        size_t end = strlen(buf);
+        snprintf(buf + end, sizeof buf - end, "]:%u", ntohs(addr6_.sin6_port));
+        return buf;
+    }
     ::inet_ntop(AF_INET, &addr_.sin_addr, buf, sizeof buf);
     size_t end = strlen(buf);
     uint16_t port = ntohs(addr_.sin_port);
@@ -33,7 +113,23 @@ std::string InetAddress::toIpPort() const
 
 uint16_t InetAddress::toPort() const
 {
-    return ntohs(addr_.sin_port);
+    // sin_port和sin6_port在同一个位置
+    return family() == AF_UNIX ? 0 : ntohs(addr_.sin_port);
+}
+
+std::string InetAddress::unixPath() const
+{
+    const size_t header = offsetof(sockaddr_un, sun_path);
+    if (family() != AF_UNIX || len_ <= header)
+    {
+        return std::string(); // 没有bind的客户端
+    }
+    size_t pathLen = len_ - header;
+    if (unix_.sun_path[0] == '\0')
+    {
+        return "@" + std::string(unix_.sun_path + 1, pathLen - 1);
+    }
+    return std::string(unix_.sun_path, strnlen(unix_.sun_path, pathLen));
 }
 
 // #include <iostream>
@@ -1,26 +1,46 @@
 #pragma once
 #include <arpa/inet.h>
 #include <netinet/in.h>
+#include <sys/socket.h>
+#include <sys/un.h>
 #include <string>
 
-// [封装socket地址类型]
+/**
+ * [封装socket地址类型]  IPv4、IPv6、Unix域(文件路径或者Linux的抽象命名空间)都用它，
+ * TcpServer/Acceptor/Socket按family()创建socket，按getSockLen()传地址长度，
+ * 同一套TcpConnection跑在TCP和Unix域socket上
+ */
 class InetAddress // InetAddress是可拷贝的类，muduo里面是继承copyable，我们这里省略即可
 {
 public: //在C里面写成struct sockaddr_in,在C++里面就可以省略struct了
         // explicit抑制构造函数的隐式类型转换
+    // ip里有':'按IPv6解析，比如InetAddress(80, "::1")、InetAddress(80, "::")
     explicit InetAddress(uint16_t port = 0, std::string ip = "127.0.0.1");
-    explicit InetAddress(const sockaddr_in &addr)
-        : addr_(addr)
-    {
-    }
+    explicit InetAddress(const sockaddr_in &addr);
+    explicit InetAddress(const sockaddr_in6 &addr);
+    // [Unix域]  path以'@'开头表示抽象命名空间，不在文件系统里创建文件，进程退出自动消失
+    static InetAddress fromUnixPath(const std::string &path);
+    // accept/getsockname/recvfrom拿到的地址，len是内核返回的长度
+    static InetAddress fromSockAddr(const sockaddr *addr, socklen_t len);
+
+    sa_family_t family() const { return addr_.sin_family; }
+    bool isIpv6() const { return family() == AF_INET6; }
+    bool isUnix() const { return family() == AF_UNIX; }
 
-    std::string toIp() const;
-    std::string toIpPort() const;
-    uint16_t toPort() const;
+    std::string toIp() const;     // Unix域返回""
+    std::string toIpPort() const; // "127.0.0.1:80"、"[::1]:80"、"unix:/tmp/a.sock"、"unix:@name"
+    uint16_t toPort() const;      // Unix域返回0
+    std::string unixPath() const; // 抽象命名空间的以'@'开头；对端没有bind时是""
 
-    const sockaddr_in *getSockAddr() const { return &addr_; }
-    void setSockAddr(const sockaddr_in &addr) { addr_ = addr; }
+    const sockaddr *getSockAddr() const { return reinterpret_cast<const sockaddr *>(&addr_); }
+    socklen_t getSockLen() const { return len_; }
 
 private:
-    sockaddr_in addr_; // InetAddress里面成员是sockaddr_in
+    union
+    {
+        sockaddr_in addr_; // InetAddress里面成员是sockaddr_in，family在三种结构里的位置相同
+        sockaddr_in6 addr6_;
+        sockaddr_un unix_;
+    };
+    socklen_t len_; // Unix域的长度和路径有关(抽象命名空间必须精确)，IP的就是结构体大小
 };
@@ -37,5 +37,7 @@ void Logger::log(std::string msg)
         break;
     }
     // 打印时间和msg
-    std::cout << Timestamp::now().toString() << " : " << msg << std::endl;
+    char timebuf[32];
+    Timestamp::now().format(timebuf, sizeof timebuf);
+    std::cout << timebuf << " : " << msg << std::endl;
 }
\ No newline at end of file
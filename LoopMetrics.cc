@@ -0,0 +1,176 @@
+#include "LoopMetrics.h"
+
+#include <algorithm>
+
+LoopMetricsSnapshot::LoopMetricsSnapshot()
+    : tid(0),
+      loops(0),
+      iterations(0),
+      pollTimeouts(0),
+      events(0),
+      maxEventsPerPoll(0),
+      pollWaitUs(0),
+      handleEventUs(0),
+      pendingFunctorsUs(0),
+      functorsRun(0),
+      maxPendingDepth(0),
+      queueInLoopCalls(0),
+      wakeupsSent(0),
+      wakeupsReceived(0),
+      maxBusyUs(0),
+      spinPolls(0),
+      spinHits(0),
+      spinIdleUs(0)
+{
+    std::fill(eventsPerPoll, eventsPerPoll + kBuckets, 0);
+    std::fill(busyUs, busyUs + kBuckets, 0);
+}
+
+void LoopMetricsSnapshot::merge(const LoopMetricsSnapshot &other)
+{
+    tid = 0;
+    loops += other.loops;
+    iterations += other.iterations;
+    pollTimeouts += other.pollTimeouts;
+    events += other.events;
+    maxEventsPerPoll = std::max(maxEventsPerPoll, other.maxEventsPerPoll);
+    pollWaitUs += other.pollWaitUs;
+    handleEventUs += other.handleEventUs;
+    pendingFunctorsUs += other.pendingFunctorsUs;
+    functorsRun += other.functorsRun;
+    maxPendingDepth = std::max(maxPendingDepth, other.maxPendingDepth);
+    queueInLoopCalls += other.queueInLoopCalls;
+    wakeupsSent += other.wakeupsSent;
+    wakeupsReceived += other.wakeupsReceived;
+    maxBusyUs = std::max(maxBusyUs, other.maxBusyUs);
+    spinPolls += other.spinPolls;
+    spinHits += other.spinHits;
+    spinIdleUs += other.spinIdleUs;
+    for (int i = 0; i < kBuckets; ++i)
+    {
+        eventsPerPoll[i] += other.eventsPerPoll[i];
+        busyUs[i] += other.busyUs[i];
+    }
+}
+
+uint64_t LoopMetricsSnapshot::busyPercentile(double q) const
+{
+    uint64_t total = 0;
+    for (int i = 0; i < kBuckets; ++i)
+    {
+        total += busyUs[i];
+    }
+    if (total == 0)
+    {
+        return 0;
+    }
+    uint64_t target = static_cast<uint64_t>(q * total);
+    uint64_t seen = 0;
+    for (int i = 0; i < kBuckets; ++i)
+    {
+        seen += busyUs[i];
+        if (seen > target)
+        {
+            return i == 0 ? 0 : (1ULL << i);
+        }
+    }
+    return 1ULL << (kBuckets - 1);
+}
+
+LoopMetrics::LoopMetrics(pid_t tid)
+    : tid_(tid),
+      iterations_(0),
+      pollTimeouts_(0),
+      events_(0),
+      maxEventsPerPoll_(0),
+      pollWaitUs_(0),
+      handleEventUs_(0),
+      pendingFunctorsUs_(0),
+      functorsRun_(0),
+      maxPendingDepth_(0),
+      wakeupsReceived_(0),
+      maxBusyUs_(0),
+      spinPolls_(0),
+      spinHits_(0),
+      spinIdleUs_(0),
+      queueInLoopCalls_(0),
+      wakeupsSent_(0)
+{
+    for (int i = 0; i < LoopMetricsSnapshot::kBuckets; ++i)
+    {
+        eventsPerPoll_[i].store(0, std::memory_order_relaxed);
+        busyUs_[i].store(0, std::memory_order_relaxed);
+    }
+}
+
+int LoopMetrics::bucketOf(uint64_t value)
+{
+    int bucket = value == 0 ? 0 : 64 - __builtin_clzll(value);
+    return std::min(bucket, LoopMetricsSnapshot::kBuckets - 1);
+}
+
+void LoopMetrics::onPoll(int numEvents, int64_t waitUs)
+{
+    add(&iterations_, 1);
+    if (numEvents == 0)
+    {
+        add(&pollTimeouts_, 1);
+    }
+    add(&events_, numEvents);
+    updateMax(&maxEventsPerPoll_, numEvents);
+    add(&pollWaitUs_, waitUs);
+    add(&eventsPerPoll_[bucketOf(numEvents)], 1);
+}
+
+void LoopMetrics::onIteration(int64_t handleEventUs, int64_t pendingFunctorsUs, size_t functors)
+{
+    add(&handleEventUs_, handleEventUs);
+    add(&pendingFunctorsUs_, pendingFunctorsUs);
+    add(&functorsRun_, functors);
+    updateMax(&maxPendingDepth_, functors);
+    uint64_t busy = handleEventUs + pendingFunctorsUs;
+    updateMax(&maxBusyUs_, busy);
+    add(&busyUs_[bucketOf(busy)], 1);
+}
+
+void LoopMetrics::onSpin(bool hit, int64_t idleUs)
+{
+    add(&spinPolls_, 1);
+    if (hit)
+    {
+        add(&spinHits_, 1);
+    }
+    else
+    {
+        add(&spinIdleUs_, idleUs);
+    }
+}
+
+LoopMetricsSnapshot LoopMetrics::snapshot() const
+{
+    LoopMetricsSnapshot s;
+    s.tid = tid_;
+    s.loops = 1;
+    s.iterations = iterations_.load(std::memory_order_relaxed);
+    s.pollTimeouts = pollTimeouts_.load(std::memory_order_relaxed);
+    s.events = events_.load(std::memory_order_relaxed);
+    s.maxEventsPerPoll = maxEventsPerPoll_.load(std::memory_order_relaxed);
+    s.pollWaitUs = pollWaitUs_.load(std::memory_order_relaxed);
+    s.handleEventUs = handleEventUs_.load(std::memory_order_relaxed);
+    s.pendingFunctorsUs = pendingFunctorsUs_.load(std::memory_order_relaxed);
+    s.functorsRun = functorsRun_.load(std::memory_order_relaxed);
+    s.maxPendingDepth = maxPendingDepth_.load(std::memory_order_relaxed);
+    s.queueInLoopCalls = queueInLoopCalls_.load(std::memory_order_relaxed);
+    s.wakeupsSent = wakeupsSent_.load(std::memory_order_relaxed);
+    s.wakeupsReceived = wakeupsReceived_.load(std::memory_order_relaxed);
+    s.maxBusyUs = maxBusyUs_.load(std::memory_order_relaxed);
+    s.spinPolls = spinPolls_.load(std::memory_order_relaxed);
+    s.spinHits = spinHits_.load(std::memory_order_relaxed);
+    s.spinIdleUs = spinIdleUs_.load(std::memory_order_relaxed);
+    for (int i = 0; i < LoopMetricsSnapshot::kBuckets; ++i)
+    {
+        s.eventsPerPoll[i] = eventsPerPoll_[i].load(std::memory_order_relaxed);
+        s.busyUs[i] = busyUs_[i].load(std::memory_order_relaxed);
+    }
+    return s;
+}
@@ -0,0 +1,107 @@
+#pragma once
+
+#include "noncopyable.h"
+
+#include <atomic>
+#include <string>
+#include <sys/types.h>
+#include <stdint.h>
+
+/**
+ * [某一时刻的loop指标]  普通的值类型，可以拷贝、跨线程传递、合并
+ * 直方图按2的幂分桶：第i个桶统计[2^(i-1), 2^i)，第0个桶统计0
+ */
+struct LoopMetricsSnapshot
+{
+    static const int kBuckets = 24;
+
+    LoopMetricsSnapshot();
+    void merge(const LoopMetricsSnapshot &other); // 多个loop汇总，max取最大，其他累加
+
+    pid_t tid;            // loop线程，汇总以后是0
+    int loops;            // 汇总了几个loop
+    uint64_t iterations;  // loop()循环的圈数，也就是poll的次数
+    uint64_t pollTimeouts; // poll返回0个事件的次数
+    uint64_t events;      // handleEvent的总次数
+    uint64_t maxEventsPerPoll;
+    uint64_t pollWaitUs;  // 阻塞在poll里的总时间
+    uint64_t handleEventUs;
+    uint64_t pendingFunctorsUs; // doPendingFunctors(包括无锁任务源)的总时间
+    uint64_t functorsRun;
+    uint64_t maxPendingDepth; // 一次swap出来的functor最多有几个
+    uint64_t queueInLoopCalls; // 任何线程往这个loop投递的次数
+    uint64_t wakeupsSent;      // 往这个loop的eventfd写的次数
+    uint64_t wakeupsReceived;
+    uint64_t maxBusyUs; // loop lag：一圈里从poll返回到下一次进poll最长用了多久，这段时间新事件都得等
+    // [忙轮询]  见EventLoop::setBusyPoll
+    uint64_t spinPolls;  // 预算内用timeout=0做的poll
+    uint64_t spinHits;   // 其中拿到了事件或任务的，每一次都省掉了一次睡眠+唤醒
+    uint64_t spinIdleUs; // 空转(什么都没拿到)花掉的CPU时间
+    uint64_t eventsPerPoll[kBuckets];
+    uint64_t busyUs[kBuckets]; // 每圈忙碌时间的分布(微秒)
+
+    // 近似分位数，返回所在桶的上界，比如 busyPercentile(0.99)
+    uint64_t busyPercentile(double q) const;
+};
+
+/**
+ * [每个loop一份的运行时指标]  由EventLoop自己更新：
+ * - 只有loop线程写的字段用relaxed的load+store，没有原子RMW、没有锁
+ * - 别的线程也会写的(queueInLoop、wakeup)用relaxed的fetch_add
+ * 任何线程都可以随时snapshot()，单个字段是原子的，字段之间不保证是同一时刻
+ */
+class LoopMetrics : noncopyable
+{
+public:
+    explicit LoopMetrics(pid_t tid);
+
+    // loop线程调用
+    void onPoll(int numEvents, int64_t waitUs);
+    void onIteration(int64_t handleEventUs, int64_t pendingFunctorsUs, size_t functors);
+    void onWakeupReceived() { add(&wakeupsReceived_, 1); }
+    void onSpin(bool hit, int64_t idleUs);
+
+    // 任何线程调用
+    void onQueueInLoop() { queueInLoopCalls_.fetch_add(1, std::memory_order_relaxed); }
+    void onWakeupSent() { wakeupsSent_.fetch_add(1, std::memory_order_relaxed); }
+
+    LoopMetricsSnapshot snapshot() const;
+
+    static int bucketOf(uint64_t value);
+
+private:
+    // 单写者的计数，不需要原子RMW
+    static void add(std::atomic<uint64_t> *counter, uint64_t delta)
+    {
+        counter->store(counter->load(std::memory_order_relaxed) + delta, std::memory_order_relaxed);
+    }
+    static void updateMax(std::atomic<uint64_t> *counter, uint64_t value)
+    {
+        if (value > counter->load(std::memory_order_relaxed))
+        {
+            counter->store(value, std::memory_order_relaxed);
+        }
+    }
+
+    const pid_t tid_;
+    std::atomic<uint64_t> iterations_;
+    std::atomic<uint64_t> pollTimeouts_;
+    std::atomic<uint64_t> events_;
+    std::atomic<uint64_t> maxEventsPerPoll_;
+    std::atomic<uint64_t> pollWaitUs_;
+    std::atomic<uint64_t> handleEventUs_;
+    std::atomic<uint64_t> pendingFunctorsUs_;
+    std::atomic<uint64_t> functorsRun_;
+    std::atomic<uint64_t> maxPendingDepth_;
+    std::atomic<uint64_t> wakeupsReceived_;
+    std::atomic<uint64_t> maxBusyUs_;
+    std::atomic<uint64_t> spinPolls_;
+    std::atomic<uint64_t> spinHits_;
+    std::atomic<uint64_t> spinIdleUs_;
+    std::atomic<uint64_t> eventsPerPoll_[LoopMetricsSnapshot::kBuckets];
+    std::atomic<uint64_t> busyUs_[LoopMetricsSnapshot::kBuckets];
+    // 下面两个会被其他线程写，单独放一条cache line，不和loop线程的计数互相干扰
+    char pad_[64];
+    std::atomic<uint64_t> queueInLoopCalls_;
+    std::atomic<uint64_t> wakeupsSent_;
+};
@@ -0,0 +1,255 @@
+#include "ShardRouter.h"
+#include "EventLoopThreadPool.h"
+#include "Logger.h"
+
+#include <future>
+
+namespace
+{
+    std::atomic<uint64_t> s_routerCount(0);
+
+    // [缓存当前线程在哪个router里是第几个shard]  一个线程一般只对应一个router，命中时不用查找。
+    // 按实例id而不是地址缓存：router析构后同一地址上新建的router不会命中别的线程里的旧缓存
+    thread_local uint64_t t_routerId = 0;
+    thread_local int t_shard = -1;
+
+    size_t roundUpPowerOfTwo(size_t n)
+    {
+        size_t cap = 2;
+        while (cap < n)
+        {
+            cap <<= 1;
+        }
+        return cap;
+    }
+}
+
+SpscRing::SpscRing(size_t capacity)
+    : slots_(new InlineTask[roundUpPowerOfTwo(capacity)]),
+      mask_(roundUpPowerOfTwo(capacity) - 1),
+      tail_(0),
+      headCache_(0),
+      head_(0)
+{
+}
+
+size_t SpscRing::drain()
+{
+    size_t head = head_.load(std::memory_order_relaxed);
+    const size_t tail = tail_.load(std::memory_order_acquire); // 只执行这一刻之前入队的任务
+    const size_t n = tail - head;
+    for (; head != tail; ++head)
+    {
+        slots_[head & mask_].run();
+        // 每执行一个就归还槽位，生产者不用等整批执行完
+        head_.store(head + 1, std::memory_order_release);
+    }
+    return n;
+}
+
+void ShardRouter::Inbox::drain()
+{
+    size_t n = 0;
+    for (Lane *lane : lanes)
+    {
+        n += lane->ring.drain();
+    }
+    if (n > 0)
+    {
+        drained.store(drained.load(std::memory_order_relaxed) + n, std::memory_order_relaxed);
+    }
+}
+
+bool ShardRouter::Inbox::hasPending() const
+{
+    for (Lane *lane : lanes)
+    {
+        if (!lane->ring.empty())
+        {
+            return true;
+        }
+    }
+    return false;
+}
+
+ShardRouter::ShardRouter(const std::vector<EventLoop *> &loops, size_t ringCapacity)
+    : id_(++s_routerCount), loops_(loops)
+{
+    init(ringCapacity);
+}
+
+ShardRouter::ShardRouter(EventLoopThreadPool *pool, size_t ringCapacity)
+    : id_(++s_routerCount), loops_(pool->getAllLoops())
+{
+    init(ringCapacity);
+}
+
+void ShardRouter::init(size_t ringCapacity)
+{
+    const size_t n = loops_.size();
+    lanes_.reserve(n * n);
+    for (size_t i = 0; i < n * n; ++i)
+    {
+        lanes_.emplace_back(new Lane(ringCapacity));
+    }
+    for (size_t to = 0; to < n; ++to)
+    {
+        std::unique_ptr<Inbox> inbox(new Inbox);
+        for (size_t from = 0; from < n; ++from)
+        {
+            if (from != to)
+            {
+                inbox->lanes.push_back(lanes_[from * n + to].get());
+            }
+        }
+        inboxes_.push_back(std::move(inbox));
+    }
+
+    // [把inbox挂到各自的loop上]  要等所有loop都挂好再返回，否则早到的任务没人唤醒
+    std::vector<std::future<void>> done;
+    for (size_t i = 0; i < n; ++i)
+    {
+        EventLoop *loop = loops_[i];
+        Inbox *inbox = inboxes_[i].get();
+        if (loop->isInLoopThread())
+        {
+            loop->addPendingSource(inbox);
+            continue;
+        }
+        std::shared_ptr<std::promise<void>> registered = std::make_shared<std::promise<void>>();
+        done.push_back(registered->get_future());
+        loop->runInLoop([loop, inbox, registered]()
+                        {
+            loop->addPendingSource(inbox);
+            registered->set_value(); });
+    }
+    for (std::future<void> &f : done)
+    {
+        f.wait();
+    }
+}
+
+ShardRouter::~ShardRouter()
+{
+    // 第一轮在各自的loop里清空收件箱并摘掉；执行的任务可能又post了新的(比如call的回复)，
+    // 队列满的任务还在queueInLoop里排着，一轮轮清到都没有了才释放lanes_，post过的任务都会执行
+    bool detach = true;
+    do
+    {
+        drainAll(detach);
+        detach = false;
+    } while (hasOutstanding());
+}
+
+// 在每个loop里执行一次drain，detach时顺便摘掉inbox；排在之前的queueInLoop任务会先执行完
+void ShardRouter::drainAll(bool detach)
+{
+    std::vector<std::future<void>> done;
+    for (size_t i = 0; i < loops_.size(); ++i)
+    {
+        EventLoop *loop = loops_[i];
+        Inbox *inbox = inboxes_[i].get();
+        if (loop->isInLoopThread())
+        {
+            inbox->drain();
+            if (detach)
+            {
+                loop->removePendingSource(inbox);
+            }
+            continue;
+        }
+        std::shared_ptr<std::promise<void>> drained = std::make_shared<std::promise<void>>();
+        done.push_back(drained->get_future());
+        loop->runInLoop([loop, inbox, detach, drained]()
+                        {
+            inbox->drain();
+            if (detach)
+            {
+                loop->removePendingSource(inbox);
+            }
+            drained->set_value(); });
+    }
+    for (std::future<void> &f : done)
+    {
+        f.wait();
+    }
+}
+
+bool ShardRouter::hasOutstanding() const
+{
+    const size_t n = loops_.size();
+    for (size_t i = 0; i < lanes_.size(); ++i)
+    {
+        const Lane &lane = *lanes_[i];
+        if (!lane.ring.empty())
+        {
+            return true;
+        }
+        // 发往当前线程所在loop的退化任务在析构返回之前没法执行，它们持有Lane，之后执行也是安全的
+        if (lane.overflowPending.load(std::memory_order_acquire) > 0 && !loops_[i % n]->isInLoopThread())
+        {
+            return true;
+        }
+    }
+    return false;
+}
+
+int ShardRouter::currentShard() const
+{
+    if (t_routerId == id_)
+    {
+        return t_shard;
+    }
+    for (size_t i = 0; i < loops_.size(); ++i)
+    {
+        if (loops_[i]->isInLoopThread())
+        {
+            t_routerId = id_;
+            t_shard = static_cast<int>(i);
+            return t_shard;
+        }
+    }
+    return -1;
+}
+
+size_t ShardRouter::callerShard() const
+{
+    int shard = currentShard();
+    if (shard < 0)
+    {
+        LOG_FATAL("ShardRouter::call must be called in a loop thread of the router, reply has no loop to go back to \n");
+    }
+    return static_cast<size_t>(shard);
+}
+
+// [队列满了]  走加锁的queueInLoop；overflowPending>0期间这对loop之间的新任务都走这条路，
+// 直到它们全部执行完，配合doPendingFunctors里先swap再drain的顺序保证FIFO
+void ShardRouter::overflow(const std::shared_ptr<Lane> &lane, size_t shard, EventLoop::Functor f)
+{
+    lane->overflowPending.fetch_add(1, std::memory_order_relaxed);
+    lane->overflowCount.fetch_add(1, std::memory_order_relaxed);
+    loops_[shard]->queueInLoop([lane, f]()
+                               {
+        f();
+        lane->overflowPending.fetch_sub(1, std::memory_order_release); });
+}
+
+uint64_t ShardRouter::ringPushes() const
+{
+    uint64_t n = 0;
+    for (const std::unique_ptr<Inbox> &inbox : inboxes_)
+    {
+        n += inbox->drained.load(std::memory_order_relaxed);
+    }
+    return n;
+}
+
+uint64_t ShardRouter::overflowPushes() const
+{
+    uint64_t n = 0;
+    for (const std::shared_ptr<Lane> &lane : lanes_)
+    {
+        n += lane->overflowCount.load(std::memory_order_relaxed);
+    }
+    return n;
+}
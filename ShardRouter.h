@@ -0,0 +1,247 @@
+#pragma once
+
+#include "noncopyable.h"
+#include "EventLoop.h"
+
+#include <atomic>
+#include <cstddef>
+#include <functional>
+#include <future>
+#include <memory>
+#include <new>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+class EventLoopThreadPool;
+
+/**
+ * [固定大小的任务槽]  可调用对象直接placement new在槽里，不经过std::function和堆分配；
+ * 对象超过kInlineSize时才退化成堆上分配
+ */
+class InlineTask : noncopyable
+{
+public:
+    static const size_t kInlineSize = 112; // 加上两个函数指针正好128字节，两条cache line
+
+    InlineTask() : invoke_(nullptr), destroy_(nullptr) {}
+    ~InlineTask()
+    {
+        if (destroy_ != nullptr)
+        {
+            destroy_(storage());
+        }
+    }
+
+    template <typename F>
+    void emplace(F &&f)
+    {
+        using Fn = typename std::decay<F>::type;
+        emplaceImpl<Fn>(std::forward<F>(f),
+                        std::integral_constant<bool, sizeof(Fn) <= kInlineSize &&
+                                                         alignof(Fn) <= alignof(std::max_align_t)>());
+    }
+
+    // 执行并析构，槽可以被复用
+    void run()
+    {
+        invoke_(storage());
+        destroy_(storage());
+        invoke_ = nullptr;
+        destroy_ = nullptr;
+    }
+
+private:
+    template <typename Fn, typename F>
+    void emplaceImpl(F &&f, std::true_type)
+    {
+        new (storage()) Fn(std::forward<F>(f));
+        invoke_ = &invokeInline<Fn>;
+        destroy_ = &destroyInline<Fn>;
+    }
+    template <typename Fn, typename F>
+    void emplaceImpl(F &&f, std::false_type)
+    {
+        Fn *p = new Fn(std::forward<F>(f));
+        new (storage()) Fn *(p);
+        invoke_ = &invokeHeap<Fn>;
+        destroy_ = &destroyHeap<Fn>;
+    }
+
+    template <typename Fn>
+    static void invokeInline(void *p) { (*static_cast<Fn *>(p))(); }
+    template <typename Fn>
+    static void destroyInline(void *p) { static_cast<Fn *>(p)->~Fn(); }
+    template <typename Fn>
+    static void invokeHeap(void *p) { (**static_cast<Fn **>(p))(); }
+    template <typename Fn>
+    static void destroyHeap(void *p) { delete *static_cast<Fn **>(p); }
+
+    void *storage() { return &storage_; }
+
+    void (*invoke_)(void *);
+    void (*destroy_)(void *);
+    typename std::aligned_storage<kInlineSize, alignof(std::max_align_t)>::type storage_;
+};
+
+/**
+ * [单生产者单消费者的有界环形队列]  生产者和消费者的下标放在不同的cache line上，
+ * 生产者缓存一份消费者下标，只有看起来满了才去读对方的cache line
+ */
+class SpscRing : noncopyable
+{
+public:
+    explicit SpscRing(size_t capacity);
+
+    // 只能在生产者线程调用，满了返回false，此时f没有被move
+    template <typename F>
+    bool tryPush(F &&f)
+    {
+        const size_t tail = tail_.load(std::memory_order_relaxed);
+        if (tail - headCache_ > mask_)
+        {
+            headCache_ = head_.load(std::memory_order_acquire);
+            if (tail - headCache_ > mask_)
+            {
+                return false;
+            }
+        }
+        slots_[tail & mask_].emplace(std::forward<F>(f));
+        tail_.store(tail + 1, std::memory_order_release);
+        return true;
+    }
+
+    // 只能在消费者线程调用：执行调用时刻已经入队的全部任务，返回执行的个数
+    size_t drain();
+    bool empty() const
+    {
+        return head_.load(std::memory_order_relaxed) == tail_.load(std::memory_order_acquire);
+    }
+
+private:
+    std::unique_ptr<InlineTask[]> slots_;
+    const size_t mask_;
+    char pad0_[64];
+    std::atomic<size_t> tail_; // 生产者写
+    size_t headCache_;         // 生产者私有
+    char pad1_[64];
+    std::atomic<size_t> head_; // 消费者写
+    char pad2_[64];
+};
+
+/**
+ * [按loop分片的消息路由]  shard i 就是线程池里的第i个loop。
+ * 每一对(from, to)loop之间有一条SPSC队列，跨loop投递一个任务只是一次入队：
+ * 没有mutex、可调用对象放在队列槽里不用堆分配，目标loop忙的时候也不写eventfd；
+ * 目标loop在doPendingFunctors里批量执行。队列满了退化成queueInLoop，并保证同一对loop之间FIFO。
+ *
+ * - 必须在线程池start之后、loop都在运行的时候构造和析构；析构时会在各自的loop里把已经post的任务都执行完
+ * - post/call可以在任何线程调用；不在池里的线程(比如baseLoop)走queueInLoop路径
+ * - 可调用对象需要可拷贝(退化路径要装进std::function)
+ */
+class ShardRouter : noncopyable
+{
+public:
+    static const size_t kDefaultRingCapacity = 1024;
+
+    ShardRouter(const std::vector<EventLoop *> &loops, size_t ringCapacity = kDefaultRingCapacity);
+    explicit ShardRouter(EventLoopThreadPool *pool, size_t ringCapacity = kDefaultRingCapacity);
+    ~ShardRouter();
+
+    size_t shardCount() const { return loops_.size(); }
+    EventLoop *loopOf(size_t shard) const { return loops_[shard]; }
+    // 当前线程是第几个shard，不是池里的loop线程返回-1
+    int currentShard() const;
+
+    // [在shard所在的loop里执行f]  当前就在这个loop里时直接执行
+    template <typename F>
+    void post(size_t shard, F &&f)
+    {
+        int from = currentShard();
+        if (from == static_cast<int>(shard))
+        {
+            f();
+            return;
+        }
+        if (from < 0)
+        {
+            loops_[shard]->queueInLoop(std::forward<F>(f));
+            return;
+        }
+        const std::shared_ptr<Lane> &lane = lanes_[from * loops_.size() + shard];
+        if (lane->overflowPending.load(std::memory_order_acquire) == 0 &&
+            lane->ring.tryPush(std::forward<F>(f)))
+        {
+            loops_[shard]->wakeupIfPolling();
+            return;
+        }
+        overflow(lane, shard, EventLoop::Functor(std::forward<F>(f)));
+    }
+
+    /**
+     * [请求-回复]  在shard的loop里执行work()，再把结果交给reply，reply在调用者所在的loop里执行。
+     * 只能在池里的loop线程调用，否则LOG_FATAL(回复没有loop可投)
+     */
+    template <typename Work, typename Reply>
+    void call(size_t shard, Work &&work, Reply &&reply)
+    {
+        size_t from = callerShard();
+        ShardRouter *router = this;
+        typename std::decay<Work>::type w(std::forward<Work>(work));
+        typename std::decay<Reply>::type r(std::forward<Reply>(reply));
+        post(shard, [router, from, w, r]()
+             {
+                 auto result = w();
+                 router->post(from, [r, result]()
+                              { r(result); });
+             });
+    }
+
+    // [任意线程提交，拿future等结果]  不要在loop线程里get()，会把loop卡死
+    template <typename Work>
+    std::future<typename std::result_of<Work()>::type> submit(size_t shard, Work &&work)
+    {
+        using R = typename std::result_of<Work()>::type;
+        std::shared_ptr<std::promise<R>> promise = std::make_shared<std::promise<R>>();
+        typename std::decay<Work>::type w(std::forward<Work>(work));
+        post(shard, [promise, w]()
+             { promise->set_value(w()); });
+        return promise->get_future();
+    }
+
+    // [统计]  走无锁队列和走退化路径的次数
+    uint64_t ringPushes() const;
+    uint64_t overflowPushes() const;
+
+private:
+    struct Lane
+    {
+        explicit Lane(size_t capacity) : ring(capacity), overflowPending(0), overflowCount(0) {}
+        SpscRing ring;
+        std::atomic<int> overflowPending; // 已经走queueInLoop、还没执行的任务数，>0时新任务也不能走ring
+        std::atomic<uint64_t> overflowCount;
+    };
+
+    // 每个loop一个，收集所有发往它的Lane
+    class Inbox : public PendingSource
+    {
+    public:
+        Inbox() : drained(0) {}
+        void drain() override;
+        bool hasPending() const override;
+
+        std::vector<Lane *> lanes;
+        std::atomic<uint64_t> drained; // 只有消费者写，统计用
+    };
+
+    void init(size_t ringCapacity);
+    size_t callerShard() const;
+    void overflow(const std::shared_ptr<Lane> &lane, size_t shard, EventLoop::Functor f);
+    void drainAll(bool detach);
+    bool hasOutstanding() const;
+
+    const uint64_t id_; // 区分router实例，线程局部的shard缓存用
+    std::vector<EventLoop *> loops_;
+    std::vector<std::shared_ptr<Lane>> lanes_; // 下标 from * N + to；走queueInLoop的任务也持有一份
+    std::vector<std::unique_ptr<Inbox>> inboxes_;
+};
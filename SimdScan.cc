@@ -0,0 +1,362 @@
+#include "SimdScan.h"
+#include "Logger.h"
+
+#include <stdlib.h>
+#include <strings.h>
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+#define MYMUDUO_SIMD_X86 1
+#endif
+
+namespace simd
+{
+namespace
+{
+    // ================= 标量实现 =================
+    const char *findCharScalar(const char *begin, const char *end, char c)
+    {
+        return static_cast<const char *>(::memchr(begin, c, end - begin));
+    }
+
+    // 先用memchr跳到分隔符首字节，再memcmp比较剩下的字节
+    const char *findDelimScalar(const char *begin, const char *end, const char *delim, size_t len)
+    {
+        while (static_cast<size_t>(end - begin) >= len)
+        {
+            const void *p = ::memchr(begin, delim[0], end - begin - len + 1);
+            if (p == nullptr)
+            {
+                return nullptr;
+            }
+            const char *hit = static_cast<const char *>(p);
+            if (::memcmp(hit + 1, delim + 1, len - 1) == 0)
+            {
+                return hit;
+            }
+            begin = hit + 1;
+        }
+        return nullptr;
+    }
+
+    const char *findClassScalar(const char *begin, const char *end, const CharClass &cc, bool want)
+    {
+        for (const char *p = begin; p < end; ++p)
+        {
+            if (cc.contains(*p) == want)
+            {
+                return p;
+            }
+        }
+        return nullptr;
+    }
+
+#ifdef MYMUDUO_SIMD_X86
+    // ================= SSE2实现(x86_64的基线指令集) =================
+    /**
+     * 多字节分隔符：一次比较16个候选起点，同时检查分隔符的首字节和尾字节，
+     * 两个都命中的位置才用memcmp确认中间的字节，误判率很低
+     */
+    const char *findDelimSse2(const char *begin, const char *end, const char *delim, size_t len)
+    {
+        const __m128i first = _mm_set1_epi8(delim[0]);
+        const __m128i last = _mm_set1_epi8(delim[len - 1]);
+        const char *p = begin;
+        while (end - p >= static_cast<ptrdiff_t>(16 + len - 1))
+        {
+            __m128i a = _mm_loadu_si128(reinterpret_cast<const __m128i *>(p));
+            __m128i b = _mm_loadu_si128(reinterpret_cast<const __m128i *>(p + len - 1));
+            unsigned mask = _mm_movemask_epi8(_mm_and_si128(_mm_cmpeq_epi8(a, first),
+                                                            _mm_cmpeq_epi8(b, last)));
+            while (mask != 0)
+            {
+                int i = __builtin_ctz(mask);
+                if (len <= 2 || ::memcmp(p + i + 1, delim + 1, len - 2) == 0)
+                {
+                    return p + i;
+                }
+                mask &= mask - 1;
+            }
+            p += 16;
+        }
+        return findDelimScalar(p, end, delim, len);
+    }
+
+    inline unsigned classMaskSse2(__m128i chunk, const __m128i *sets, int n)
+    {
+        __m128i hit = _mm_setzero_si128();
+        for (int k = 0; k < n; ++k)
+        {
+            hit = _mm_or_si128(hit, _mm_cmpeq_epi8(chunk, sets[k]));
+        }
+        return _mm_movemask_epi8(hit);
+    }
+
+    const char *findClassSse2(const char *begin, const char *end, const CharClass &cc, bool want)
+    {
+        __m128i sets[CharClass::kMaxSimdChars];
+        const int n = cc.count();
+        for (int k = 0; k < n; ++k)
+        {
+            sets[k] = _mm_set1_epi8(cc.chars()[k]);
+        }
+        const char *p = begin;
+        while (end - p >= 16)
+        {
+            __m128i chunk = _mm_loadu_si128(reinterpret_cast<const __m128i *>(p));
+            unsigned mask = classMaskSse2(chunk, sets, n);
+            if (!want)
+            {
+                mask = ~mask & 0xFFFF;
+            }
+            if (mask != 0)
+            {
+                return p + __builtin_ctz(mask);
+            }
+            p += 16;
+        }
+        return findClassScalar(p, end, cc, want);
+    }
+
+    // ================= AVX2实现(运行时检测，按函数开启target属性，库本身不需要-mavx2) =================
+    __attribute__((target("avx2")))
+    const char *findCharAvx2(const char *begin, const char *end, char c)
+    {
+        const __m256i needle = _mm256_set1_epi8(c);
+        const char *p = begin;
+        while (end - p >= 32)
+        {
+            __m256i chunk = _mm256_loadu_si256(reinterpret_cast<const __m256i *>(p));
+            unsigned mask = _mm256_movemask_epi8(_mm256_cmpeq_epi8(chunk, needle));
+            if (mask != 0)
+            {
+                return p + __builtin_ctz(mask);
+            }
+            p += 32;
+        }
+        return findCharScalar(p, end, c);
+    }
+
+    __attribute__((target("avx2")))
+    inline unsigned delimMaskAvx2(const char *p, size_t len, __m256i first, __m256i last)
+    {
+        __m256i a = _mm256_loadu_si256(reinterpret_cast<const __m256i *>(p));
+        __m256i b = _mm256_loadu_si256(reinterpret_cast<const __m256i *>(p + len - 1));
+        return _mm256_movemask_epi8(_mm256_and_si256(_mm256_cmpeq_epi8(a, first),
+                                                     _mm256_cmpeq_epi8(b, last)));
+    }
+
+    // 一次处理64个候选起点(两个向量)，没有命中时只做一次分支判断
+    __attribute__((target("avx2")))
+    const char *findDelimAvx2(const char *begin, const char *end, const char *delim, size_t len)
+    {
+        const __m256i first = _mm256_set1_epi8(delim[0]);
+        const __m256i last = _mm256_set1_epi8(delim[len - 1]);
+        const char *p = begin;
+        while (end - p >= static_cast<ptrdiff_t>(32 + len - 1))
+        {
+            uint64_t mask = delimMaskAvx2(p, len, first, last);
+            if (end - p >= static_cast<ptrdiff_t>(64 + len - 1))
+            {
+                mask |= static_cast<uint64_t>(delimMaskAvx2(p + 32, len, first, last)) << 32;
+            }
+            while (mask != 0)
+            {
+                int i = __builtin_ctzll(mask);
+                if (len <= 2 || ::memcmp(p + i + 1, delim + 1, len - 2) == 0)
+                {
+                    return p + i;
+                }
+                mask &= mask - 1;
+            }
+            p += (end - p >= static_cast<ptrdiff_t>(64 + len - 1)) ? 64 : 32;
+        }
+        return findDelimScalar(p, end, delim, len);
+    }
+
+    __attribute__((target("avx2")))
+    const char *findClassAvx2(const char *begin, const char *end, const CharClass &cc, bool want)
+    {
+        __m256i sets[CharClass::kMaxSimdChars];
+        const int n = cc.count();
+        for (int k = 0; k < n; ++k)
+        {
+            sets[k] = _mm256_set1_epi8(cc.chars()[k]);
+        }
+        const char *p = begin;
+        while (end - p >= 32)
+        {
+            __m256i chunk = _mm256_loadu_si256(reinterpret_cast<const __m256i *>(p));
+            __m256i hit = _mm256_setzero_si256();
+            for (int k = 0; k < n; ++k)
+            {
+                hit = _mm256_or_si256(hit, _mm256_cmpeq_epi8(chunk, sets[k]));
+            }
+            unsigned mask = _mm256_movemask_epi8(hit);
+            if (!want)
+            {
+                mask = ~mask;
+            }
+            if (mask != 0)
+            {
+                return p + __builtin_ctz(mask);
+            }
+            p += 32;
+        }
+        return findClassSse2(p, end, cc, want);
+    }
+#endif // MYMUDUO_SIMD_X86
+
+    // ================= 运行时分发 =================
+    struct Impl
+    {
+        Level level;
+        const char *(*findChar)(const char *, const char *, char);
+        const char *(*findDelim)(const char *, const char *, const char *, size_t);
+        const char *(*findClass)(const char *, const char *, const CharClass &, bool);
+    };
+
+    Level supportedLevel()
+    {
+#ifdef MYMUDUO_SIMD_X86
+        __builtin_cpu_init();
+        if (__builtin_cpu_supports("avx2"))
+        {
+            return kAvx2;
+        }
+        return kSse2;
+#else
+        return kScalar;
+#endif
+    }
+
+    Impl makeImpl(Level level)
+    {
+        Level maxLevel = supportedLevel();
+        if (level > maxLevel)
+        {
+            level = maxLevel;
+        }
+        // 单字节查找SSE2级别直接用libc的memchr，glibc本身已经是向量化的
+        Impl impl = {kScalar, findCharScalar, findDelimScalar, findClassScalar};
+#ifdef MYMUDUO_SIMD_X86
+        if (level == kSse2)
+        {
+            impl.level = kSse2;
+            impl.findDelim = findDelimSse2;
+            impl.findClass = findClassSse2;
+        }
+        else if (level == kAvx2)
+        {
+            impl.level = kAvx2;
+            impl.findChar = findCharAvx2;
+            impl.findDelim = findDelimAvx2;
+            impl.findClass = findClassAvx2;
+        }
+#endif
+        return impl;
+    }
+
+    Impl &impl()
+    {
+        static Impl instance = []()
+        {
+            Level level = supportedLevel();
+            const char *env = ::getenv("MYMUDUO_SIMD");
+            if (env != nullptr)
+            {
+                if (::strcasecmp(env, "scalar") == 0)
+                    level = kScalar;
+                else if (::strcasecmp(env, "sse2") == 0)
+                    level = kSse2;
+                else if (::strcasecmp(env, "avx2") == 0)
+                    level = kAvx2;
+                else
+                    LOG_INFO("MYMUDUO_SIMD=%s not recognised, using %s\n", env, levelName(level));
+                // 强制的级别CPU不支持时makeImpl会降到支持的最高级别，这里打一行日志说明
+                if (level > supportedLevel())
+                    LOG_INFO("MYMUDUO_SIMD=%s not supported by this CPU, falling back to %s\n",
+                             env, levelName(supportedLevel()));
+            }
+            return makeImpl(level);
+        }();
+        return instance;
+    }
+} // namespace
+
+Level currentLevel()
+{
+    return impl().level;
+}
+
+Level setLevel(Level level)
+{
+    impl() = makeImpl(level);
+    return impl().level;
+}
+
+const char *levelName(Level level)
+{
+    switch (level)
+    {
+    case kSse2:
+        return "sse2";
+    case kAvx2:
+        return "avx2";
+    default:
+        return "scalar";
+    }
+}
+
+const char *findChar(const char *begin, const char *end, char c)
+{
+    if (begin >= end)
+    {
+        return nullptr;
+    }
+    return impl().findChar(begin, end, c);
+}
+
+const char *findDelim(const char *begin, const char *end, const char *delim, size_t delimLen)
+{
+    if (delimLen == 0)
+    {
+        return begin;
+    }
+    if (delimLen == 1)
+    {
+        return findChar(begin, end, delim[0]);
+    }
+    if (end - begin < static_cast<ptrdiff_t>(delimLen))
+    {
+        return nullptr;
+    }
+    return impl().findDelim(begin, end, delim, delimLen);
+}
+
+const char *findFirstOf(const char *begin, const char *end, const CharClass &cc)
+{
+    if (begin >= end)
+    {
+        return nullptr;
+    }
+    if (!cc.vectorizable())
+    {
+        return findClassScalar(begin, end, cc, true);
+    }
+    return impl().findClass(begin, end, cc, true);
+}
+
+const char *findFirstNotOf(const char *begin, const char *end, const CharClass &cc)
+{
+    if (begin >= end)
+    {
+        return nullptr;
+    }
+    if (!cc.vectorizable())
+    {
+        return findClassScalar(begin, end, cc, false);
+    }
+    return impl().findClass(begin, end, cc, false);
+}
+} // namespace simd
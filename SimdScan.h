@@ -0,0 +1,78 @@
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+#include <string.h>
+
+/**
+ * [Buffer底层的向量化扫描函数]
+ * 文本协议(RESP、HTTP/1.1、memcached)的解析时间大部分花在找"\r\n"、':'这类分隔符上。
+ * 这里提供SSE2/AVX2两套实现和一个标量实现，第一次调用时根据CPU支持情况选择，
+ * 也可以通过环境变量MYMUDUO_SIMD=scalar|sse2|avx2强制指定(压测对比用)，CPU不支持时降级并打日志。
+ * 所有函数都在[begin, end)里查找，找不到返回nullptr，不会读越过end的内存。
+ */
+namespace simd
+{
+    enum Level
+    {
+        kScalar,
+        kSse2,
+        kAvx2,
+    };
+
+    // [字符类] 比如HTTP里的" \t"、":"，RESP里的"\r\n"；最多kMaxSimdChars个字符走向量化路径
+    class CharClass
+    {
+    public:
+        static const int kMaxSimdChars = 16;
+
+        CharClass() : count_(0) { ::memset(table_, 0, sizeof table_); }
+        explicit CharClass(const char *chars)
+            : count_(0)
+        {
+            ::memset(table_, 0, sizeof table_);
+            while (*chars)
+            {
+                add(*chars++);
+            }
+        }
+
+        void add(char c)
+        {
+            unsigned char u = static_cast<unsigned char>(c);
+            if (table_[u] == 0)
+            {
+                table_[u] = 1;
+                if (count_ < kMaxSimdChars)
+                {
+                    chars_[count_] = c;
+                }
+                ++count_;
+            }
+        }
+
+        bool contains(char c) const { return table_[static_cast<unsigned char>(c)] != 0; }
+        int count() const { return count_; }
+        const char *chars() const { return chars_; }
+        bool vectorizable() const { return count_ <= kMaxSimdChars; }
+
+    private:
+        uint8_t table_[256]; // 标量路径查表用
+        char chars_[kMaxSimdChars];
+        int count_;
+    };
+
+    // 当前使用的实现
+    Level currentLevel();
+    // 强制切换实现，超过CPU支持的级别会被降级；只应该在启动阶段(loop运行之前)调用
+    Level setLevel(Level level);
+    const char *levelName(Level level);
+
+    // 单字节查找
+    const char *findChar(const char *begin, const char *end, char c);
+    // 多字节分隔符查找，返回分隔符第一个字节的位置
+    const char *findDelim(const char *begin, const char *end, const char *delim, size_t delimLen);
+    // 第一个属于/不属于字符类cc的字节
+    const char *findFirstOf(const char *begin, const char *end, const CharClass &cc);
+    const char *findFirstNotOf(const char *begin, const char *end, const CharClass &cc);
+}
@@ -2,6 +2,7 @@
 #include "Logger.h"
 #include "InetAddress.h"
 
+#include <errno.h>
 #include <unistd.h>
 #include <sys/types.h>
 #include <sys/socket.h>
@@ -9,6 +10,10 @@
 #include <netinet/tcp.h>
 #include <sys/socket.h>
 
+#ifndef SO_ZEROCOPY
+#define SO_ZEROCOPY 60 // linux 4.14
+#endif
+
 Socket::~Socket()
 {
     close(sockfd_); //析构函数中关闭文件描述符
@@ -16,15 +21,15 @@ Socket::~Socket()
 
 void Socket::bindAddress(const InetAddress &localaddr)
 {
-    if (0 != ::bind(sockfd_, (sockaddr *)localaddr.getSockAddr(), sizeof(sockaddr_in)))
+    if (0 != ::bind(sockfd_, localaddr.getSockAddr(), localaddr.getSockLen()))
     {
-        LOG_FATAL("bind sockfd:%d fail \n", sockfd_);
+        LOG_FATAL("bind sockfd:%d to %s fail, errno=%d \n", sockfd_, localaddr.toIpPort().c_str(), errno);
     }
 }
 
-void Socket::listen()
+void Socket::listen(int backlog)
 { //加上全局作用域::就是为了防止跟局部方法产生冲突
-    if (0 != ::listen(sockfd_, 1024))
+    if (0 != ::listen(sockfd_, backlog))
     {
         LOG_FATAL("listen sockfd:%d fail \n", sockfd_);
     }
@@ -38,7 +43,7 @@ int Socket::accept(InetAddress *peeraddr)
      * Reactor模型 one loop per thread
      * IO多路复用-eoll   + non-blocking IO
      */
-    sockaddr_in addr;
+    sockaddr_storage addr; // IPv4、IPv6、Unix域都放得下
     socklen_t len = sizeof addr;
     bzero(&addr, sizeof addr);
     //这里sockfd就是listenfd
@@ -47,7 +52,7 @@ int Socket::accept(InetAddress *peeraddr)
     // accept4相比accept第四个参数可以设置套接字的一些属性，比如非阻塞O_NOBLOCK
     if (connfd >= 0)
     {
-        peeraddr->setSockAddr(addr);
+        *peeraddr = InetAddress::fromSockAddr((sockaddr *)&addr, len);
     }
     return connfd;
 }
@@ -78,6 +83,47 @@ void Socket::setReusePort(bool on)
     ::setsockopt(sockfd_, SOL_SOCKET, SO_REUSEPORT, &optval, sizeof optval);
 }
 
+#ifndef SO_PREFER_BUSY_POLL
+#define SO_PREFER_BUSY_POLL 69 // linux 5.11，老的libc头文件里没有
+#endif
+
+bool Socket::setBusyPoll(int usec)
+{
+    if (::setsockopt(sockfd_, SOL_SOCKET, SO_BUSY_POLL, &usec, sizeof usec) < 0)
+    {
+        return false;
+    }
+    int on = 1;
+    ::setsockopt(sockfd_, SOL_SOCKET, SO_PREFER_BUSY_POLL, &on, sizeof on); // 老内核不支持，不影响SO_BUSY_POLL
+    return true;
+}
+
+bool Socket::setZeroCopy(bool on)
+{
+    int optval = on ? 1 : 0;
+    return ::setsockopt(sockfd_, SOL_SOCKET, SO_ZEROCOPY, &optval, sizeof optval) == 0;
+}
+
+bool Socket::setDeferAccept(int seconds)
+{
+    return ::setsockopt(sockfd_, IPPROTO_TCP, TCP_DEFER_ACCEPT, &seconds, sizeof seconds) == 0;
+}
+
+bool Socket::setFastOpen(int queueLength)
+{
+    return ::setsockopt(sockfd_, IPPROTO_TCP, TCP_FASTOPEN, &queueLength, sizeof queueLength) == 0;
+}
+
+bool Socket::setSendBufferSize(int bytes)
+{
+    return ::setsockopt(sockfd_, SOL_SOCKET, SO_SNDBUF, &bytes, sizeof bytes) == 0;
+}
+
+bool Socket::setRecvBufferSize(int bytes)
+{
+    return ::setsockopt(sockfd_, SOL_SOCKET, SO_RCVBUF, &bytes, sizeof bytes) == 0;
+}
+
 void Socket::setKeepAlive(bool on)
 {
     int optval = on ? 1 : 0;
@@ -17,7 +17,7 @@ public:
 
     int fd() const { return sockfd_; }
     void bindAddress(const InetAddress &localaddr); //绑定传进来的inteaddress(ip+port)
-    void listen();                                  //封装listen系统调用
+    void listen(int backlog = 1024);                //封装listen系统调用，实际上限还受net.core.somaxconn限制
     int accept(InetAddress *peeraddr);              // acceptr提取新连接从全连接队列里面
 
     void shutdownWrite(); //封装shutdown半关闭,关闭写端
@@ -26,6 +26,18 @@ public:
     void setReuseAddr(bool on);  //设置地址重用
     void setReusePort(bool on);  //设置端口重用
     void setKeepAlive(bool on);  //设置保活
+    // SO_BUSY_POLL + SO_PREFER_BUSY_POLL，在这个socket上读、epoll时先在驱动队列上轮询usec微秒；
+    // 超过net.core.busy_read的值需要CAP_NET_ADMIN，失败返回false
+    bool setBusyPoll(int usec);
+    // SO_ZEROCOPY，允许send带MSG_ZEROCOPY；内核不支持(<4.14)或者不是TCP/UDP socket时返回false
+    bool setZeroCopy(bool on);
+    // [监听socket]  TCP_DEFER_ACCEPT：三次握手完成后等seconds秒内的第一批数据到了才放进accept队列
+    bool setDeferAccept(int seconds);
+    // TCP_FASTOPEN：SYN里带的数据直接交给新连接，queueLength是还没完成握手的TFO连接上限
+    bool setFastOpen(int queueLength);
+    // SO_SNDBUF/SO_RCVBUF，内核实际用两倍；设置以后不再自动调整
+    bool setSendBufferSize(int bytes);
+    bool setRecvBufferSize(int bytes);
 
 private:
     const int sockfd_; // socket类封装sockfd
@@ -0,0 +1,122 @@
+#pragma once
+
+#include <string>
+#include <cstring>
+#include <ostream>
+
+/**
+ * [不持有内存的只读字符串视图]  C++11没有std::string_view，这里参照muduo的StringPiece实现一个简化版本
+ * 只保存指针和长度，拷贝开销就是两个字长；指向的内存(比如Buffer的可读区)必须比StringPiece活得久
+ */
+class StringPiece
+{
+public:
+    StringPiece()
+        : ptr_(nullptr), length_(0)
+    {
+    }
+    StringPiece(const char *str)
+        : ptr_(str), length_(static_cast<size_t>(strlen(str)))
+    {
+    }
+    StringPiece(const std::string &str)
+        : ptr_(str.data()), length_(str.size())
+    {
+    }
+    StringPiece(const char *offset, size_t len)
+        : ptr_(offset), length_(len)
+    {
+    }
+
+    const char *data() const { return ptr_; }
+    size_t size() const { return length_; }
+    bool empty() const { return length_ == 0; }
+    const char *begin() const { return ptr_; }
+    const char *end() const { return ptr_ + length_; }
+
+    char operator[](size_t i) const { return ptr_[i]; }
+
+    void clear()
+    {
+        ptr_ = nullptr;
+        length_ = 0;
+    }
+    void set(const char *buffer, size_t len)
+    {
+        ptr_ = buffer;
+        length_ = len;
+    }
+
+    // [从前面/后面去掉n个字节，只移动指针，不拷贝数据]
+    void remove_prefix(size_t n)
+    {
+        ptr_ += n;
+        length_ -= n;
+    }
+    void remove_suffix(size_t n)
+    {
+        length_ -= n;
+    }
+
+    // [子视图] pos超出范围返回空视图，len超出范围截断到末尾
+    StringPiece substr(size_t pos, size_t len = static_cast<size_t>(-1)) const
+    {
+        if (pos > length_)
+        {
+            return StringPiece();
+        }
+        size_t rlen = length_ - pos < len ? length_ - pos : len;
+        return StringPiece(ptr_ + pos, rlen);
+    }
+
+    // [查找字符c] 返回下标，找不到返回npos
+    size_t find(char c, size_t pos = 0) const
+    {
+        if (pos >= length_)
+        {
+            return npos;
+        }
+        const void *p = ::memchr(ptr_ + pos, c, length_ - pos);
+        return p == nullptr ? npos : static_cast<const char *>(p) - ptr_;
+    }
+
+    bool starts_with(const StringPiece &x) const
+    {
+        return length_ >= x.length_ && ::memcmp(ptr_, x.ptr_, x.length_) == 0;
+    }
+
+    int compare(const StringPiece &x) const
+    {
+        size_t n = length_ < x.length_ ? length_ : x.length_;
+        int r = n == 0 ? 0 : ::memcmp(ptr_, x.ptr_, n);
+        if (r == 0)
+        {
+            if (length_ < x.length_)
+                r = -1;
+            else if (length_ > x.length_)
+                r = +1;
+        }
+        return r;
+    }
+
+    bool operator==(const StringPiece &x) const
+    {
+        return length_ == x.length_ && (length_ == 0 || ::memcmp(ptr_, x.ptr_, length_) == 0);
+    }
+    bool operator!=(const StringPiece &x) const { return !(*this == x); }
+
+    // [只有真的需要持有数据的时候才拷贝成string]
+    std::string as_string() const { return std::string(ptr_, length_); }
+    void CopyToString(std::string *target) const { target->assign(ptr_, length_); }
+
+    static const size_t npos = static_cast<size_t>(-1);
+
+private:
+    const char *ptr_;
+    size_t length_;
+};
+
+inline std::ostream &operator<<(std::ostream &o, const StringPiece &piece)
+{
+    return o.write(piece.data(), piece.size());
+}
@@ -22,63 +22,358 @@ static EventLoop *CheckLoopNotNull(EventLoop *loop)
     return loop;
 }
 
+namespace
+{
+    /**
+     * [按块大小缓存的线程本地空闲链表]  块释放到当前线程的链表里，下次同样大小的分配直接取；
+     * 每个线程最多缓存kMaxCached块，多出来的还给operator delete。
+     * 线程退出时链表析构，之后这个线程里再释放的块直接delete
+     */
+    template <size_t Size>
+    class BlockCache
+    {
+    public:
+        static const size_t kMaxCached = 4096;
+
+        static void *allocate()
+        {
+            FreeList &list = freeList();
+            if (list.head != nullptr)
+            {
+                Node *node = list.head;
+                list.head = node->next;
+                --list.count;
+                return node;
+            }
+            return ::operator new(Size);
+        }
+
+        static void deallocate(void *p)
+        {
+            if (!t_exited_)
+            {
+                FreeList &list = freeList();
+                if (list.count < kMaxCached)
+                {
+                    Node *node = static_cast<Node *>(p);
+                    node->next = list.head;
+                    list.head = node;
+                    ++list.count;
+                    return;
+                }
+            }
+            ::operator delete(p);
+        }
+
+    private:
+        struct Node
+        {
+            Node *next;
+        };
+        struct FreeList
+        {
+            FreeList() : head(nullptr), count(0) {}
+            ~FreeList()
+            {
+                t_exited_ = true;
+                while (head != nullptr)
+                {
+                    Node *next = head->next;
+                    ::operator delete(head);
+                    head = next;
+                }
+            }
+            Node *head;
+            size_t count;
+        };
+
+        static FreeList &freeList()
+        {
+            static thread_local FreeList list;
+            return list;
+        }
+        static thread_local bool t_exited_;
+    };
+
+    template <size_t Size>
+    thread_local bool BlockCache<Size>::t_exited_ = false;
+
+    // 给allocate_shared用：单个对象走BlockCache，rebind到控制块类型以后按控制块的大小缓存
+    template <typename T>
+    class PooledAllocator
+    {
+    public:
+        using value_type = T;
+
+        PooledAllocator() {}
+        template <typename U>
+        PooledAllocator(const PooledAllocator<U> &) {}
+
+        T *allocate(size_t n)
+        {
+            if (n == 1)
+            {
+                return static_cast<T *>(BlockCache<sizeof(T)>::allocate());
+            }
+            return static_cast<T *>(::operator new(n * sizeof(T)));
+        }
+        void deallocate(T *p, size_t n)
+        {
+            if (n == 1)
+            {
+                BlockCache<sizeof(T)>::deallocate(p);
+                return;
+            }
+            ::operator delete(p);
+        }
+
+        template <typename U>
+        bool operator==(const PooledAllocator<U> &) const { return true; }
+        template <typename U>
+        bool operator!=(const PooledAllocator<U> &) const { return false; }
+    };
+}
+
+TcpConnectionPtr TcpConnection::create(EventLoop *loop,
+                                       const ConnectionCallbacksPtr &callbacks,
+                                       uint64_t id,
+                                       int sockfd,
+                                       const InetAddress &peerAddr)
+{
+    return std::allocate_shared<TcpConnection>(PooledAllocator<TcpConnection>(),
+                                               loop, callbacks, id, sockfd, peerAddr);
+}
+
 TcpConnection::TcpConnection(EventLoop *loop,
-                             const std::string &nameArg,
+                             const ConnectionCallbacksPtr &callbacks,
+                             uint64_t id,
                              int sockfd,
-                             const InetAddress &localAddr,
                              const InetAddress &peerAddr)
-    : loop_(CheckLoopNotNull(loop)), name_(nameArg), state_(kConnecting), reading_(true), socket_(new Socket(sockfd)) //把sockfd打包成socket
-      ,
-      channel_(new Channel(loop, sockfd)) //把sockfd和所在的loop打包成channel
-      ,
-      localAddr_(localAddr), peerAddr_(peerAddr), highWaterMark_(64 * 1024 * 1024) // 设置高水位标记: 64M
+    : loop_(CheckLoopNotNull(loop)), callbacks_(callbacks), id_(id), state_(kConnecting), reading_(true),
+      ownsCallbacks_(false), corkScheduled_(false), announced_(false),
+      socket_(sockfd),        //把sockfd打包成socket
+      channel_(loop, sockfd), //把sockfd和所在的loop打包成channel
+      peerAddr_(peerAddr)
 //之前acccptor只设置了readcallback，这里tcpconnection要设置很多的回调如下:
 {
     // 下面给channel设置相应的回调函数，poller给channel通知感兴趣的事件发生了，channel会回调相应的操作函数
-    channel_->setReadCallback(
-        std::bind(&TcpConnection::handleRead, this, std::placeholders::_1));
-    channel_->setWriteCallback(
-        std::bind(&TcpConnection::handleWrite, this));
-    channel_->setCloseCallback(
-        std::bind(&TcpConnection::handleClose, this));
-    channel_->setErrorCallback(
-        std::bind(&TcpConnection::handleError, this));
-
-    LOG_INFO("TcpConnection::ctor[%s] at fd=%d\n", name_.c_str(), sockfd);
-    socket_->setKeepAlive(true); //启动tcp的保活机制
+    // 只捕获this的lambda能放进std::function的内部存储，std::bind(成员函数指针, this)放不下，每个都要堆分配
+    channel_.setReadCallback([this](Timestamp receiveTime)
+                             { handleRead(receiveTime); });
+    channel_.setWriteCallback([this]()
+                              { handleWrite(); });
+    channel_.setCloseCallback([this]()
+                              { handleClose(); });
+    channel_.setErrorCallback([this]()
+                              { handleError(); });
+
+    if (callbacks_->filterFactory)
+    {
+        filter_ = callbacks_->filterFactory();
+    }
+
+    LOG_DEBUG("TcpConnection::ctor[%s] at fd=%d\n", name().c_str(), sockfd);
+    socket_.setKeepAlive(true); //启动tcp的保活机制
+    // 每个连接的socket选项在它的io loop里设置，baseLoop只管accept
+    if (callbacks_->tcpNoDelay && !peerAddr_.isUnix())
+    {
+        socket_.setTcpNoDelay(true);
+    }
+    if (callbacks_->sendBufferBytes > 0)
+    {
+        socket_.setSendBufferSize(callbacks_->sendBufferBytes);
+    }
+    if (callbacks_->recvBufferBytes > 0)
+    {
+        socket_.setRecvBufferSize(callbacks_->recvBufferBytes);
+    }
+    if (callbacks_->socketBusyPollUs > 0 && !socket_.setBusyPoll(callbacks_->socketBusyPollUs))
+    {
+        static std::atomic_bool warned(false); // 每个连接都会失败，只报一次
+        if (!warned.exchange(true))
+        {
+            LOG_ERROR("TcpConnection::ctor SO_BUSY_POLL %dus failed, errno=%d \n", callbacks_->socketBusyPollUs, errno);
+        }
+    }
+    // TLS这类filter要先加密再写，数据没法整块转交，不开
+    if (callbacks_->zeroCopyThreshold > 0 && !filter_)
+    {
+        bool zerocopy = socket_.setZeroCopy(true);
+        if (!zerocopy)
+        {
+            static std::atomic_bool warned(false);
+            if (!warned.exchange(true)) // 内核太老或者Unix域socket，只保留整块转交
+            {
+                LOG_ERROR("TcpConnection::ctor SO_ZEROCOPY failed, errno=%d \n", errno);
+            }
+        }
+        zerocopy_.reset(new ZeroCopyQueue(loop_, zerocopy));
+    }
 }
 
 TcpConnection::~TcpConnection()
 {
     // tcpconnection开辟的额外资源是使用智能指针管理的，所以这里不需要处理资源回收的操作。
-    LOG_INFO("TcpConnection::dtor[%s] at fd=%d state=%d \n",
-             name_.c_str(), channel_->fd(), (int)state_);
+    LOG_DEBUG("TcpConnection::dtor[%s] at fd=%d state=%d \n",
+             name().c_str(), channel_.fd(), (int)state_);
 }
 
 void TcpConnection::send(const std::string &buf)
+{
+    send(buf.data(), buf.size());
+}
+
+void TcpConnection::send(const void *data, size_t len)
 {
     //执行sendinloop
     if (state_ == kConnected)
     {
         if (loop_->isInLoopThread()) //[当前loop是不是在在他对应的线程里面]
         {
-            sendInLoop(buf.c_str(), buf.size());
+            sendInLoop(data, len);
+        }
+        else
+        {
+            // 跨线程发送要把数据拷贝一份带过去，调用者的内存等不到loop线程执行
+            std::string message(static_cast<const char *>(data), len);
+            TcpConnectionPtr self(shared_from_this());
+            loop_->runInLoop([self, message]()
+                             { self->sendInLoop(message.data(), message.size()); });
+        }
+    }
+}
+
+const InetAddress &TcpConnection::localAddress() const
+{
+    if (!localAddr_)
+    {
+        // 通过sockfd获取其绑定的本机地址，IPv4、IPv6、Unix域都放得下
+        sockaddr_storage local;
+        ::bzero(&local, sizeof local);
+        socklen_t addrlen = sizeof local;
+        if (::getsockname(socket_.fd(), (sockaddr *)&local, &addrlen) < 0)
+        {
+            LOG_ERROR("sockets::getLocalAddr");
+            addrlen = 0;
+        }
+        localAddr_.reset(new InetAddress(InetAddress::fromSockAddr((sockaddr *)&local, addrlen)));
+    }
+    return *localAddr_;
+}
+
+ConnectionCallbacks *TcpConnection::mutableCallbacks()
+{
+    if (!ownsCallbacks_)
+    {
+        callbacks_ = std::make_shared<ConnectionCallbacks>(*callbacks_);
+        ownsCallbacks_ = true;
+    }
+    // callbacks_现在指向这个连接自己new出来的非const对象
+    return const_cast<ConnectionCallbacks *>(callbacks_.get());
+}
+
+ConnectionStatsSnapshot TcpConnection::stats() const
+{
+    ConnectionStatsSnapshot s;
+    s.name = name();
+    s.peer = peerAddr_.toIpPort();
+    stats_.fill(&s, Timestamp::monotonicMicros());
+    return s;
+}
+
+void TcpConnection::send(Buffer *buf)
+{
+    if (zerocopy_ && buf->readableBytes() >= callbacks_->zeroCopyThreshold)
+    {
+        if (state_ != kConnected)
+        {
+            return;
+        }
+        if (loop_->isInLoopThread())
+        {
+            sendZeroCopyInLoop(buf);
         }
         else
         {
-            loop_->runInLoop(std::bind(
-                &TcpConnection::sendInLoop,
-                this,
-                buf.c_str(),
-                buf.size()));
+            // 跨线程也不拷贝：存储换到一个新Buffer里带过去
+            std::shared_ptr<Buffer> moved = std::make_shared<Buffer>(0);
+            moved->swap(*buf);
+            TcpConnectionPtr self(shared_from_this());
+            loop_->runInLoop([self, moved]()
+                             { self->sendZeroCopyInLoop(moved.get()); });
+        }
+        return;
+    }
+    send(buf->peek(), buf->readableBytes());
+    buf->retrieveAll();
+}
+
+void TcpConnection::sendZeroCopyInLoop(Buffer *buf)
+{
+    if (state_ == kDisconnected)
+    {
+        LOG_ERROR("disconnected, give up writing!");
+        return;
+    }
+    size_t oldLen = outputBytes();
+    size_t len = buf->readableBytes();
+    if (oldLen + len >= callbacks_->highWaterMark && oldLen < callbacks_->highWaterMark && callbacks_->highWaterMarkCallback)
+    {
+        TcpConnectionPtr self(shared_from_this());
+        size_t queued = oldLen + len;
+        loop_->queueInLoop([self, queued]()
+                           { self->callbacks_->highWaterMarkCallback(self, queued); });
+    }
+    zerocopy_->append(buf);
+    stats_.setOutputQueue(outputBytes());
+    if (channel_.isWriting())
+    {
+        return; // handleWrite会接着发
+    }
+    if (callbacks_->autoCork)
+    {
+        if (!corkScheduled_)
+        {
+            corkScheduled_ = true;
+            loop_->deferFlush(this);
         }
+        return;
+    }
+    flush(); // 和writeInLoop的直接写一样马上写，写不完的交给handleWrite
+}
+
+namespace
+{
+    // filter_变换出来的字节先放这里再writeInLoop，每个线程一个，不用每次分配
+    Buffer &filterScratch()
+    {
+        static thread_local Buffer buffer;
+        return buffer;
+    }
+}
+
+void TcpConnection::sendInLoop(const void *data, size_t len)
+{
+    if (!filter_)
+    {
+        writeInLoop(data, len);
+        return;
+    }
+    if (state_ == kDisconnected)
+    {
+        LOG_ERROR("disconnected, give up writing!");
+        return;
     }
+    Buffer &out = filterScratch();
+    filter_->encode(data, len, &out);
+    writeInLoop(out.peek(), out.readableBytes());
+    out.retrieveAll();
 }
 
 /**
  * 发送数据：应用写的快，而内核发送数据慢，需要把待发送数据写入缓冲区，而且设置了水位回调
  */
-void TcpConnection::sendInLoop(const void *data, size_t len)
+void TcpConnection::writeInLoop(const void *data, size_t len)
 {
     ssize_t nwrote = 0;     //写的数据
     size_t remaining = len; //没发送的数据
@@ -95,17 +390,21 @@ void TcpConnection::sendInLoop(const void *data, size_t len)
                     :不能发完，
 
      */
-    if (!channel_->isWriting() && outputBuffer_.readableBytes() == 0)
+    // [auto-cork]  不直接写，下面追加到outputBuffer以后登记本轮末尾的flush
+    const bool cork = callbacks_->autoCork && !channel_.isWriting();
+    if (!cork && !channel_.isWriting() && outputBytes() == 0)
     {
-        nwrote = ::write(channel_->fd(), data, len); //发送数据
+        nwrote = ::write(channel_.fd(), data, len); //发送数据
         if (nwrote >= 0)                             //发送成功了
         {
+            stats_.onWrite(nwrote);
             remaining = len - nwrote; //剩余待发送数据
-            if (remaining == 0 && writeCompleteCallback_)
+            if (remaining == 0 && callbacks_->writeCompleteCallback && announced_)
             {
                 //[既然在这里数据全部发送完成，就不用再给channel设置epollout事件了]
-                loop_->queueInLoop(
-                    std::bind(writeCompleteCallback_, shared_from_this()));
+                TcpConnectionPtr self(shared_from_this());
+                loop_->queueInLoop([self]()
+                                   { self->callbacks_->writeCompleteCallback(self); });
             }
         }
         else // nwrote < 0,出错
@@ -128,18 +427,39 @@ void TcpConnection::sendInLoop(const void *data, size_t len)
     if (!faultError && remaining > 0) //没有出错，数据没有发送完成。
     {
         // 目前发送缓冲区剩余的待发送数据的长度
-        size_t oldLen = outputBuffer_.readableBytes();
-        if (oldLen + remaining >= highWaterMark_ && oldLen < highWaterMark_ && highWaterMarkCallback_)
+        size_t oldLen = outputBytes();
+        if (oldLen + remaining >= callbacks_->highWaterMark && oldLen < callbacks_->highWaterMark && callbacks_->highWaterMarkCallback)
         {
-            loop_->queueInLoop(
-                std::bind(highWaterMarkCallback_, shared_from_this(), oldLen + remaining));
+            TcpConnectionPtr self(shared_from_this());
+            size_t queued = oldLen + remaining;
+            loop_->queueInLoop([self, queued]()
+                               { self->callbacks_->highWaterMarkCallback(self, queued); });
             //调用高水位回调函数
         }
-        outputBuffer_.append((char *)data + nwrote, remaining); //把剩余没发送的数据拷贝到缓冲区
-        if (!channel_->isWriting())
+        const char *rest = static_cast<const char *>(data) + nwrote;
+        if (zerocopy_ && (remaining >= callbacks_->zeroCopyThreshold || !zerocopy_->empty()))
+        {
+            // 反正要拷贝一次，大块拷进能用MSG_ZEROCOPY发的块里；队列非空时小块也排在后面，保证顺序
+            zerocopy_->append(rest, remaining, remaining >= callbacks_->zeroCopyThreshold);
+        }
+        else
+        {
+            outputBuffer_.append(rest, remaining); //把剩余没发送的数据拷贝到缓冲区
+        }
+        stats_.setOutputQueue(outputBytes());
+        if (cork)
+        {
+            if (!corkScheduled_)
+            {
+                corkScheduled_ = true;
+                loop_->deferFlush(this);
+            }
+        }
+        else if (!channel_.isWriting())
         // channel没有对写事件感兴趣,那么需要注册channel的写事件，后面才能发送缓冲区的数据。
         {
-            channel_->enableWriting(); // [这里一定要注册channel的写事件，否则poller不会给channel通知epollout]
+            channel_.enableWriting(); // [这里一定要注册channel的写事件，否则poller不会给channel通知epollout]
+            stats_.onWriteBlocked(Timestamp::monotonicMicros());
         }
     }
 }
@@ -164,9 +484,20 @@ void TcpConnection::shutdown()
 
 void TcpConnection::shutdownInLoop()
 {
-    if (!channel_->isWriting()) // [说明outputBuffer中的数据已经全部发送完成]
+    if (filter_) // 先把close_notify这类数据排进outputBuffer，写完以后handleWrite会再调用到这里
     {
-        socket_->shutdownWrite(); // 关闭写端
+        Buffer &out = filterScratch();
+        filter_->encodeShutdown(&out);
+        if (out.readableBytes() > 0)
+        {
+            writeInLoop(out.peek(), out.readableBytes());
+            out.retrieveAll();
+        }
+    }
+    // [说明outputBuffer中的数据已经全部发送完成]；还有cork住的数据就等flush写完再关
+    if (!channel_.isWriting() && !corkScheduled_)
+    {
+        socket_.shutdownWrite(); // 关闭写端
         /* 关闭写端会触发socket的EPOLLHUP事件，EPOLLHUP事件是不用专门去向epoll注册的，
         本身epoll给所有sockfd注册过这个事件。*/
     }
@@ -176,18 +507,19 @@ void TcpConnection::shutdownInLoop()
 void TcpConnection::connectEstablished()
 {
     setState(kConnected); //设置连接状态:connecting->conneted
-    /*tie是channel里面的一个void型的weak_ptr ;
-    tcpconnection底层管理了一个channel，channel被poller通知后调用相应的回调函数，这些回调也都是tcpconnection里面的函数。
-    假设channel在poller上面还注册着，得到poller的事件通知调用响应的回调函数，但是tcpconnection对象没有了，而那些成员函数bind时候绑定的就是tcpconnection对象，所以再调用就会产生未知效果。
-    所以：channel里面有一个void型的weakptr，有一个成员函数tie，再tcp connection新连接创建的时候，调用tie函数，channel的弱智能指就会指向tecpconnection对象。
-    这样就防止了底层channel被poller通知执行回调函数时候，channel上层的tcpconnection对象不会被remove。
-    */
-    channel_->tie(shared_from_this());
-    //建立连接的时候调用，tceconneciton的connectionEstablisehd函数中调用channel的tie函数。
-    channel_->enableReading(); // 【向poller注册channel的epollin读事件】
-
-    // 新连接建立，执行connectionCallback回调
-    connectionCallback_(shared_from_this());
+    /* 原来这里调用channel的tie，把channel的weak_ptr指向tcpconnection，防止channel被poller通知执行回调的时候
+    上层的tcpconnection对象已经没了；代价是每个事件都要lock一次weak_ptr(原子CAS)。
+    现在由loop持有一份强引用self_，一直到connectDestroyed(本轮事件处理完以后才会执行)才释放，效果一样，每个事件不再有原子操作。
+    跨线程使用连接仍然拿TcpConnectionPtr */
+    self_ = shared_from_this();
+    channel_.enableReading(); // 【向poller注册channel的epollin读事件】
+
+    // 新连接建立，执行connectionCallback回调；有filter_(TLS)的要等握手完成，在handleRead里回调
+    if (!filter_ || filter_->established())
+    {
+        announced_ = true;
+        callbacks_->connectionCallback(self_);
+    }
 }
 
 //[连接销毁]
@@ -196,23 +528,39 @@ void TcpConnection::connectDestroyed()
     if (state_ == kConnected) // connected->disconnected
     {
         setState(kDisconnected);
-        channel_->disableAll(); // [把channel的所有感兴趣的事件，从poller中del掉]
-        connectionCallback_(shared_from_this());
-        //调用connectionCallback
+        channel_.disableAll(); // [把channel的所有感兴趣的事件，从poller中del掉]
+        if (announced_)
+        {
+            callbacks_->connectionCallback(self_);
+            //调用connectionCallback
+        }
+    }
+    channel_.remove(); // 把channel从poller中删除掉
+    if (corkScheduled_) // 连接要销毁了，没写出去的也不用写了
+    {
+        corkScheduled_ = false;
+        loop_->cancelFlush(this);
     }
-    channel_->remove(); // 把channel从poller中删除掉
+    self_.reset();     // 调用方(TcpServer)手里还有一份，这里不会析构
 }
 
 void TcpConnection::handleRead(Timestamp receiveTime) //处理数据可读
 {
     int savedErrno = 0;
-    ssize_t n = inputBuffer_.readFd(channel_->fd(), &savedErrno);
+    ssize_t n = filter_ ? readThroughFilter(&savedErrno) : inputBuffer_.readFd(channel_.fd(), &savedErrno);
     // channel->fd和socket->fd是相同的，这里选择channel->fd
-    if (n > 0)
+    if (n > 0 && (!announced_ || inputBuffer_.readableBytes() == 0))
+    {
+        stats_.onRead(n); // 握手还没完成，或者只读到了没解出明文的半个记录
+    }
+    else if (n > 0)
     {
+        stats_.onRead(n);
+        int64_t start = Timestamp::monotonicMicros();
         // [已建立连接的用户，有可读事件发生了，调用用户传入的回调操作onMessage]
-        messageCallback_(shared_from_this(), &inputBuffer_, receiveTime);
-        //这里shared_from_this就是获取了当前tcpconnection对象的智能指针
+        callbacks_->messageCallback(self_, &inputBuffer_, receiveTime);
+        //self_是loop持有的智能指针，按引用传过去，不增减引用计数
+        stats_.onMessageCallback(Timestamp::monotonicMicros() - start);
     }
     else if (n == 0) //读到0表示对端关闭，那么调用handleColose处理即可
     {
@@ -226,23 +574,44 @@ void TcpConnection::handleRead(Timestamp receiveTime) //处理数据可读
     }
 }
 
+ssize_t TcpConnection::readThroughFilter(int *savedErrno)
+{
+    Buffer &out = filterScratch();
+    ssize_t n = filter_->readFd(channel_.fd(), &inputBuffer_, &out, savedErrno);
+    if (out.readableBytes() > 0) // 握手消息、告警，出错关连接之前也尽量发出去
+    {
+        writeInLoop(out.peek(), out.readableBytes());
+        out.retrieveAll();
+    }
+    if (n > 0 && !announced_ && filter_->established())
+    {
+        filter_->onEstablished(channel_.fd(), !channel_.isWriting() && outputBuffer_.readableBytes() == 0);
+        announced_ = true;
+        callbacks_->connectionCallback(self_);
+    }
+    return n;
+}
+
 void TcpConnection::handleWrite()
 {
-    if (channel_->isWriting()) //可写
+    if (channel_.isWriting()) //可写
     {
         int savedErrno = 0;
-        ssize_t n = outputBuffer_.writeFd(channel_->fd(), &savedErrno);
+        ssize_t n = writeOutput(&savedErrno); // [已经写出去的从outputBuffer、zerocopy_里取走]
         if (n > 0) //发送了n个数据
         {
-            outputBuffer_.retrieve(n);              // [n个数据已经处理过了，重置outputBuffer的readindex]
-            if (outputBuffer_.readableBytes() == 0) //发送完成，
+            stats_.onWrite(n);
+            stats_.setOutputQueue(outputBytes());
+            if (outputBytes() == 0) //发送完成，
             {
-                channel_->disableWriting(); //[设置为不可写，因为上面可写的时候已经写完数据了]
-                if (writeCompleteCallback_) //写完成回调
+                channel_.disableWriting(); //[设置为不可写，因为上面可写的时候已经写完数据了]
+                stats_.onWriteUnblocked(Timestamp::monotonicMicros());
+                if (callbacks_->writeCompleteCallback && announced_) //写完成回调；握手数据写完不算
                 {
                     // [唤醒loop_对应的thread线程，执行回调]
-                    loop_->queueInLoop(
-                        std::bind(writeCompleteCallback_, shared_from_this()));
+                    TcpConnectionPtr self(shared_from_this());
+                    loop_->queueInLoop([self]()
+                                       { self->callbacks_->writeCompleteCallback(self); });
                 }
                 if (state_ == kDisconnecting) //正在关闭状态
                 {
@@ -257,28 +626,105 @@ void TcpConnection::handleWrite()
     }
     else
     {
-        LOG_ERROR("TcpConnection fd=%d is down, no more writing \n", channel_->fd());
+        LOG_ERROR("TcpConnection fd=%d is down, no more writing \n", channel_.fd());
+    }
+}
+
+void TcpConnection::flush()
+{
+    corkScheduled_ = false;
+    // 连接已经断了；或者已经在等EPOLLOUT(本轮里前面的数据没写完)，handleWrite会接着发
+    if (state_ == kDisconnected || channel_.isWriting())
+    {
+        return;
+    }
+    int savedErrno = 0;
+    ssize_t n = writeOutput(&savedErrno);
+    if (n > 0)
+    {
+        stats_.onWrite(n);
+        stats_.setOutputQueue(outputBytes());
+    }
+    else if (savedErrno != EWOULDBLOCK)
+    {
+        // EPIPE、ECONNRESET这类错误，读事件那边会发现连接断了并关闭
+        errno = savedErrno;
+        LOG_ERROR("TcpConnection::flush");
+        return;
+    }
+
+    if (outputBytes() == 0)
+    {
+        if (callbacks_->writeCompleteCallback && announced_)
+        {
+            TcpConnectionPtr self(shared_from_this());
+            loop_->queueInLoop([self]()
+                               { self->callbacks_->writeCompleteCallback(self); });
+        }
+        if (state_ == kDisconnecting)
+        {
+            shutdownInLoop();
+        }
+    }
+    else
+    {
+        channel_.enableWriting(); // 没写完的和不cork时一样交给handleWrite
+        stats_.onWriteBlocked(Timestamp::monotonicMicros());
     }
 }
 
+ssize_t TcpConnection::writeOutput(int *savedErrno)
+{
+    ssize_t n = 0;
+    if (outputBuffer_.readableBytes() > 0)
+    {
+        n = outputBuffer_.writeFd(channel_.fd(), savedErrno);
+        if (n <= 0)
+        {
+            return n;
+        }
+        outputBuffer_.retrieve(n);
+        if (outputBuffer_.readableBytes() > 0)
+        {
+            return n; // socket已经满了
+        }
+    }
+    if (zerocopy_ && !zerocopy_->empty())
+    {
+        ssize_t m = zerocopy_->write(channel_.fd(), savedErrno);
+        if (m < 0)
+        {
+            return n > 0 ? n : -1;
+        }
+        n += m;
+    }
+    return n;
+}
+
 // poller => channel::closeCallback => TcpConnection::handleClose
 void TcpConnection::handleClose()
 {
-    LOG_INFO("TcpConnection::handleClose fd=%d state=%d \n", channel_->fd(), (int)state_);
+    LOG_DEBUG("TcpConnection::handleClose fd=%d state=%d \n", channel_.fd(), (int)state_);
     setState(kDisconnected); //设置连接状态为关闭
-    channel_->disableAll();  // channel对所有事件都不感兴趣了，从poller中删除
-    TcpConnectionPtr connPtr(shared_from_this());
-    connectionCallback_(connPtr); // 执行连接关闭的回调
-    closeCallback_(connPtr);
+    channel_.disableAll();  // channel对所有事件都不感兴趣了，从poller中删除
+    stats_.onWriteUnblocked(Timestamp::monotonicMicros());
+    TcpConnectionPtr connPtr(self_); // closeCallback会把连接从表里删掉，这里留一份到函数结束
+    if (announced_)
+    {
+        callbacks_->connectionCallback(connPtr); // 执行连接关闭的回调
+    }
+    callbacks_->closeCallback(connPtr);
     // 关闭连接的回调  执行的是TcpServer::removeConnection回调方法
 }
 
 void TcpConnection::handleError()
 {
+    // MSG_ZEROCOPY的完成通知放在错误队列上，epoll报的是EPOLLERR；不读走会一直触发
+    int completions = zerocopy_ ? zerocopy_->handleCompletions(channel_.fd()) : 0;
     int optval;
     socklen_t optlen = sizeof optval;
     int err = 0;
-    if (::getsockopt(channel_->fd(), SOL_SOCKET, SO_ERROR, &optval, &optlen) < 0)
+    if (::getsockopt(channel_.fd(), SOL_SOCKET, SO_ERROR, &optval, &optlen) < 0)
     {
         err = errno;
     }
@@ -286,5 +732,9 @@ void TcpConnection::handleError()
     {
         err = optval;
     }
-    LOG_ERROR("TcpConnection::handleError name:%s - SO_ERROR:%d \n", name_.c_str(), err);
+    if (err == 0 && completions > 0)
+    {
+        return;
+    }
+    LOG_ERROR("TcpConnection::handleError name:%s - SO_ERROR:%d \n", name().c_str(), err);
 }
@@ -5,14 +5,43 @@
 #include "Callbacks.h"
 #include "Buffer.h"
 #include "Timestamp.h"
+#include "ConnectionStats.h"
+#include "Channel.h"
+#include "Socket.h"
+#include "EventLoop.h"
+#include "ConnectionFilter.h"
+#include "ZeroCopyQueue.h"
 
 #include <memory>
 #include <string>
 #include <atomic>
 
-class Channel;
-class EventLoop;
-class Socket;
+/**
+ * [一个服务器所有连接共享的回调表]  TcpServer在start时建好一份，之后只读；每个连接只持有它的shared_ptr，
+ * 不再各自拷贝一串std::function。单个连接调用setXxxCallback时才给这个连接拷贝一份自己的(写时复制)
+ */
+struct ConnectionCallbacks
+{
+    ConnectionCallbacks()
+        : highWaterMark(64 * 1024 * 1024), autoCork(false), socketBusyPollUs(0), zeroCopyThreshold(0),
+          tcpNoDelay(false), sendBufferBytes(0), recvBufferBytes(0) {} // 设置高水位标记: 64M
+
+    std::string name; // 服务器名，连接名是 name#id
+    ConnectionCallback connectionCallback;       // 有新连接时的回调
+    MessageCallback messageCallback;             // 有读写消息时的回调
+    WriteCompleteCallback writeCompleteCallback; // 消息发送完成以后的回调
+    HighWaterMarkCallback highWaterMarkCallback;
+    size_t highWaterMark;
+    CloseCallback closeCallback;
+    bool autoCork; // 见TcpConnection::setAutoCork
+    int socketBusyPollUs; // >0时新连接设置SO_BUSY_POLL，见TcpServer::setBusyPoll
+    size_t zeroCopyThreshold; // >0时打开MSG_ZEROCOPY发送队列，见TcpServer::setZeroCopy
+    bool tcpNoDelay;          // 新连接设置TCP_NODELAY，见TcpServer::setTcpNoDelay
+    int sendBufferBytes;      // >0时新连接设置SO_SNDBUF
+    int recvBufferBytes;      // >0时新连接设置SO_RCVBUF
+    ConnectionFilterFactory filterFactory; // 非空时每个连接创建一个ConnectionFilter(比如TLS)
+};
+using ConnectionCallbacksPtr = std::shared_ptr<const ConnectionCallbacks>;
 
 /**
  * TcpServer => Acceptor => 有一个新用户连接，通过accept函数拿到connfd
@@ -21,44 +50,85 @@ class Socket;
  *
  */
 class TcpConnection : noncopyable,
-                      public std::enable_shared_from_this<TcpConnection>
+                      public std::enable_shared_from_this<TcpConnection>,
+                      private DeferredFlush
 {
 public:
     TcpConnection(EventLoop *loop,
-                  const std::string &name,
+                  const ConnectionCallbacksPtr &callbacks,
+                  uint64_t id,
                   int sockfd,
-                  const InetAddress &localAddr,
                   const InetAddress &peerAddr);
     ~TcpConnection();
+    /**
+     * [创建连接]  TcpConnection(连同里面的Socket、Channel)和shared_ptr的控制块在同一块内存里，
+     * 这块内存从线程本地的空闲链表里取；连接一般在它的io loop里创建和析构，建连不用进malloc
+     */
+    static TcpConnectionPtr create(EventLoop *loop,
+                                   const ConnectionCallbacksPtr &callbacks,
+                                   uint64_t id,
+                                   int sockfd,
+                                   const InetAddress &peerAddr);
 
     EventLoop *getLoop() const { return loop_; } //返回tcpconnection所在的事件循环
-    const std::string &name() const { return name_; }
-    const InetAddress &localAddress() const { return localAddr_; }
+    // [连接名字]  "服务器名#id"，只在打日志、统计时拼出来，建连路径上不格式化字符串
+    std::string name() const { return callbacks_->name + "#" + std::to_string(id_); }
+    uint64_t id() const { return id_; } // 同一个TcpServer内唯一，不会回绕
+    // 第一次调用时才getsockname，accept路径上省掉一次系统调用；只能在loop线程里调用
+    const InetAddress &localAddress() const;
     const InetAddress &peerAddress() const { return peerAddr_; }
     bool connected() const { return state_ == kConnected; } //设置tcpconnection的连接状态
     void send(const std::string &buf);                      // 发送数据
+    void send(const void *data, size_t len);
+    // 发送buf里的全部可读数据并清空buf，loop线程内调用不会多拷贝一次string；
+    // 打开了MSG_ZEROCOPY、数据够大时整块换走，buf换成一个空Buffer，全程不拷贝
+    void send(Buffer *buf);
     void shutdown();                                        //调用shutdown关闭连接
+    // [单独修改这个连接的回调]  在loop线程里调用，第一次修改时拷贝一份共享的回调表
     void setConnectionCallback(const ConnectionCallback &cb)
     {
-        connectionCallback_ = cb;
+        mutableCallbacks()->connectionCallback = cb;
     }
     void setMessageCallback(const MessageCallback &cb)
     {
-        messageCallback_ = cb;
+        mutableCallbacks()->messageCallback = cb;
     }
     void setWriteCompleteCallback(const WriteCompleteCallback &cb)
     {
-        writeCompleteCallback_ = cb;
+        mutableCallbacks()->writeCompleteCallback = cb;
     }
     void setHighWaterMarkCallback(const HighWaterMarkCallback &cb, size_t highWaterMark)
     {
-        highWaterMarkCallback_ = cb;
-        highWaterMark_ = highWaterMark;
+        ConnectionCallbacks *callbacks = mutableCallbacks();
+        callbacks->highWaterMarkCallback = cb;
+        callbacks->highWaterMark = highWaterMark;
     }
     void setCloseCallback(const CloseCallback &cb)
     {
-        closeCallback_ = cb;
+        mutableCallbacks()->closeCallback = cb;
+    }
+    /**
+     * [auto-cork]  打开以后，loop线程里的send先只追加到outputBuffer，本轮事件和pendingFunctors处理完、
+     * 下一次poll之前再一次write出去。一个onMessage里分几次send(头、正文、尾)只有一次系统调用、尽量一个包。
+     * 代价是每次send多一次拷贝，适合请求/响应、pipeline这类一轮里多次小send的协议
+     */
+    void setAutoCork(bool on)
+    {
+        mutableCallbacks()->autoCork = on;
     }
+    // [连接上挂的用户上下文]  比如HTTP解析状态，muduo里用boost::any，这里用shared_ptr<void>
+    void setContext(const std::shared_ptr<void> &context) { context_ = context; }
+    const std::shared_ptr<void> &getContext() const { return context_; }
+    // [连接上的变换层]  没有时返回nullptr；只能在loop线程里用，比如取TLS的协商结果
+    ConnectionFilter *filter() const { return filter_.get(); }
+    // [MSG_ZEROCOPY发送队列]  没打开时返回nullptr；只能在loop线程里用，比如读统计
+    const ZeroCopyQueue *zeroCopy() const { return zerocopy_.get(); }
+    // [连接统计]  任何线程都可以调用
+    ConnectionStatsSnapshot stats() const;
+    // 只能在loop线程里访问
+    Buffer *inputBuffer() { return &inputBuffer_; }
+    Buffer *outputBuffer() { return &outputBuffer_; }
+
     void connectEstablished(); // [连接建立]
     void connectDestroyed();   // [连接销毁]
 private:
@@ -77,30 +147,45 @@ private:
     void handleError();
 
     void sendInLoop(const void *message, size_t len);
+    void writeInLoop(const void *data, size_t len); // 原样写给对端，不经过filter_
+    void sendZeroCopyInLoop(Buffer *buf);
+    ssize_t writeOutput(int *savedErrno); // 先写outputBuffer_，写空了再写zerocopy_
+    size_t outputBytes() const { return outputBuffer_.readableBytes() + (zerocopy_ ? zerocopy_->queuedBytes() : 0); }
+    ssize_t readThroughFilter(int *savedErrno);
     void shutdownInLoop();
+    void flush() override; // auto-cork攒下的数据在本轮末尾写出去
+    ConnectionCallbacks *mutableCallbacks();
     EventLoop *loop_;
     // 这里绝对不是baseLoop， 【因为TcpConnection都是在subLoop里面管理的】
-    const std::string name_; //连接的名字
+    ConnectionCallbacksPtr callbacks_;
+    const uint64_t id_;
     std::atomic_int state_;  //[连接的状态]
     bool reading_;
+    bool ownsCallbacks_;              // callbacks_是不是这个连接自己的拷贝
+    bool corkScheduled_;              // 已经deferFlush，本轮末尾会flush
+    bool announced_;                  // 已经回调过connectionCallback(有filter_时要等握手完成)
 
     /* 这里和Acceptor类似:   Acceptor在mainLoop里;TcpConenction在subLoop里面 ;
     他们都需要把底层的listenfd和connfd封装成channel，然后channel注册到poller里面监听。
+    直接作为成员，和TcpConnection在同一块内存里
     */
+    Socket socket_;
+    Channel channel_;
 
-    std::unique_ptr<Socket> socket_;
-    std::unique_ptr<Channel> channel_;
-
-    const InetAddress localAddr_;
+    // InetAddress要放得下Unix域路径，本机地址很少用，用到时才分配
+    mutable std::unique_ptr<InetAddress> localAddr_;
     const InetAddress peerAddr_;
 
-    ConnectionCallback connectionCallback_;       // 有新连接时的回调
-    MessageCallback messageCallback_;             // 有读写消息时的回调
-    WriteCompleteCallback writeCompleteCallback_; // 消息发送完成以后的回调
-    HighWaterMarkCallback highWaterMarkCallback_;
-    CloseCallback closeCallback_;
-    size_t highWaterMark_;
-
     Buffer inputBuffer_;  // 接收数据的缓冲区
     Buffer outputBuffer_; // 发送数据的缓冲区
+
+    std::shared_ptr<void> context_;
+    ConnectionStats stats_;
+    std::unique_ptr<ConnectionFilter> filter_;
+    std::unique_ptr<ZeroCopyQueue> zerocopy_; // 构造时确定，之后不变，其他线程也可以判断有没有
+
+    /* [loop持有的那份引用]  connectEstablished时设置，connectDestroyed时释放；connectDestroyed总是在
+    本轮事件分发结束以后才执行，所以handleEvent期间连接一定活着，channel不用再tie。
+    handleRead等回调直接把它按引用传给用户，每个事件不再有weak_ptr::lock和shared_from_this的原子加减 */
+    TcpConnectionPtr self_;
 };
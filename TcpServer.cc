@@ -2,8 +2,9 @@
 #include "Logger.h"
 #include "TcpConnection.h"
 
-#include <strings.h>
 #include <functional>
+#include <algorithm>
+#include <future>
 
 static EventLoop *CheckLoopNotNull(EventLoop *loop) //至少要有一个base loop
 {
@@ -33,10 +34,19 @@ TcpServer::TcpServer(EventLoop *loop,
        acceptor是监听新用户连接的，所以要传递listenAddr。
 
        */
+      computePool_(name_ + "-compute"),
       threadPool_(new EventLoopThreadPool(loop, name_)),               //[事件循环的线程池]
       connectionCallback_(),
       messageCallback_(),
+      autoCork_(false),
+      busyPollUs_(0),
+      socketBusyPollUs_(0),
+      zeroCopyThreshold_(0),
+      tcpNoDelay_(false),
+      sendBufferBytes_(0),
+      recvBufferBytes_(0),
       nextConnId_(1),
+      nextTable_(0),
       started_(0)
 {
     /*[当有新用户连接时，会执行TcpServer::newConnection回调]:
@@ -48,15 +58,39 @@ TcpServer::TcpServer(EventLoop *loop,
 
 TcpServer::~TcpServer()
 {
-    for (auto &item : connections_)
+    // 连接表只能在各自的loop里动，投递过去并等它做完，析构返回以后不会再有任务访问tables_
+    for (std::unique_ptr<ConnectionTable> &item : tables_)
     {
-        // 这个局部的shared_ptr智能指针对象，出右括号，可以自动释放new出来的TcpConnection对象资源了
-        TcpConnectionPtr conn(item.second);
-        item.second.reset();
-
-        // 销毁连接
-        conn->getLoop()->runInLoop(
-            std::bind(&TcpConnection::connectDestroyed, conn));
+        ConnectionTable *table = item.get();
+        auto destroyAll = [table]()
+        {
+            std::unordered_map<uint64_t, TcpConnectionPtr> connections;
+            connections.swap(table->connections);
+            table->count.store(0, std::memory_order_relaxed);
+            for (auto &conn : connections)
+            {
+                conn.second->connectDestroyed(); // 销毁连接
+            }
+        };
+        if (table->loop->isInLoopThread())
+        {
+            destroyAll();
+        }
+        else
+        {
+            std::promise<void> done;
+            table->loop->runInLoop([&destroyAll, &done]()
+                                   {
+                destroyAll();
+                done.set_value(); });
+            done.get_future().wait();
+        }
+    }
+    // 连接都销毁了、io loop还在跑：这时停计算线程，已经接受的work做完，done投递回loop后对着已断开的连接执行；
+    // 之后submit一律被拒绝。投递出去的drain只持有收件箱的shared_ptr，baseLoop在服务器析构后继续跑也不会碰到computePool_
+    if (computePool_.started())
+    {
+        computePool_.stop();
     }
 }
 
@@ -66,70 +100,169 @@ void TcpServer::setThreadNum(int numThreads)
     threadPool_->setThreadNum(numThreads);
 }
 
+void TcpServer::setComputeThreadNum(int numThreads, size_t maxQueueSize)
+{
+    computePool_.setThreadNum(numThreads);
+    computePool_.setMaxQueueSize(maxQueueSize);
+}
+
 // 开启服务器监听   loop.loop()
 void TcpServer::start()
 {
     if (started_++ == 0) // 防止一个TcpServer对象被start多次
     {
+        if (computePool_.threadNum() > 0)
+        {
+            computePool_.start();
+        }
+        std::shared_ptr<ConnectionCallbacks> callbacks = std::make_shared<ConnectionCallbacks>();
+        callbacks->name = name_;
+        callbacks->connectionCallback = connectionCallback_;
+        callbacks->messageCallback = messageCallback_;
+        callbacks->writeCompleteCallback = writeCompleteCallback_;
+        callbacks->autoCork = autoCork_;
+        callbacks->socketBusyPollUs = socketBusyPollUs_;
+        callbacks->zeroCopyThreshold = zeroCopyThreshold_;
+        callbacks->tcpNoDelay = tcpNoDelay_;
+        callbacks->sendBufferBytes = sendBufferBytes_;
+        callbacks->recvBufferBytes = recvBufferBytes_;
+        callbacks->filterFactory = filterFactory_;
+        // 这里是设置如何关闭连接的回调   conn->shutDown()
+        callbacks->closeCallback = std::bind(&TcpServer::removeConnection, this, std::placeholders::_1);
+        callbacks_ = callbacks;
         threadPool_->start(threadInitCallback_); // 启动底层的loop线程池
-        loop_->runInLoop(std::bind(&Acceptor::listen, acceptor_.get()));
+        for (EventLoop *ioLoop : threadPool_->getAllLoops())
+        {
+            tables_.push_back(std::unique_ptr<ConnectionTable>(new ConnectionTable(ioLoop)));
+            if (busyPollUs_ > 0)
+            {
+                ioLoop->setBusyPoll(busyPollUs_);
+            }
+        }
+        Acceptor *acceptor = acceptor_.get();
+        ListenOptions options = listenOptions_;
+        loop_->runInLoop([acceptor, options]()
+                         { acceptor->listen(options); });
         //底层启动listend开始监听新用户的连接了
     }
 }
 
-// 【有一个新的客户端的连接，acceptor会执行这个回调操作newConnection】
-void TcpServer::newConnection(int sockfd, const InetAddress &peerAddr)
+namespace
 {
-    // 【轮询算法，选择一个subLoop，来管理channel】
-    EventLoop *ioLoop = threadPool_->getNextLoop();
-    char buf[64] = {0};
-    snprintf(buf, sizeof buf, "-%s#%d", ipPort_.c_str(), nextConnId_);
-    ++nextConnId_; // newConnection只再mainloop里面处理，不涉及线程安全问题，因此不需要是原子类型
-    std::string connName = name_ + buf;
-    LOG_INFO("TcpServer::newConnection [%s] - new connection [%s] from %s \n",
-             name_.c_str(), connName.c_str(), peerAddr.toIpPort().c_str());
-    // 通过sockfd获取其绑定的本机的ip地址和端口信息
-    sockaddr_in local;
-    ::bzero(&local, sizeof local);
-    socklen_t addrlen = sizeof local;
-    if (::getsockname(sockfd, (sockaddr *)&local, &addrlen) < 0)
+    uint64_t sortValue(const ConnectionStatsSnapshot &s, TcpServer::ConnectionSortKey key)
     {
-        LOG_ERROR("sockets::getLocalAddr");
+        switch (key)
+        {
+        case TcpServer::kByBytesIn:
+            return s.bytesIn;
+        case TcpServer::kByBytesOut:
+            return s.bytesOut;
+        case TcpServer::kByOutputQueue:
+            return s.outputQueue;
+        case TcpServer::kByWriteBlocked:
+            return s.writeBlockedUs;
+        case TcpServer::kByCallbackTime:
+            return s.callbackUs;
+        }
+        return 0;
     }
-    InetAddress localAddr(local);
-
-    //[根据连接成功的sockfd，创建TcpConnection连接对象]
-    TcpConnectionPtr conn(new TcpConnection(
-        ioLoop,
-        connName,
-        sockfd, // Socket Channel
-        localAddr,
-        peerAddr));
-    connections_[connName] = conn;
-    // 下面的回调都是用户设置给TcpServer=>TcpConnection=>Channel注册到Poller，poller通知channel调用回调
-    conn->setConnectionCallback(connectionCallback_);
-    conn->setMessageCallback(messageCallback_);
-    conn->setWriteCompleteCallback(writeCompleteCallback_);
-    // 这里是设置如何关闭连接的回调   conn->shutDown()
-    conn->setCloseCallback(
-        std::bind(&TcpServer::removeConnection, this, std::placeholders::_1));
-    // 【这里是直接调用TcpConnection::connectEstablished】
-    ioLoop->runInLoop(std::bind(&TcpConnection::connectEstablished, conn));
 }
 
-void TcpServer::removeConnection(const TcpConnectionPtr &conn)
+size_t TcpServer::numConnections() const
+{
+    size_t n = 0;
+    for (const std::unique_ptr<ConnectionTable> &table : tables_)
+    {
+        n += table->count.load(std::memory_order_relaxed);
+    }
+    return n;
+}
+
+TcpServer::ConnectionTable *TcpServer::tableOf(EventLoop *loop) const
+{
+    for (const std::unique_ptr<ConnectionTable> &table : tables_)
+    {
+        if (table->loop == loop)
+        {
+            return table.get();
+        }
+    }
+    return nullptr;
+}
+
+std::vector<TcpConnectionPtr> TcpServer::connectionsInLoop(EventLoop *loop) const
+{
+    std::vector<TcpConnectionPtr> conns;
+    const ConnectionTable *table = tableOf(loop);
+    if (table != nullptr)
+    {
+        conns.reserve(table->connections.size());
+        for (const auto &item : table->connections)
+        {
+            conns.push_back(item.second);
+        }
+    }
+    return conns;
+}
+
+std::vector<ConnectionStatsSnapshot> TcpServer::topConnectionsInLoop(EventLoop *loop, size_t n, ConnectionSortKey key) const
 {
-    loop_->runInLoop(
-        std::bind(&TcpServer::removeConnectionInLoop, this, conn));
+    std::vector<ConnectionStatsSnapshot> all;
+    const ConnectionTable *table = tableOf(loop);
+    if (table != nullptr)
+    {
+        all.reserve(table->connections.size());
+        for (const auto &item : table->connections)
+        {
+            all.push_back(item.second->stats());
+        }
+    }
+    selectTopConnections(&all, n, key);
+    return all;
 }
 
-void TcpServer::removeConnectionInLoop(const TcpConnectionPtr &conn)
+void TcpServer::selectTopConnections(std::vector<ConnectionStatsSnapshot> *stats, size_t n, ConnectionSortKey key)
+{
+    n = std::min(n, stats->size());
+    std::partial_sort(stats->begin(), stats->begin() + n, stats->end(),
+                      [key](const ConnectionStatsSnapshot &a, const ConnectionStatsSnapshot &b)
+                      { return sortValue(a, key) > sortValue(b, key); });
+    stats->resize(n);
+}
+
+// 【有一个新的客户端的连接，acceptor会执行这个回调操作newConnection】
+void TcpServer::newConnection(int sockfd, const InetAddress &peerAddr)
+{
+    // 【轮询算法，选择一个subLoop，来管理channel】
+    ConnectionTable *table = tables_[nextTable_].get();
+    nextTable_ = (nextTable_ + 1) % tables_.size();
+    uint64_t connId = nextConnId_++; // newConnection只再mainloop里面处理，不涉及线程安全问题，因此不需要是原子类型
+    LOG_DEBUG("TcpServer::newConnection [%s] - new connection [#%llu] from %s \n",
+             name_.c_str(), static_cast<unsigned long long>(connId), peerAddr.toIpPort().c_str());
+
+    /**
+     * [TcpConnection在它的io loop里创建]  分配和析构都在同一个线程，TcpConnection::create的线程本地内存池才能复用；
+     * 回调是共享的callbacks_，本机地址用到时才getsockname。连接在自己的loop里入表，再调用connectEstablished
+     */
+    ConnectionCallbacksPtr callbacks = callbacks_;
+    table->loop->runInLoop([table, callbacks, connId, sockfd, peerAddr]()
+                           {
+        TcpConnectionPtr conn = TcpConnection::create(table->loop, callbacks, connId, sockfd, peerAddr);
+        table->connections[connId] = conn;
+        table->count.store(table->connections.size(), std::memory_order_relaxed);
+        conn->connectEstablished(); });
+}
+
+// 在conn所在的loop线程里调用(TcpConnection::handleClose)，不经过baseLoop
+void TcpServer::removeConnection(const TcpConnectionPtr &conn)
 {
-    LOG_INFO("TcpServer::removeConnectionInLoop [%s] - connection %s\n",
+    LOG_DEBUG("TcpServer::removeConnection [%s] - connection %s\n",
              name_.c_str(), conn->name().c_str());
 
-    connections_.erase(conn->name());
-    EventLoop *ioLoop = conn->getLoop();
-    ioLoop->queueInLoop(
+    ConnectionTable *table = tableOf(conn->getLoop());
+    table->connections.erase(conn->id());
+    table->count.store(table->connections.size(), std::memory_order_relaxed);
+    // 现在还在channel的handleEvent里，放到这一轮的pending functors里再销毁；同一个线程，不需要wakeup
+    table->loop->queueInLoop(
         std::bind(&TcpConnection::connectDestroyed, conn));
 }
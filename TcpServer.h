@@ -11,12 +11,14 @@
 #include "Callbacks.h"
 #include "TcpConnection.h"
 #include "Buffer.h"
+#include "ComputePool.h"
 
 #include <functional>
 #include <string>
 #include <memory>
 #include <atomic>
 #include <unordered_map>
+#include <vector>
 
 // 对外的服务器编程使用的类
 class TcpServer : noncopyable
@@ -28,34 +30,117 @@ public:
         kNoReusePort,
         kReusePort,
     };
+    // topConnections的排序依据
+    enum ConnectionSortKey
+    {
+        kByBytesIn,
+        kByBytesOut,
+        kByOutputQueue,
+        kByWriteBlocked,
+        kByCallbackTime,
+    };
     TcpServer(EventLoop *loop,
               const InetAddress &listenAddr,
               const std::string &nameArg,
               Option option = kNoReusePort);
     ~TcpServer();
     void setThreadInitcallback(const ThreadInitCallback &cb) { threadInitCallback_ = cb; }
+    // [连接回调]  start之前设置，start时打包成所有连接共享的ConnectionCallbacks
     void setConnectionCallback(const ConnectionCallback &cb) { connectionCallback_ = cb; }
     void setMessageCallback(const MessageCallback &cb) { messageCallback_ = cb; }
     void setWriteCompleteCallback(const WriteCompleteCallback &cb) { writeCompleteCallback_ = cb; }
+    // 所有连接默认打开auto-cork，见TcpConnection::setAutoCork；start之前设置
+    void setAutoCork(bool on) { autoCork_ = on; }
+    /**
+     * [忙轮询]  start之前设置。loopBudgetUs给所有io loop开EventLoop::setBusyPoll；
+     * socketBusyPollUs>0时每个新连接再设置SO_BUSY_POLL/SO_PREFER_BUSY_POLL(网卡驱动层面的轮询)
+     */
+    void setBusyPoll(int loopBudgetUs, int socketBusyPollUs = 0)
+    {
+        busyPollUs_ = loopBudgetUs;
+        socketBusyPollUs_ = socketBusyPollUs;
+    }
+    /**
+     * [MSG_ZEROCOPY]  start之前设置，0(默认)关闭。打开以后send(Buffer*)里不小于thresholdBytes的数据
+     * 整块交给连接的发送队列、用MSG_ZEROCOPY发，见ZeroCopyQueue。只对没有ConnectionFilter的连接生效；
+     * 一般要几十KB以上才划算，回环上内核仍会拷贝
+     */
+    void setZeroCopy(size_t thresholdBytes) { zeroCopyThreshold_ = thresholdBytes; }
+    /**
+     * [监听socket]  start之前设置。backlog默认1024，连接风暴下全连接队列满了会丢SYN；
+     * deferAcceptSeconds>0时打开TCP_DEFER_ACCEPT，客户端的第一批数据到了才唤醒acceptor，
+     * 只连不发的连接在超时之前不占TcpConnection；fastOpenQueue>0时打开TCP_FASTOPEN
+     */
+    void setListenBacklog(int backlog) { listenOptions_.backlog = backlog; }
+    void setDeferAccept(int seconds) { listenOptions_.deferAcceptSeconds = seconds; }
+    void setFastOpen(int queueLength) { listenOptions_.fastOpenQueue = queueLength; }
+    // [每个连接的socket选项]  start之前设置，在连接的io loop里设置；bytes为0时用内核默认(自动调整)
+    void setTcpNoDelay(bool on) { tcpNoDelay_ = on; }
+    void setSocketBufferSizes(int sendBytes, int recvBytes)
+    {
+        sendBufferBytes_ = sendBytes;
+        recvBufferBytes_ = recvBytes;
+    }
+    // [连接的变换层]  每个新连接调用factory创建一个，比如TlsContext::enable挂上TLS；start之前设置
+    void setConnectionFilter(const ConnectionFilterFactory &factory) { filterFactory_ = factory; }
     void setThreadNum(int numThreads); // 设置底层subloop的个数
+    EventLoop *getLoop() const { return loop_; }
+    const std::string &name() const { return name_; }
+    // [start之后有效]  可以拿到所有subloop，比如按loop做数据分片
+    std::shared_ptr<EventLoopThreadPool> threadPool() { return threadPool_; }
+    // [计算线程池]  numThreads>0时start()里一起启动，onMessage里把耗CPU的活submit过去，
+    // 完成回调回到连接所在的loop: computePool()->submit(conn->getLoop(), work, done)
+    void setComputeThreadNum(int numThreads, size_t maxQueueSize = ComputePool::kDefaultMaxQueueSize);
+    ComputePool *computePool() { return &computePool_; }
+    size_t numConnections() const; // 任何线程都可以调用
+    /**
+     * [某个loop上的连接]  连接表按loop分开，只能在loop自己的线程里调用(用loop->runInLoop包一层)。
+     * 整个服务器的topN = 每个loop各取topN再用selectTopConnections合并
+     */
+    std::vector<TcpConnectionPtr> connectionsInLoop(EventLoop *loop) const;
+    std::vector<ConnectionStatsSnapshot> topConnectionsInLoop(EventLoop *loop, size_t n, ConnectionSortKey key) const;
+    static void selectTopConnections(std::vector<ConnectionStatsSnapshot> *stats, size_t n, ConnectionSortKey key);
     void start();
     /* [开启服务器监听:tcpserver的start函数其实就是开启底层的main loop 的acceptor的listen ]*/
 private:
+    /**
+     * [每个io loop一张连接表]  只在这个loop的线程里增删，连接的建立和关闭都不用回baseLoop；
+     * count是表的大小，给其他线程读
+     */
+    struct ConnectionTable
+    {
+        explicit ConnectionTable(EventLoop *ioLoop) : loop(ioLoop), count(0) {}
+        EventLoop *loop;
+        std::unordered_map<uint64_t, TcpConnectionPtr> connections;
+        std::atomic<size_t> count;
+    };
+
     void newConnection(int sockfd, const InetAddress &peerAddr); //处理新连接
-    void removeConnection(const TcpConnectionPtr &conn);         //从connectionMap中移除connection
-    void removeConnectionInLoop(const TcpConnectionPtr &conn);
+    void removeConnection(const TcpConnectionPtr &conn); //在连接所在的loop里把它从表里删掉
+    ConnectionTable *tableOf(EventLoop *loop) const;
     EventLoop *loop_;          //【事件循环EventLoop】 baseLoop 用户定义的loop
     const std::string ipPort_; //保存服务器的ip地址和端口号以及服务器名称
     const std::string name_;
     std::unique_ptr<Acceptor> acceptor_;              // [acceptor运行在mainLoop任务就是监听新连接事件]
+    ComputePool computePool_;                         // 要在threadPool_之后析构，loop里可能还有它投递的完成回调
     std::shared_ptr<EventLoopThreadPool> threadPool_; //[事件循环的线程池] one loop per thread
     ConnectionCallback connectionCallback_;           // 【有新连接时的回调】
     MessageCallback messageCallback_;                 // 【有读写消息时的回调】
     WriteCompleteCallback writeCompleteCallback_;     // 【消息发送完成以后的回调】
     //在callbacks.h中统一定义了回调函数的类型
     ThreadInitCallback threadInitCallback_; // [loop线程初始化的回调]
+    ConnectionCallbacksPtr callbacks_; // start()里建好，之后只读
+    bool autoCork_;
+    int busyPollUs_;
+    int socketBusyPollUs_;
+    size_t zeroCopyThreshold_;
+    ListenOptions listenOptions_;
+    bool tcpNoDelay_;
+    int sendBufferBytes_;
+    int recvBufferBytes_;
+    ConnectionFilterFactory filterFactory_;
     std::atomic_int started_;
-    int nextConnId_;
-    using ConnectionMap = std::unordered_map<std::string, TcpConnectionPtr>;
-    ConnectionMap connections_; // [connectionmap保存所有的连接]
+    uint64_t nextConnId_; // 只在baseLoop里递增
+    size_t nextTable_;    // 轮询选择io loop，和threadPool_->getAllLoops()的顺序一致
+    std::vector<std::unique_ptr<ConnectionTable>> tables_; // start()里建好以后不再增减
 };
@@ -0,0 +1,130 @@
+#include "TimerQueue.h"
+#include "EventLoop.h"
+#include "Logger.h"
+
+#include <sys/timerfd.h>
+#include <time.h>
+#include <unistd.h>
+#include <errno.h>
+#include <string.h>
+#include <vector>
+
+std::atomic<uint64_t> TimerQueue::s_numCreated_(0);
+
+static int createTimerfd()
+{
+    int timerfd = ::timerfd_create(CLOCK_MONOTONIC, TFD_NONBLOCK | TFD_CLOEXEC);
+    if (timerfd < 0)
+    {
+        LOG_FATAL("timerfd_create error:%d \n", errno);
+    }
+    return timerfd;
+}
+
+TimerQueue::TimerQueue(EventLoop *loop)
+    : loop_(loop),
+      timerfd_(createTimerfd()),
+      timerfdChannel_(loop, timerfd_)
+{
+    timerfdChannel_.setReadCallback(std::bind(&TimerQueue::handleRead, this));
+    timerfdChannel_.enableReading();
+}
+
+TimerQueue::~TimerQueue()
+{
+    timerfdChannel_.disableAll();
+    timerfdChannel_.remove();
+    ::close(timerfd_);
+}
+
+TimerId TimerQueue::addTimer(TimerCallback cb, double delay, double interval)
+{
+    TimerId id = ++s_numCreated_;
+    Timer timer;
+    timer.callback = std::move(cb);
+    timer.expiration = Timestamp::monotonicMicros() + static_cast<int64_t>(delay * 1000000);
+    timer.interval = static_cast<int64_t>(interval * 1000000);
+    loop_->runInLoop(std::bind(&TimerQueue::addTimerInLoop, this, id, timer));
+    return id;
+}
+
+void TimerQueue::cancel(TimerId timerId)
+{
+    loop_->runInLoop(std::bind(&TimerQueue::cancelInLoop, this, timerId));
+}
+
+void TimerQueue::addTimerInLoop(TimerId id, const Timer &timer)
+{
+    bool earliestChanged = timers_.empty() || timer.expiration < timers_.begin()->first;
+    timers_.insert(Entry(timer.expiration, id));
+    active_[id] = timer;
+    if (earliestChanged)
+    {
+        resetTimerfd(timer.expiration);
+    }
+}
+
+void TimerQueue::cancelInLoop(TimerId id)
+{
+    auto it = active_.find(id);
+    if (it != active_.end())
+    {
+        timers_.erase(Entry(it->second.expiration, id));
+        active_.erase(it);
+    }
+}
+
+void TimerQueue::handleRead()
+{
+    uint64_t howmany;
+    ::read(timerfd_, &howmany, sizeof howmany);
+
+    // 先把到期的都摘下来再执行，回调里可能会增删定时器
+    int64_t now = Timestamp::monotonicMicros();
+    std::vector<TimerId> expired;
+    while (!timers_.empty() && timers_.begin()->first <= now)
+    {
+        expired.push_back(timers_.begin()->second);
+        timers_.erase(timers_.begin());
+    }
+    for (TimerId id : expired)
+    {
+        auto it = active_.find(id);
+        if (it == active_.end())
+        {
+            continue; // 在前面的回调里被cancel了
+        }
+        TimerCallback cb = it->second.callback;
+        if (it->second.interval > 0)
+        {
+            it->second.expiration = now + it->second.interval;
+            timers_.insert(Entry(it->second.expiration, id));
+        }
+        else
+        {
+            active_.erase(it);
+        }
+        cb();
+    }
+    if (!timers_.empty())
+    {
+        resetTimerfd(timers_.begin()->first);
+    }
+}
+
+void TimerQueue::resetTimerfd(int64_t expiration)
+{
+    int64_t micros = expiration - Timestamp::monotonicMicros();
+    if (micros < 100)
+    {
+        micros = 100; // 已经过期的也要设一个很短的时间，0会被timerfd当成关闭
+    }
+    struct itimerspec newValue;
+    memset(&newValue, 0, sizeof newValue);
+    newValue.it_value.tv_sec = static_cast<time_t>(micros / 1000000);
+    newValue.it_value.tv_nsec = static_cast<long>((micros % 1000000) * 1000);
+    if (::timerfd_settime(timerfd_, 0, &newValue, nullptr) < 0)
+    {
+        LOG_ERROR("timerfd_settime error:%d \n", errno);
+    }
+}
@@ -0,0 +1,52 @@
+#pragma once
+
+#include "noncopyable.h"
+#include "Channel.h"
+#include "Callbacks.h"
+
+#include <functional>
+#include <set>
+#include <unordered_map>
+#include <utility>
+#include <atomic>
+
+class EventLoop;
+
+/**
+ * [定时器队列]  一个loop一个，底层用timerfd，把定时器事件和IO事件统一放到poller里处理。
+ * 到期时间用CLOCK_MONOTONIC的微秒数，不受系统时间调整影响。
+ * 所有定时器回调都在loop线程里执行
+ */
+class TimerQueue : noncopyable
+{
+public:
+    using TimerCallback = std::function<void()>;
+
+    explicit TimerQueue(EventLoop *loop);
+    ~TimerQueue();
+
+    // 线程安全：delay秒之后执行cb，interval>0时之后每interval秒执行一次
+    TimerId addTimer(TimerCallback cb, double delay, double interval);
+    void cancel(TimerId timerId);
+
+private:
+    struct Timer
+    {
+        TimerCallback callback;
+        int64_t expiration; // 单调时钟的微秒数
+        int64_t interval;   // 微秒，0表示只执行一次
+    };
+    using Entry = std::pair<int64_t, TimerId>; // (到期时间, id)，set里按到期时间排序
+
+    void addTimerInLoop(TimerId id, const Timer &timer);
+    void cancelInLoop(TimerId id);
+    void handleRead();          // timerfd可读，说明有定时器到期了
+    void resetTimerfd(int64_t expiration);
+
+    EventLoop *loop_;
+    const int timerfd_;
+    Channel timerfdChannel_;
+    std::set<Entry> timers_;
+    std::unordered_map<TimerId, Timer> active_;
+    static std::atomic<uint64_t> s_numCreated_;
+};
@@ -1,6 +1,15 @@
 #include "Timestamp.h"
 
-#include <time.h>
+#include <stdio.h>
+#include <string.h>
+
+namespace
+{
+    // [每个线程缓存上一次格式化的秒和它的前缀]  日志基本都落在同一秒里，只需要重新拼微秒
+    const size_t kPrefixLength = 19; // "2024/01/02 15:04:05"
+    thread_local time_t t_lastSecond = -1;
+    thread_local char t_prefix[80]; // 按6个int都取最长(11字符)算，snprintf不会截断
+}
 
 Timestamp::Timestamp() : microSecondsSinceEpoch_(0) {}
 
@@ -11,26 +20,47 @@ Timestamp::Timestamp(int64_t microSecondsSinceEpoch)
 
 Timestamp Timestamp::now()
 {
-    return Timestamp(time(NULL)); //调用time(NULL)获取用长整型表示的时间
+    struct timespec ts;
+    ::clock_gettime(CLOCK_REALTIME, &ts); // vdso实现，不陷入内核
+    return Timestamp(static_cast<int64_t>(ts.tv_sec) * kMicroSecondsPerSecond + ts.tv_nsec / 1000);
 }
 
-std::string Timestamp::toString() const //讲长整型转换成年月日时分秒表示的stirng时间
+size_t Timestamp::format(char *buf, size_t size, bool showMicroseconds) const
 {
-    char buf[128] = {0};
-    tm *tm_time = localtime(&microSecondsSinceEpoch_); //用localtime把长整型时间转成tm类型
-    snprintf(buf, 128, "%4d/%02d/%02d %02d:%02d:%02d",
-             tm_time->tm_year + 1900, //年是从1900年开始的，所以需要加上1900
-             tm_time->tm_mon + 1,     //月是0-11，所以需要加上1
-             tm_time->tm_mday,
-             tm_time->tm_hour + 8,
-             tm_time->tm_min,
-             tm_time->tm_sec);
-    return buf;
+    time_t seconds = secondsSinceEpoch();
+    if (seconds != t_lastSecond)
+    {
+        // localtime_r按TZ换算成本地时间，不再手动加8小时；可重入，多个loop线程同时打日志也安全
+        struct tm tm_time;
+        ::localtime_r(&seconds, &tm_time);
+        snprintf(t_prefix, sizeof t_prefix, "%4d/%02d/%02d %02d:%02d:%02d",
+                 tm_time.tm_year + 1900, //年是从1900年开始的，所以需要加上1900
+                 tm_time.tm_mon + 1,     //月是0-11，所以需要加上1
+                 tm_time.tm_mday,
+                 tm_time.tm_hour,
+                 tm_time.tm_min,
+                 tm_time.tm_sec);
+        t_lastSecond = seconds;
+    }
+    if (size == 0)
+    {
+        return 0;
+    }
+    size_t len = kPrefixLength < size - 1 ? kPrefixLength : size - 1;
+    memcpy(buf, t_prefix, len);
+    if (showMicroseconds && size > len + 1)
+    {
+        int micros = static_cast<int>(microSecondsSinceEpoch_ % kMicroSecondsPerSecond);
+        int n = snprintf(buf + len, size - len, ".%06d", micros);
+        len += n < static_cast<int>(size - len) ? n : size - len - 1;
+    }
+    buf[len] = '\0';
+    return len;
 }
 
-// #include <iostream>
-// int main()
-// {
-//     std::cout << Timestamp::now().toString() << std::endl;
-//     return 0;
-// }
+std::string Timestamp::toString(bool showMicroseconds) const //讲长整型转换成年月日时分秒表示的stirng时间
+{
+    char buf[64];
+    size_t len = format(buf, sizeof buf, showMicroseconds);
+    return std::string(buf, len);
+}
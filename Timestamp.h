@@ -1,17 +1,67 @@
 #pragma once
 
-#include <iostream>
 #include <string>
+#include <stddef.h>
+#include <stdint.h>
+#include <time.h>
 
-// 时间类
+/**
+ * [时间类]  微秒精度的墙上时间(CLOCK_REALTIME)，用于日志、receiveTime这类需要打印的时间点。
+ * 量耗时、算超时用monotonicNanos/monotonicMicros(CLOCK_MONOTONIC)，不受改系统时间影响。
+ * loop线程里想要"现在"可以直接用EventLoop::pollReturnTime()，每轮poll只取一次时钟
+ */
 class Timestamp
 {
 public:
+    static const int64_t kMicroSecondsPerSecond = 1000 * 1000;
+
     Timestamp();
     explicit Timestamp(int64_t microSecondsSinceEpoch);//加上explicit限制类型隐式转换
     //如果不加explicit意味着构造函数支持int64_t类型和Timestamp类型的隐式转换
-    static Timestamp now();//获取当前时间，静态方法static  now 
-    std::string toString() const;//toString转成年月日的时分秒 
+    static Timestamp now();//获取当前时间，静态方法static  now
+    static Timestamp invalid() { return Timestamp(); }
+
+    // [单调时钟]  只能用来算差值
+    static int64_t monotonicNanos()
+    {
+        struct timespec ts;
+        ::clock_gettime(CLOCK_MONOTONIC, &ts);
+        return static_cast<int64_t>(ts.tv_sec) * 1000000000 + ts.tv_nsec;
+    }
+    static int64_t monotonicMicros() { return monotonicNanos() / 1000; }
+
+    int64_t microSecondsSinceEpoch() const { return microSecondsSinceEpoch_; }
+    time_t secondsSinceEpoch() const { return static_cast<time_t>(microSecondsSinceEpoch_ / kMicroSecondsPerSecond); }
+    bool valid() const { return microSecondsSinceEpoch_ > 0; }
+
+    // 本地时间 "2024/01/02 15:04:05.123456"，线程安全
+    std::string toString(bool showMicroseconds = true) const;//toString转成年月日的时分秒
+    // 写到buf里，返回写入的长度(不含'\0')，不分配内存；同一线程同一秒内复用缓存的"年月日 时分秒"前缀
+    size_t format(char *buf, size_t size, bool showMicroseconds = true) const;
+
 private:
     int64_t microSecondsSinceEpoch_;
-};
\ No newline at end of file
+};
+
+inline bool operator<(Timestamp lhs, Timestamp rhs)
+{
+    return lhs.microSecondsSinceEpoch() < rhs.microSecondsSinceEpoch();
+}
+
+inline bool operator==(Timestamp lhs, Timestamp rhs)
+{
+    return lhs.microSecondsSinceEpoch() == rhs.microSecondsSinceEpoch();
+}
+
+// 相差的秒数
+inline double timeDifference(Timestamp high, Timestamp low)
+{
+    int64_t diff = high.microSecondsSinceEpoch() - low.microSecondsSinceEpoch();
+    return static_cast<double>(diff) / Timestamp::kMicroSecondsPerSecond;
+}
+
+inline Timestamp addTime(Timestamp timestamp, double seconds)
+{
+    int64_t delta = static_cast<int64_t>(seconds * Timestamp::kMicroSecondsPerSecond);
+    return Timestamp(timestamp.microSecondsSinceEpoch() + delta);
+}
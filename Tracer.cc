@@ -0,0 +1,298 @@
+#include "Tracer.h"
+#include "Thread.h"
+#include "CurrentThread.h"
+#include "Logger.h"
+
+#include <errno.h>
+#include <fcntl.h>
+#include <signal.h>
+#include <stdio.h>
+#include <unistd.h>
+
+std::atomic<bool> Tracer::s_enabled_(false);
+thread_local Tracer::Ring *Tracer::t_ring_ = nullptr;
+
+/**
+ * [一个线程的环]  每个事件3个64位字：开始时间、时长、(类型<<56 | arg2<<32 | arg)。
+ * 只有所属线程写；字都是relaxed原子量，写完一个事件再release发布head_，
+ * 读者按head_判断哪些事件在拷贝期间可能被覆盖了
+ */
+class Tracer::Ring
+{
+public:
+    Ring(size_t events, int tid)
+        : tid_(tid), mask_(events - 1), words_(new std::atomic<uint64_t>[events * 3]), head_(0) {}
+
+    void push(uint64_t start, uint64_t dur, uint64_t packed)
+    {
+        uint64_t h = head_.load(std::memory_order_relaxed);
+        std::atomic<uint64_t> *slot = &words_[(h & mask_) * 3];
+        slot[0].store(start, std::memory_order_relaxed);
+        slot[1].store(dur, std::memory_order_relaxed);
+        slot[2].store(packed, std::memory_order_relaxed);
+        head_.store(h + 1, std::memory_order_release);
+    }
+
+    struct Event
+    {
+        uint64_t start;
+        uint64_t dur;
+        uint64_t packed;
+    };
+
+    void copy(std::vector<Event> *out) const
+    {
+        const uint64_t capacity = mask_ + 1;
+        uint64_t h1 = head_.load(std::memory_order_acquire);
+        uint64_t first = h1 > capacity ? h1 - capacity : 0;
+        std::vector<Event> events;
+        events.reserve(h1 - first);
+        for (uint64_t i = first; i < h1; ++i)
+        {
+            const std::atomic<uint64_t> *slot = &words_[(i & mask_) * 3];
+            Event e;
+            e.start = slot[0].load(std::memory_order_relaxed);
+            e.dur = slot[1].load(std::memory_order_relaxed);
+            e.packed = slot[2].load(std::memory_order_relaxed);
+            events.push_back(e);
+        }
+        std::atomic_thread_fence(std::memory_order_acquire);
+        // 拷贝期间写者可能已经绕回来覆盖了前面的槽，下标 <= h2-capacity 的都不可信
+        uint64_t h2 = head_.load(std::memory_order_relaxed);
+        uint64_t valid = h2 >= capacity ? h2 - capacity + 1 : 0;
+        for (uint64_t i = first; i < h1; ++i)
+        {
+            if (i >= valid)
+            {
+                out->push_back(events[i - first]);
+            }
+        }
+    }
+
+    int tid() const { return tid_; }
+
+private:
+    const int tid_;
+    const uint64_t mask_;
+    std::unique_ptr<std::atomic<uint64_t>[]> words_;
+    std::atomic<uint64_t> head_;
+};
+
+namespace
+{
+    int g_signalWriteFd = -1;
+
+    void onTraceSignal(int)
+    {
+        int savedErrno = errno;
+        char c = 1;
+        ssize_t n = ::write(g_signalWriteFd, &c, 1);
+        (void)n;
+        errno = savedErrno;
+    }
+
+    size_t roundUpPowerOfTwo(size_t n)
+    {
+        size_t p = 1;
+        while (p < n)
+            p <<= 1;
+        return p;
+    }
+
+    const char *typeName(int type)
+    {
+        switch (type)
+        {
+        case Tracer::kPoll:
+            return "poll";
+        case Tracer::kChannel:
+            return "channel";
+        case Tracer::kFunctors:
+            return "functors";
+        case Tracer::kWakeup:
+            return "wakeup";
+        default:
+            return "scope";
+        }
+    }
+}
+
+Tracer &Tracer::instance()
+{
+    static Tracer tracer;
+    return tracer;
+}
+
+Tracer::Tracer() : ringEvents_(kDefaultRingEvents)
+{
+    signalPipe_[0] = signalPipe_[1] = -1;
+}
+
+Tracer::~Tracer() = default; // 单例跟进程同生命周期，信号线程不回收
+
+void Tracer::setRingEvents(size_t events)
+{
+    std::unique_lock<std::mutex> lock(mutex_);
+    ringEvents_ = roundUpPowerOfTwo(events < 16 ? 16 : events);
+}
+
+Tracer::Ring *Tracer::ringForThisThread()
+{
+    if (t_ring_ == nullptr)
+    {
+        // 环由rings_持有，线程退出以后还能dump出来
+        std::unique_lock<std::mutex> lock(mutex_);
+        std::shared_ptr<Ring> ring = std::make_shared<Ring>(ringEvents_, CurrentThread::tid());
+        rings_.push_back(ring);
+        t_ring_ = ring.get();
+    }
+    return t_ring_;
+}
+
+void Tracer::record(Type type, int64_t startNs, int64_t durNs, uint64_t arg, uint32_t arg2)
+{
+    uint64_t packed = static_cast<uint64_t>(type) << 56;
+    if (type == kScope)
+    {
+        packed |= arg & 0x00FFFFFFFFFFFFFFULL; // 名字指针，用户态地址只有47位
+    }
+    else
+    {
+        packed |= (static_cast<uint64_t>(arg2 & 0xFFFFFF) << 32) | (arg & 0xFFFFFFFF);
+    }
+    Ring *ring = t_ring_ != nullptr ? t_ring_ : instance().ringForThisThread();
+    ring->push(static_cast<uint64_t>(startNs), static_cast<uint64_t>(durNs), packed);
+}
+
+std::string Tracer::toChromeJson()
+{
+    std::vector<std::shared_ptr<Ring>> rings;
+    {
+        std::unique_lock<std::mutex> lock(mutex_);
+        rings = rings_;
+    }
+    int pid = static_cast<int>(::getpid());
+    std::string out = "{\"displayTimeUnit\":\"ns\",\"traceEvents\":[\n";
+    bool first = true;
+    char buf[256];
+    for (const std::shared_ptr<Ring> &ring : rings)
+    {
+        snprintf(buf, sizeof buf, "%s{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":%d,\"tid\":%d,\"args\":{\"name\":\"tid %d\"}}",
+                 first ? "" : ",\n", pid, ring->tid(), ring->tid());
+        out += buf;
+        first = false;
+
+        std::vector<Ring::Event> events;
+        ring->copy(&events);
+        for (const Ring::Event &e : events)
+        {
+            int type = static_cast<int>(e.packed >> 56);
+            double ts = static_cast<double>(e.start) / 1000.0; // Chrome trace的时间单位是微秒
+            int64_t dur = static_cast<int64_t>(e.dur);
+            std::string args;
+            if (type == kScope)
+            {
+                const char *name = reinterpret_cast<const char *>(e.packed & 0x00FFFFFFFFFFFFFFULL);
+                snprintf(buf, sizeof buf, ",\n{\"name\":\"%s\",\"cat\":\"user\",\"ph\":\"X\",\"pid\":%d,\"tid\":%d,\"ts\":%.3f,\"dur\":%.3f}",
+                         name, pid, ring->tid(), ts, dur / 1000.0);
+                out += buf;
+                continue;
+            }
+            uint32_t arg = static_cast<uint32_t>(e.packed & 0xFFFFFFFF);
+            uint32_t arg2 = static_cast<uint32_t>((e.packed >> 32) & 0xFFFFFF);
+            switch (type)
+            {
+            case kPoll:
+                snprintf(buf, sizeof buf, "{\"events\":%u}", arg);
+                break;
+            case kChannel:
+                snprintf(buf, sizeof buf, "{\"fd\":%u,\"revents\":\"0x%x\"}", arg, arg2);
+                break;
+            case kFunctors:
+                snprintf(buf, sizeof buf, "{\"count\":%u}", arg);
+                break;
+            default:
+                snprintf(buf, sizeof buf, "{\"fd\":%u}", arg);
+                break;
+            }
+            args = buf;
+            if (dur < 0)
+            {
+                snprintf(buf, sizeof buf, ",\n{\"name\":\"%s\",\"cat\":\"reactor\",\"ph\":\"i\",\"s\":\"t\",\"pid\":%d,\"tid\":%d,\"ts\":%.3f,\"args\":",
+                         typeName(type), pid, ring->tid(), ts);
+            }
+            else
+            {
+                snprintf(buf, sizeof buf, ",\n{\"name\":\"%s\",\"cat\":\"reactor\",\"ph\":\"X\",\"pid\":%d,\"tid\":%d,\"ts\":%.3f,\"dur\":%.3f,\"args\":",
+                         typeName(type), pid, ring->tid(), ts, dur / 1000.0);
+            }
+            out += buf;
+            out += args;
+            out += '}';
+        }
+    }
+    out += "\n]}\n";
+    return out;
+}
+
+bool Tracer::dumpChromeJson(const std::string &path)
+{
+    std::string json = toChromeJson();
+    FILE *fp = ::fopen(path.c_str(), "w");
+    if (fp == nullptr)
+    {
+        LOG_ERROR("Tracer::dumpChromeJson open %s failed, errno:%d \n", path.c_str(), errno);
+        return false;
+    }
+    size_t n = ::fwrite(json.data(), 1, json.size(), fp);
+    ::fclose(fp);
+    return n == json.size();
+}
+
+bool Tracer::dumpOnSignal(int signo, const std::string &pathPrefix)
+{
+    std::unique_lock<std::mutex> lock(mutex_);
+    signalPathPrefix_ = pathPrefix;
+    if (signalThread_)
+    {
+        return true; // 已经装过了，只更新路径
+    }
+    if (::pipe2(signalPipe_, O_CLOEXEC) < 0)
+    {
+        LOG_ERROR("Tracer::dumpOnSignal pipe error:%d \n", errno);
+        return false;
+    }
+    g_signalWriteFd = signalPipe_[1];
+    struct sigaction sa;
+    sa.sa_handler = onTraceSignal;
+    sigemptyset(&sa.sa_mask);
+    sa.sa_flags = SA_RESTART;
+    if (::sigaction(signo, &sa, nullptr) < 0)
+    {
+        LOG_ERROR("Tracer::dumpOnSignal sigaction error:%d \n", errno);
+        return false;
+    }
+    signalThread_.reset(new Thread(std::bind(&Tracer::signalThread, this), "TraceDumper"));
+    signalThread_->start();
+    return true;
+}
+
+void Tracer::signalThread()
+{
+    int seq = 0;
+    char c;
+    while (::read(signalPipe_[0], &c, 1) > 0 || errno == EINTR)
+    {
+        std::string prefix;
+        {
+            std::unique_lock<std::mutex> lock(mutex_);
+            prefix = signalPathPrefix_;
+        }
+        char path[64];
+        snprintf(path, sizeof path, ".%d.%d.json", static_cast<int>(::getpid()), seq++);
+        if (dumpChromeJson(prefix + path))
+        {
+            LOG_INFO("trace dumped to %s%s \n", prefix.c_str(), path);
+        }
+    }
+}
@@ -0,0 +1,94 @@
+#pragma once
+
+#include "noncopyable.h"
+#include "Timestamp.h"
+
+#include <atomic>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+#include <stdint.h>
+
+class Thread;
+
+/**
+ * [reactor热路径的事件追踪]  每个线程一个固定大小的二进制环形缓冲区，记录纳秒精度的事件：
+ * poll(等待时长和返回的事件数)、每个channel的分发(fd、revents、耗时)、doPendingFunctors(个数、耗时)、
+ * wakeup，以及用户用TRACE_SCOPE标记的区间。环满了覆盖最旧的事件。
+ * - 默认关闭，关闭时每个埋点只有一次relaxed load
+ * - 写入只碰本线程的环，没有锁；环在线程第一次记录时分配，线程退出后也保留，dump时还能看到
+ * - dumpChromeJson输出Chrome trace / Perfetto能直接打开的JSON(chrome://tracing、ui.perfetto.dev)
+ * - dumpOnSignal(SIGUSR2, "/tmp/mymuduo")之后，kill -USR2 <pid> 就会写出 /tmp/mymuduo.<pid>.<n>.json
+ */
+class Tracer : noncopyable
+{
+public:
+    enum Type
+    {
+        kPoll,     // arg: 返回的事件数
+        kChannel,  // arg: fd，arg2: revents
+        kFunctors, // arg: 执行的functor个数
+        kWakeup,   // 瞬时事件，arg: 被唤醒loop的eventfd
+        kScope,    // TRACE_SCOPE，arg: 名字(静态字符串)
+    };
+
+    static const size_t kDefaultRingEvents = 64 * 1024;
+
+    static Tracer &instance();
+
+    static bool enabled() { return s_enabled_.load(std::memory_order_relaxed); }
+    void setEnabled(bool on) { s_enabled_.store(on, std::memory_order_relaxed); }
+    // 只对之后新分配的环生效，一般在setEnabled之前调用
+    void setRingEvents(size_t events);
+
+    // 记录到当前线程的环里，durNs<0表示瞬时事件
+    static void record(Type type, int64_t startNs, int64_t durNs, uint64_t arg, uint32_t arg2 = 0);
+
+    // 任何线程都可以调用，正在被覆盖的事件会被丢掉，不会读到半条
+    std::string toChromeJson();
+    bool dumpChromeJson(const std::string &path);
+    // 收到信号时由后台线程写文件，信号处理函数里只写一个字节到管道
+    bool dumpOnSignal(int signo, const std::string &pathPrefix);
+
+private:
+    class Ring;
+
+    Tracer();
+    ~Tracer();
+    Ring *ringForThisThread();
+    void signalThread();
+
+    static std::atomic<bool> s_enabled_;
+    static thread_local Ring *t_ring_;
+    std::mutex mutex_; // 保护rings_和配置
+    std::vector<std::shared_ptr<Ring>> rings_;
+    size_t ringEvents_;
+    std::string signalPathPrefix_;
+    int signalPipe_[2];
+    std::unique_ptr<Thread> signalThread_;
+};
+
+// [用户区间]  TRACE_SCOPE("compress");  name必须是静态字符串，只存指针
+class TraceScope : noncopyable
+{
+public:
+    explicit TraceScope(const char *name)
+        : name_(name), start_(Tracer::enabled() ? Timestamp::monotonicNanos() : -1) {}
+    ~TraceScope()
+    {
+        if (start_ >= 0)
+        {
+            Tracer::record(Tracer::kScope, start_, Timestamp::monotonicNanos() - start_,
+                           reinterpret_cast<uintptr_t>(name_));
+        }
+    }
+
+private:
+    const char *name_;
+    int64_t start_;
+};
+
+#define TRACE_SCOPE_CAT2(a, b) a##b
+#define TRACE_SCOPE_CAT(a, b) TRACE_SCOPE_CAT2(a, b)
+#define TRACE_SCOPE(name) TraceScope TRACE_SCOPE_CAT(traceScope_, __LINE__)(name)
@@ -0,0 +1,457 @@
+#include "UdpChannel.h"
+#include "Logger.h"
+
+#include <algorithm>
+#include <errno.h>
+#include <string.h>
+#include <unistd.h>
+#include <netinet/in.h>
+#include <netinet/udp.h>
+
+#ifndef SOL_UDP
+#define SOL_UDP 17
+#endif
+#ifndef UDP_SEGMENT
+#define UDP_SEGMENT 103 // linux 4.18
+#endif
+#ifndef UDP_GRO
+#define UDP_GRO 104 // linux 5.0
+#endif
+
+namespace
+{
+    const int kMaxReadRounds = 4;        // 一次读事件里最多连续recvmmsg几批，剩下的等下一轮(电平触发)
+    const size_t kMaxGsoSegments = 64;   // UDP_MAX_SEGMENTS
+    const size_t kMaxUdpPayload = 65507; // 65535 - IPv4头 - UDP头，IPv6也按这个算
+    const size_t kGroSlotSize = 65536;   // GRO合并以后的包最大64KB
+    // 接收放GRO的段大小(int)，发送放UDP_SEGMENT(uint16_t)，按大的分配
+    const size_t kControlSpace = CMSG_SPACE(sizeof(int));
+
+    int createUdpSocket(sa_family_t family)
+    {
+        int sockfd = ::socket(family, SOCK_DGRAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+        if (sockfd < 0)
+        {
+            LOG_FATAL("%s:%s:%d udp socket create err:%d \n", __FILE__, __FUNCTION__, __LINE__, errno);
+        }
+        return sockfd;
+    }
+
+    // 都是从InetAddress拷过来的，没用到的字节是0，可以直接比较
+    bool samePeer(const sockaddr_in6 &a, socklen_t aLen, const sockaddr_in6 &b, socklen_t bLen)
+    {
+        return aLen == bLen && memcmp(&a, &b, aLen) == 0;
+    }
+}
+
+UdpStatsSnapshot::UdpStatsSnapshot()
+{
+    memset(this, 0, sizeof *this);
+}
+
+void UdpStatsSnapshot::merge(const UdpStatsSnapshot &other)
+{
+    packetsIn += other.packetsIn;
+    bytesIn += other.bytesIn;
+    recvCalls += other.recvCalls;
+    truncated += other.truncated;
+    packetsOut += other.packetsOut;
+    bytesOut += other.bytesOut;
+    sendCalls += other.sendCalls;
+    gsoSends += other.gsoSends;
+    sendDrops += other.sendDrops;
+}
+
+UdpChannel::Options::Options()
+    : batchSize(64),
+      maxPacketSize(2048),
+      gro(false),
+      gso(false),
+      gsoMaxSegment(1472),
+      maxPendingBytes(4 * 1024 * 1024)
+{
+}
+
+UdpChannel::UdpChannel(EventLoop *loop, const InetAddress &addr, const Options &options, bool reusePort)
+    : loop_(loop),
+      socket_(createUdpSocket(addr.family())),
+      channel_(loop, socket_.fd()),
+      options_(options),
+      gro_(false),
+      gso_(false),
+      flushScheduled_(false),
+      reading_(false),
+      slotSize_(0),
+      sendHead_(0),
+      packetsIn_(0),
+      bytesIn_(0),
+      recvCalls_(0),
+      truncated_(0),
+      packetsOut_(0),
+      bytesOut_(0),
+      sendCalls_(0),
+      gsoSends_(0),
+      sendDrops_(0)
+{
+    socket_.setReuseAddr(true);
+    socket_.setReusePort(reusePort);
+    socket_.bindAddress(addr);
+
+    int on = 1;
+    if (options_.gro)
+    {
+        gro_ = ::setsockopt(socket_.fd(), SOL_UDP, UDP_GRO, &on, sizeof on) == 0;
+    }
+    if (options_.gso)
+    {
+        // 能读到UDP_SEGMENT就说明内核支持，真正的段大小每条消息用cmsg指定
+        int segment = 0;
+        socklen_t len = sizeof segment;
+        gso_ = ::getsockopt(socket_.fd(), SOL_UDP, UDP_SEGMENT, &segment, &len) == 0;
+    }
+    if ((options_.gro && !gro_) || (options_.gso && !gso_))
+    {
+        LOG_INFO("UdpChannel: kernel lacks %s%s, falling back \n",
+                 options_.gro && !gro_ ? "UDP_GRO " : "", options_.gso && !gso_ ? "UDP_SEGMENT" : "");
+    }
+
+    size_t batch = static_cast<size_t>(options_.batchSize > 0 ? options_.batchSize : 1);
+    slotSize_ = gro_ ? kGroSlotSize : options_.maxPacketSize;
+    recvData_.resize(batch * slotSize_);
+    recvMsgs_.resize(batch);
+    recvIov_.resize(batch);
+    recvAddrs_.resize(batch);
+    recvControl_.resize(gro_ ? batch * kControlSpace : 0);
+    memset(recvMsgs_.data(), 0, batch * sizeof(mmsghdr));
+    for (size_t i = 0; i < batch; ++i)
+    {
+        recvIov_[i].iov_base = &recvData_[i * slotSize_];
+        recvIov_[i].iov_len = slotSize_;
+        msghdr &hdr = recvMsgs_[i].msg_hdr;
+        hdr.msg_name = &recvAddrs_[i];
+        hdr.msg_iov = &recvIov_[i];
+        hdr.msg_iovlen = 1;
+        hdr.msg_control = gro_ ? &recvControl_[i * kControlSpace] : nullptr;
+    }
+
+    sendMsgs_.resize(batch);
+    sendMsgPackets_.resize(batch);
+    sendIov_.resize(gso_ ? batch * kMaxGsoSegments : batch);
+    sendControl_.resize(gso_ ? batch * kControlSpace : 0);
+
+    channel_.setReadCallback(std::bind(&UdpChannel::handleRead, this, std::placeholders::_1));
+    channel_.setWriteCallback(std::bind(&UdpChannel::handleWrite, this));
+}
+
+UdpChannel::~UdpChannel()
+{
+}
+
+void UdpChannel::start()
+{
+    channel_.enableReading();
+}
+
+void UdpChannel::stop()
+{
+    channel_.disableAll();
+    channel_.remove();
+    if (flushScheduled_)
+    {
+        flushScheduled_ = false;
+        loop_->cancelFlush(this);
+    }
+}
+
+InetAddress UdpChannel::localAddress() const
+{
+    sockaddr_in6 addr;
+    memset(&addr, 0, sizeof addr);
+    socklen_t len = sizeof addr;
+    if (::getsockname(socket_.fd(), reinterpret_cast<sockaddr *>(&addr), &len) < 0)
+    {
+        LOG_ERROR("UdpChannel::localAddress getsockname errno=%d \n", errno);
+    }
+    return InetAddress::fromSockAddr(reinterpret_cast<sockaddr *>(&addr), len);
+}
+
+void UdpChannel::handleRead(Timestamp receiveTime)
+{
+    const int batch = static_cast<int>(recvMsgs_.size());
+    for (int round = 0; round < kMaxReadRounds; ++round)
+    {
+        // 内核会改写namelen/controllen/flags，每批重新填
+        for (int i = 0; i < batch; ++i)
+        {
+            msghdr &hdr = recvMsgs_[i].msg_hdr;
+            hdr.msg_namelen = sizeof(sockaddr_in6);
+            hdr.msg_controllen = gro_ ? kControlSpace : 0;
+            hdr.msg_flags = 0;
+        }
+        int n = ::recvmmsg(socket_.fd(), recvMsgs_.data(), batch, MSG_DONTWAIT, nullptr);
+        if (n < 0)
+        {
+            if (errno != EAGAIN && errno != EWOULDBLOCK && errno != EINTR)
+            {
+                LOG_ERROR("UdpChannel::handleRead recvmmsg errno=%d \n", errno);
+            }
+            break;
+        }
+        add(&recvCalls_, 1);
+
+        reading_ = true; // 回调里的send只排队，下面统一发
+        uint64_t packets = 0;
+        uint64_t bytes = 0;
+        for (int i = 0; i < n; ++i)
+        {
+            const msghdr &hdr = recvMsgs_[i].msg_hdr;
+            if (hdr.msg_flags & MSG_TRUNC)
+            {
+                add(&truncated_, 1);
+                continue;
+            }
+            const char *data = static_cast<const char *>(recvIov_[i].iov_base);
+            size_t len = recvMsgs_[i].msg_len;
+            size_t segment = len;
+            if (gro_)
+            {
+                for (cmsghdr *cmsg = CMSG_FIRSTHDR(&hdr); cmsg != nullptr; cmsg = CMSG_NXTHDR(const_cast<msghdr *>(&hdr), cmsg))
+                {
+                    if (cmsg->cmsg_level == SOL_UDP && cmsg->cmsg_type == UDP_GRO)
+                    {
+                        int gsoSize = 0;
+                        memcpy(&gsoSize, CMSG_DATA(cmsg), sizeof gsoSize);
+                        if (gsoSize > 0)
+                        {
+                            segment = static_cast<size_t>(gsoSize);
+                        }
+                    }
+                }
+            }
+            InetAddress peer = InetAddress::fromSockAddr(reinterpret_cast<const sockaddr *>(&recvAddrs_[i]), hdr.msg_namelen);
+            // GRO合并的包按段大小拆回原来的数据报，最后一段可以短一些；len为0的空数据报也交给回调
+            size_t offset = 0;
+            do
+            {
+                size_t piece = std::min(segment, len - offset);
+                if (messageCallback_)
+                {
+                    messageCallback_(this, data + offset, piece, peer, receiveTime);
+                }
+                offset += piece;
+                ++packets;
+            } while (offset < len);
+            bytes += len;
+        }
+        reading_ = false;
+        add(&packetsIn_, packets);
+        add(&bytesIn_, bytes);
+
+        if (sendHead_ < sendQueue_.size() && !channel_.isWriting())
+        {
+            flushPending();
+        }
+        if (n < batch)
+        {
+            break;
+        }
+    }
+}
+
+void UdpChannel::handleWrite()
+{
+    flushPending();
+}
+
+void UdpChannel::flush()
+{
+    flushScheduled_ = false;
+    if (!channel_.isWriting()) // 在等EPOLLOUT，handleWrite会接着发
+    {
+        flushPending();
+    }
+}
+
+void UdpChannel::send(const InetAddress &peer, const void *data, size_t len)
+{
+    if (loop_->isInLoopThread())
+    {
+        sendInLoop(peer, data, len);
+    }
+    else
+    {
+        std::string message(static_cast<const char *>(data), len);
+        loop_->runInLoop([this, peer, message]()
+                         { sendInLoop(peer, message.data(), message.size()); });
+    }
+}
+
+void UdpChannel::sendInLoop(const InetAddress &peer, const void *data, size_t len)
+{
+    if (peer.getSockLen() > sizeof(sockaddr_in6))
+    {
+        LOG_ERROR("UdpChannel::send to non-IP address %s \n", peer.toIpPort().c_str());
+        add(&sendDrops_, 1);
+        return;
+    }
+    // 已经发出去的还占着arena，直到队列清空才复用，所以这里的上限是偏保守的
+    if (sendArena_.size() + len > options_.maxPendingBytes)
+    {
+        add(&sendDrops_, 1);
+        return;
+    }
+    PendingPacket packet;
+    packet.offset = sendArena_.size();
+    packet.len = len;
+    memset(&packet.peer, 0, sizeof packet.peer);
+    memcpy(&packet.peer, peer.getSockAddr(), peer.getSockLen());
+    packet.peerLen = peer.getSockLen();
+    const char *p = static_cast<const char *>(data);
+    sendArena_.insert(sendArena_.end(), p, p + len);
+    sendQueue_.push_back(packet);
+    // 读回调里的send由handleRead统一发；在等EPOLLOUT的由handleWrite发
+    if (!reading_ && !flushScheduled_ && !channel_.isWriting())
+    {
+        flushScheduled_ = true;
+        loop_->deferFlush(this);
+    }
+}
+
+size_t UdpChannel::buildSendBatch(size_t first, size_t *packets)
+{
+    size_t msgs = 0;
+    size_t iov = 0;
+    size_t i = first;
+    while (i < sendQueue_.size() && msgs < sendMsgs_.size())
+    {
+        const PendingPacket &head = sendQueue_[i];
+        size_t segments = 1;
+        if (gso_ && head.len > 0 && head.len <= options_.gsoMaxSegment)
+        {
+            // 同一个对端、同样大小的连续数据报合成一条消息，最后一段可以短一些
+            size_t total = head.len;
+            while (i + segments < sendQueue_.size() && segments < kMaxGsoSegments)
+            {
+                const PendingPacket &next = sendQueue_[i + segments];
+                if (next.len == 0 || next.len > head.len || total + next.len > kMaxUdpPayload ||
+                    !samePeer(next.peer, next.peerLen, head.peer, head.peerLen))
+                {
+                    break;
+                }
+                total += next.len;
+                ++segments;
+                if (next.len < head.len)
+                {
+                    break;
+                }
+            }
+        }
+
+        for (size_t k = 0; k < segments; ++k)
+        {
+            const PendingPacket &packet = sendQueue_[i + k];
+            sendIov_[iov + k].iov_base = &sendArena_[0] + packet.offset;
+            sendIov_[iov + k].iov_len = packet.len;
+        }
+        msghdr &hdr = sendMsgs_[msgs].msg_hdr;
+        memset(&hdr, 0, sizeof hdr);
+        hdr.msg_name = const_cast<sockaddr_in6 *>(&head.peer);
+        hdr.msg_namelen = head.peerLen;
+        hdr.msg_iov = &sendIov_[iov];
+        hdr.msg_iovlen = segments;
+        if (segments > 1)
+        {
+            hdr.msg_control = &sendControl_[msgs * kControlSpace];
+            hdr.msg_controllen = CMSG_SPACE(sizeof(uint16_t));
+            cmsghdr *cmsg = CMSG_FIRSTHDR(&hdr);
+            cmsg->cmsg_level = SOL_UDP;
+            cmsg->cmsg_type = UDP_SEGMENT;
+            cmsg->cmsg_len = CMSG_LEN(sizeof(uint16_t));
+            uint16_t segmentSize = static_cast<uint16_t>(head.len);
+            memcpy(CMSG_DATA(cmsg), &segmentSize, sizeof segmentSize);
+        }
+        sendMsgPackets_[msgs] = segments;
+        iov += segments;
+        i += segments;
+        ++msgs;
+    }
+    *packets = i - first;
+    return msgs;
+}
+
+void UdpChannel::flushPending()
+{
+    while (sendHead_ < sendQueue_.size())
+    {
+        size_t packets = 0;
+        size_t msgs = buildSendBatch(sendHead_, &packets);
+        int n = ::sendmmsg(socket_.fd(), sendMsgs_.data(), static_cast<unsigned int>(msgs), MSG_DONTWAIT);
+        add(&sendCalls_, 1);
+        if (n < 0)
+        {
+            int savedErrno = errno;
+            if (savedErrno == EAGAIN || savedErrno == EWOULDBLOCK)
+            {
+                if (!channel_.isWriting())
+                {
+                    channel_.enableWriting();
+                }
+                return;
+            }
+            if (savedErrno == EINTR)
+            {
+                continue;
+            }
+            if (sendMsgPackets_[0] > 1 && (savedErrno == EINVAL || savedErrno == EIO))
+            {
+                // 段大小超过了出口MTU，或者网卡/内核不支持UDP分段：关掉GSO，重新逐包发
+                LOG_INFO("UdpChannel: UDP_SEGMENT send failed errno=%d, disabling GSO \n", savedErrno);
+                gso_ = false;
+                continue;
+            }
+            // 第一条消息发不出去(EMSGSIZE、对端不可达等)，丢掉它，后面的继续发
+            LOG_ERROR("UdpChannel::flushPending sendmmsg errno=%d \n", savedErrno);
+            add(&sendDrops_, sendMsgPackets_[0]);
+            sendHead_ += sendMsgPackets_[0];
+            continue;
+        }
+
+        uint64_t sent = 0;
+        uint64_t bytes = 0;
+        uint64_t gso = 0;
+        for (int i = 0; i < n; ++i)
+        {
+            sent += sendMsgPackets_[i];
+            bytes += sendMsgs_[i].msg_len;
+            gso += sendMsgPackets_[i] > 1 ? 1 : 0;
+        }
+        add(&packetsOut_, sent);
+        add(&bytesOut_, bytes);
+        add(&gsoSends_, gso);
+        sendHead_ += sent;
+    }
+
+    // 全部发完，arena和队列从头复用
+    sendArena_.clear();
+    sendQueue_.clear();
+    sendHead_ = 0;
+    if (channel_.isWriting())
+    {
+        channel_.disableWriting();
+    }
+}
+
+UdpStatsSnapshot UdpChannel::stats() const
+{
+    UdpStatsSnapshot s;
+    s.packetsIn = packetsIn_.load(std::memory_order_relaxed);
+    s.bytesIn = bytesIn_.load(std::memory_order_relaxed);
+    s.recvCalls = recvCalls_.load(std::memory_order_relaxed);
+    s.truncated = truncated_.load(std::memory_order_relaxed);
+    s.packetsOut = packetsOut_.load(std::memory_order_relaxed);
+    s.bytesOut = bytesOut_.load(std::memory_order_relaxed);
+    s.sendCalls = sendCalls_.load(std::memory_order_relaxed);
+    s.gsoSends = gsoSends_.load(std::memory_order_relaxed);
+    s.sendDrops = sendDrops_.load(std::memory_order_relaxed);
+    return s;
+}
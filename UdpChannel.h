@@ -0,0 +1,140 @@
+#pragma once
+
+#include "noncopyable.h"
+#include "EventLoop.h"
+#include "Socket.h"
+#include "Channel.h"
+#include "InetAddress.h"
+#include "Timestamp.h"
+
+#include <atomic>
+#include <functional>
+#include <string>
+#include <vector>
+#include <stdint.h>
+#include <sys/socket.h>
+
+class UdpChannel;
+
+// [收到一个数据报]  data只在回调里有效，回复用channel->send
+using UdpMessageCallback = std::function<void(UdpChannel *channel, const char *data, size_t len,
+                                              const InetAddress &peer, Timestamp receiveTime)>;
+
+// [UDP收发计数]  值类型，UdpServer::stats()把所有loop的加起来
+struct UdpStatsSnapshot
+{
+    UdpStatsSnapshot();
+    void merge(const UdpStatsSnapshot &other);
+
+    uint64_t packetsIn;  // 交给回调的数据报(GRO合并的按拆开以后算)
+    uint64_t bytesIn;
+    uint64_t recvCalls;  // recvmmsg次数，packetsIn / recvCalls就是平均批量
+    uint64_t truncated;  // 超过maxPacketSize被截断、丢掉的
+    uint64_t packetsOut; // 发出去的数据报(GSO合并的按段算)
+    uint64_t bytesOut;
+    uint64_t sendCalls;  // sendmmsg次数
+    uint64_t gsoSends;   // 其中用UDP_SEGMENT合成一个大包发的消息数
+    uint64_t sendDrops;  // 发送队列满或者发送出错丢掉的
+};
+
+/**
+ * [一个loop上的UDP socket]  IPv4或IPv6(按绑定地址的family)，绑定地址、注册到loop，读事件里用recvmmsg一次收一批，
+ * 回调里send的回复先排队，这一批处理完再用sendmmsg一次发出去；
+ * 不在读回调里的send(定时器、runInLoop)登记到本轮末尾的DeferredFlush一起发。
+ * 收发用的缓冲区、mmsghdr、iovec都在构造时分配好，之后反复使用，收包路径上没有内存分配。
+ *
+ * GRO：内核把同一个流上连续的小包合成一个大包交上来，回调前按段大小拆开，少很多次协议栈处理；
+ * GSO：发给同一个对端、大小相同的连续回复合成一条消息，用UDP_SEGMENT让内核(或网卡)切段，
+ * 段大小超过gsoMaxSegment的不合并(不能超过路径MTU)，内核不支持时自动退回逐包发送。
+ * 所有方法都只能在loop线程里调用，send除外
+ */
+class UdpChannel : private DeferredFlush, noncopyable
+{
+public:
+    struct Options
+    {
+        Options();
+        int batchSize;        // 一次recvmmsg最多收几个包，默认64
+        size_t maxPacketSize; // 单个数据报的上限，默认2048；打开GRO时每个接收槽按64KB分配
+        bool gro;             // UDP_GRO
+        bool gso;             // UDP_SEGMENT
+        size_t gsoMaxSegment; // 参与GSO合并的最大段，默认1472(以太网MTU 1500 - IP/UDP头)
+        size_t maxPendingBytes; // socket发不动时最多排队多少字节，超过的丢掉，默认4MB
+    };
+
+    // 创建socket并bind；reusePort时多个UdpChannel可以绑同一个地址，由内核按四元组分流
+    UdpChannel(EventLoop *loop, const InetAddress &addr, const Options &options, bool reusePort);
+    ~UdpChannel() override;
+
+    void setMessageCallback(const UdpMessageCallback &cb) { messageCallback_ = cb; }
+    void start(); // 开始收包，在loop线程里调用
+    void stop();  // 从poller摘掉，析构前在loop线程里调用
+
+    // [发一个数据报]  loop线程里只是拷贝进发送队列；其他线程调用时拷贝一份投递到loop
+    void send(const InetAddress &peer, const void *data, size_t len);
+
+    EventLoop *getLoop() const { return loop_; }
+    int fd() const { return socket_.fd(); }
+    InetAddress localAddress() const; // 绑定端口0时拿到实际端口
+    bool groEnabled() const { return gro_; }
+    bool gsoEnabled() const { return gso_; }
+    UdpStatsSnapshot stats() const; // 任何线程都可以调用
+
+private:
+    struct PendingPacket
+    {
+        size_t offset; // 在sendArena_里的位置，arena扩容以后仍然有效
+        size_t len;
+        sockaddr_in6 peer; // IPv4的对端也放在这里，peerLen区分
+        socklen_t peerLen;
+    };
+
+    void handleRead(Timestamp receiveTime);
+    void handleWrite();
+    void flush() override;  // 本轮末尾由loop调用
+    void flushPending();    // 把sendQueue_尽量发出去
+    void sendInLoop(const InetAddress &peer, const void *data, size_t len);
+    size_t buildSendBatch(size_t first, size_t *packets); // 从first开始填sendMsgs_，返回消息数
+    // 单写者的计数，见LoopMetrics::add
+    static void add(std::atomic<uint64_t> *counter, uint64_t delta)
+    {
+        counter->store(counter->load(std::memory_order_relaxed) + delta, std::memory_order_relaxed);
+    }
+
+    EventLoop *loop_;
+    Socket socket_;
+    Channel channel_;
+    const Options options_;
+    bool gro_;
+    bool gso_;
+    bool flushScheduled_;
+    bool reading_; // 正在handleRead里调回调
+    UdpMessageCallback messageCallback_;
+
+    // [接收批]  batchSize个槽，每个槽一块数据区 + 对端地址 + 一个cmsg(GRO的段大小)
+    size_t slotSize_;
+    std::vector<char> recvData_;
+    std::vector<mmsghdr> recvMsgs_;
+    std::vector<iovec> recvIov_;
+    std::vector<sockaddr_in6> recvAddrs_; // IPv4、IPv6都放得下
+    std::vector<char> recvControl_;
+
+    // [发送队列]  数据拷贝进一块连续的arena，全部发完以后清空复用
+    std::vector<char> sendArena_;
+    std::vector<PendingPacket> sendQueue_;
+    size_t sendHead_; // sendQueue_里已经发完的个数
+    std::vector<mmsghdr> sendMsgs_;
+    std::vector<size_t> sendMsgPackets_; // 每条消息里有几个数据报(GSO合并的大于1)
+    std::vector<iovec> sendIov_;
+    std::vector<char> sendControl_;
+
+    std::atomic<uint64_t> packetsIn_;
+    std::atomic<uint64_t> bytesIn_;
+    std::atomic<uint64_t> recvCalls_;
+    std::atomic<uint64_t> truncated_;
+    std::atomic<uint64_t> packetsOut_;
+    std::atomic<uint64_t> bytesOut_;
+    std::atomic<uint64_t> sendCalls_;
+    std::atomic<uint64_t> gsoSends_;
+    std::atomic<uint64_t> sendDrops_;
+};
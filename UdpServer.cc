@@ -0,0 +1,80 @@
+#include "UdpServer.h"
+#include "Logger.h"
+
+#include <future>
+
+UdpServer::UdpServer(EventLoop *loop, const InetAddress &listenAddr, const std::string &nameArg)
+    : loop_(loop),
+      listenAddr_(listenAddr),
+      name_(nameArg),
+      threadPool_(new EventLoopThreadPool(loop, nameArg)),
+      started_(0)
+{
+    if (loop_ == nullptr)
+    {
+        LOG_FATAL("%s:%s:%d mainLoop is null! \n", __FILE__, __FUNCTION__, __LINE__);
+    }
+}
+
+UdpServer::~UdpServer()
+{
+    // channel只能在自己的loop里从poller摘掉，投递过去并等它做完
+    for (std::unique_ptr<UdpChannel> &item : channels_)
+    {
+        UdpChannel *channel = item.get();
+        EventLoop *ioLoop = channel->getLoop();
+        if (ioLoop->isInLoopThread())
+        {
+            channel->stop();
+        }
+        else
+        {
+            std::promise<void> done;
+            ioLoop->runInLoop([channel, &done]()
+                              {
+                channel->stop();
+                done.set_value(); });
+            done.get_future().wait();
+        }
+    }
+}
+
+void UdpServer::start()
+{
+    if (started_++ != 0)
+    {
+        return;
+    }
+    threadPool_->start(threadInitCallback_);
+    // socket在调用线程里创建、bind，bind失败直接LOG_FATAL；端口0时后面的socket绑第一个分到的端口
+    InetAddress bindAddr = listenAddr_;
+    for (EventLoop *ioLoop : threadPool_->getAllLoops())
+    {
+        UdpChannel *channel = new UdpChannel(ioLoop, bindAddr, options_, true);
+        channels_.push_back(std::unique_ptr<UdpChannel>(channel));
+        if (channels_.size() == 1 && listenAddr_.toPort() == 0)
+        {
+            bindAddr = channel->localAddress();
+        }
+        channel->setMessageCallback(messageCallback_);
+        ioLoop->runInLoop(std::bind(&UdpChannel::start, channel));
+    }
+    LOG_INFO("UdpServer [%s] listening on %s with %zu socket(s)%s%s \n", name_.c_str(),
+             bindAddr.toIpPort().c_str(), channels_.size(),
+             channels_[0]->groEnabled() ? " gro" : "", channels_[0]->gsoEnabled() ? " gso" : "");
+}
+
+InetAddress UdpServer::localAddress() const
+{
+    return channels_.empty() ? listenAddr_ : channels_[0]->localAddress();
+}
+
+UdpStatsSnapshot UdpServer::stats() const
+{
+    UdpStatsSnapshot total;
+    for (const std::unique_ptr<UdpChannel> &channel : channels_)
+    {
+        total.merge(channel->stats());
+    }
+    return total;
+}
@@ -0,0 +1,61 @@
+#pragma once
+
+#include "noncopyable.h"
+#include "EventLoop.h"
+#include "EventLoopThreadPool.h"
+#include "InetAddress.h"
+#include "UdpChannel.h"
+
+#include <atomic>
+#include <functional>
+#include <memory>
+#include <string>
+#include <vector>
+
+/**
+ * [UDP服务器]  每个io loop一个UdpChannel，都用SO_REUSEPORT绑在同一个地址上，
+ * 内核按四元组哈希把数据报分到各个socket，同一个对端的包总是落在同一个loop，不需要跨线程分发。
+ * 没有连接的概念，回调拿到的是数据报和对端地址，回复用channel->send(peer, ...)
+ *
+ *     UdpServer server(&loop, InetAddress(5353), "dns");
+ *     server.setMessageCallback([](UdpChannel *ch, const char *data, size_t len, const InetAddress &peer, Timestamp)
+ *                               { ch->send(peer, data, len); });
+ *     server.setThreadNum(4);
+ *     server.start();
+ */
+class UdpServer : noncopyable
+{
+public:
+    using ThreadInitCallback = std::function<void(EventLoop *)>;
+
+    UdpServer(EventLoop *loop, const InetAddress &listenAddr, const std::string &nameArg);
+    ~UdpServer();
+
+    // 下面都在start之前设置
+    void setThreadNum(int numThreads) { threadPool_->setThreadNum(numThreads); }
+    void setThreadInitCallback(const ThreadInitCallback &cb) { threadInitCallback_ = cb; }
+    void setMessageCallback(const UdpMessageCallback &cb) { messageCallback_ = cb; }
+    // 批量大小、GRO/GSO等，见UdpChannel::Options
+    void setOptions(const UdpChannel::Options &options) { options_ = options; }
+    const UdpChannel::Options &options() const { return options_; }
+
+    void start();
+
+    EventLoop *getLoop() const { return loop_; }
+    const std::string &name() const { return name_; }
+    // [start之后有效]  实际绑定的地址(端口0时由内核分配)和每个loop上的UdpChannel
+    InetAddress localAddress() const;
+    const std::vector<std::unique_ptr<UdpChannel>> &channels() const { return channels_; }
+    UdpStatsSnapshot stats() const; // 任何线程都可以调用
+
+private:
+    EventLoop *loop_;
+    const InetAddress listenAddr_;
+    const std::string name_;
+    std::shared_ptr<EventLoopThreadPool> threadPool_;
+    ThreadInitCallback threadInitCallback_;
+    UdpMessageCallback messageCallback_;
+    UdpChannel::Options options_;
+    std::atomic_int started_;
+    std::vector<std::unique_ptr<UdpChannel>> channels_; // 和threadPool_->getAllLoops()一一对应
+};
@@ -0,0 +1,297 @@
+#include "WorkStealingExecutor.h"
+
+#include <linux/futex.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#include <limits.h>
+#include <thread>
+
+namespace
+{
+    // 当前线程所属的线程池和worker下标
+    thread_local const WorkStealingExecutor *t_executor = nullptr;
+    thread_local int t_workerIndex = -1;
+
+    void futexWait(std::atomic<uint32_t> *addr, uint32_t expected)
+    {
+        ::syscall(SYS_futex, reinterpret_cast<uint32_t *>(addr), FUTEX_WAIT_PRIVATE, expected, nullptr, nullptr, 0);
+    }
+
+    void futexWake(std::atomic<uint32_t> *addr, int count)
+    {
+        ::syscall(SYS_futex, reinterpret_cast<uint32_t *>(addr), FUTEX_WAKE_PRIVATE, count, nullptr, nullptr, 0);
+    }
+
+    uint64_t xorshift(uint64_t *state)
+    {
+        uint64_t x = *state;
+        x ^= x << 13;
+        x ^= x >> 7;
+        x ^= x << 17;
+        *state = x;
+        return x;
+    }
+}
+
+WorkStealingExecutor::WorkStealingExecutor(const std::string &name)
+    : name_(name),
+      numThreads_(1),
+      running_(false),
+      submitting_(0),
+      nextInbox_(0),
+      epoch_(0),
+      sleepers_(0),
+      searching_(0)
+{
+}
+
+WorkStealingExecutor::~WorkStealingExecutor()
+{
+    if (running_)
+    {
+        stop();
+    }
+}
+
+void WorkStealingExecutor::start()
+{
+    if (numThreads_ <= 0)
+    {
+        return; // 没有worker，submit一直返回false
+    }
+    workers_.reserve(numThreads_);
+    for (int i = 0; i < numThreads_; ++i)
+    {
+        workers_.push_back(std::unique_ptr<Worker>(new Worker));
+        workers_[i]->rng = 0x9E3779B97F4A7C15ULL * (i + 1);
+    }
+    // 所有Worker建好之后再起线程，worker之间会互相访问
+    for (int i = 0; i < numThreads_; ++i)
+    {
+        workers_[i]->thread.reset(new Thread(std::bind(&WorkStealingExecutor::runInThread, this, i),
+                                             name_ + std::to_string(i)));
+        workers_[i]->thread->start();
+    }
+    running_ = true;
+}
+
+void WorkStealingExecutor::stop()
+{
+    // 和submit里的 submitting_++ / running_ 检查配对：要么submit看到running_已经是false，
+    // 要么这里看到它还在submit，等它放完任务
+    running_.store(false, std::memory_order_seq_cst);
+    while (submitting_.load(std::memory_order_seq_cst) > 0)
+    {
+        std::this_thread::yield();
+    }
+    epoch_.fetch_add(1);
+    futexWake(&epoch_, INT_MAX);
+    for (std::unique_ptr<Worker> &worker : workers_)
+    {
+        worker->thread->join();
+    }
+    // worker退出前已经把能找到的都做完了，这里兜底，不丢任务
+    for (std::unique_ptr<Worker> &worker : workers_)
+    {
+        while (Task *task = worker->deque.pop())
+        {
+            (*task)();
+            delete task;
+        }
+        for (Task *task : worker->inbox)
+        {
+            (*task)();
+            delete task;
+        }
+        worker->inbox.clear();
+    }
+    // 外部submit都被拒绝了，worker线程也都退出了，没有人再访问workers_
+    workers_.clear();
+}
+
+int WorkStealingExecutor::currentWorker() const
+{
+    return t_executor == this ? t_workerIndex : -1;
+}
+
+bool WorkStealingExecutor::submit(Task task)
+{
+    int index = currentWorker();
+    if (index >= 0)
+    {
+        // worker线程里拆出来的子任务：worker退出之前会把自己队列里的做完，stop期间也接受
+        workers_[index]->deque.push(new Task(std::move(task)));
+        notify();
+        return true;
+    }
+
+    submitting_.fetch_add(1, std::memory_order_seq_cst);
+    if (!running_.load(std::memory_order_seq_cst))
+    {
+        submitting_.fetch_sub(1, std::memory_order_release);
+        return false;
+    }
+    Task *item = new Task(std::move(task));
+    Worker *worker = workers_[nextInbox_.fetch_add(1, std::memory_order_relaxed) % workers_.size()].get();
+    {
+        std::unique_lock<std::mutex> lock(worker->inboxMutex);
+        worker->inbox.push_back(item);
+        worker->inboxSize.store(worker->inbox.size(), std::memory_order_relaxed);
+    }
+    notify();
+    submitting_.fetch_sub(1, std::memory_order_release);
+    return true;
+}
+
+// [有人在睡、又没人在找活才唤醒]  和runInThread里的 searching_-- / sleepers_++ / hasWork() 构成Dekker式的配对：
+// 要么这里看到了正在找活或者在睡的worker，要么对方在睡前复查时看到了刚放进去的任务
+void WorkStealingExecutor::notify()
+{
+    std::atomic_thread_fence(std::memory_order_seq_cst);
+    if (searching_.load(std::memory_order_relaxed) == 0 && sleepers_.load(std::memory_order_relaxed) > 0)
+    {
+        epoch_.fetch_add(1, std::memory_order_seq_cst);
+        futexWake(&epoch_, 1);
+    }
+}
+
+WorkStealingExecutor::Task *WorkStealingExecutor::takeInbox(Worker *worker)
+{
+    if (worker->inboxSize.load(std::memory_order_relaxed) == 0)
+    {
+        return nullptr;
+    }
+    std::unique_lock<std::mutex> lock(worker->inboxMutex);
+    if (worker->inbox.empty())
+    {
+        return nullptr;
+    }
+    Task *task = worker->inbox.back();
+    worker->inbox.pop_back();
+    worker->inboxSize.store(worker->inbox.size(), std::memory_order_relaxed);
+    return task;
+}
+
+WorkStealingExecutor::Task *WorkStealingExecutor::findTask(int index)
+{
+    Worker *self = workers_[index].get();
+    Task *task = self->deque.pop();
+    if (task != nullptr)
+    {
+        return task;
+    }
+
+    // 自己的收件箱一次全搬进队列，后面无锁pop，别人也能从队列里偷
+    if (self->inboxSize.load(std::memory_order_relaxed) > 0)
+    {
+        std::vector<Task *> inbox;
+        {
+            std::unique_lock<std::mutex> lock(self->inboxMutex);
+            inbox.swap(self->inbox);
+            self->inboxSize.store(0, std::memory_order_relaxed);
+        }
+        for (Task *t : inbox)
+        {
+            self->deque.push(t);
+        }
+        task = self->deque.pop();
+        if (task != nullptr)
+        {
+            return task;
+        }
+    }
+
+    // 从随机位置开始把其他worker轮一遍
+    const size_t n = workers_.size();
+    size_t start = static_cast<size_t>(xorshift(&self->rng) % n);
+    for (size_t i = 0; i < n; ++i)
+    {
+        size_t victim = (start + i) % n;
+        if (victim == static_cast<size_t>(index))
+        {
+            continue;
+        }
+        Worker *other = workers_[victim].get();
+        task = other->deque.steal();
+        if (task == nullptr)
+        {
+            task = takeInbox(other);
+        }
+        if (task != nullptr)
+        {
+            return task;
+        }
+    }
+    return nullptr;
+}
+
+bool WorkStealingExecutor::hasWork() const
+{
+    for (const std::unique_ptr<Worker> &worker : workers_)
+    {
+        if (!worker->deque.empty() || worker->inboxSize.load(std::memory_order_relaxed) > 0)
+        {
+            return true;
+        }
+    }
+    return false;
+}
+
+void WorkStealingExecutor::runInThread(int index)
+{
+    t_executor = this;
+    t_workerIndex = index;
+    bool searching = false;
+    while (true)
+    {
+        Task *task = findTask(index);
+        if (task != nullptr)
+        {
+            if (searching)
+            {
+                // 最后一个找活的worker找到了活，可能还有更多活，接力叫醒一个
+                searching = false;
+                if (searching_.fetch_sub(1, std::memory_order_seq_cst) == 1)
+                {
+                    notify();
+                }
+            }
+            (*task)();
+            delete task;
+            continue;
+        }
+        if (!running_.load(std::memory_order_acquire))
+        {
+            break; // stop以后把找得到的任务做完再退出
+        }
+        if (!searching)
+        {
+            // 先以找活的身份再轮一遍，这期间submit不用唤醒别人
+            searching = true;
+            searching_.fetch_add(1, std::memory_order_seq_cst);
+            continue;
+        }
+
+        // 准备睡：先登记，再复查一遍，避免和submit之间丢唤醒
+        searching = false;
+        uint32_t epoch = epoch_.load(std::memory_order_acquire);
+        searching_.fetch_sub(1, std::memory_order_seq_cst);
+        sleepers_.fetch_add(1, std::memory_order_seq_cst);
+        std::atomic_thread_fence(std::memory_order_seq_cst);
+        if (hasWork() || !running_.load())
+        {
+            sleepers_.fetch_sub(1, std::memory_order_relaxed);
+            continue;
+        }
+        futexWait(&epoch_, epoch);
+        sleepers_.fetch_sub(1, std::memory_order_relaxed);
+        searching = true; // 被叫醒的worker先当找活的
+        searching_.fetch_add(1, std::memory_order_seq_cst);
+    }
+    if (searching)
+    {
+        searching_.fetch_sub(1, std::memory_order_relaxed);
+    }
+    t_executor = nullptr;
+    t_workerIndex = -1;
+}
@@ -0,0 +1,184 @@
+#pragma once
+
+#include "noncopyable.h"
+#include "Thread.h"
+
+#include <atomic>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+#include <stdint.h>
+
+/**
+ * [Chase-Lev无锁双端队列]  只有owner线程push/pop底部，其他线程从顶部steal。
+ * 按Lê等人针对弱内存模型的版本实现，满了自动扩容，旧数组留到析构时再释放(steal可能还在读)
+ */
+template <typename T>
+class WorkStealingDeque : noncopyable
+{
+public:
+    explicit WorkStealingDeque(int64_t capacity = 256)
+        : top_(0), bottom_(0), array_(new Array(capacity))
+    {
+        garbage_.push_back(std::unique_ptr<Array>(array_.load(std::memory_order_relaxed)));
+    }
+
+    // 只能owner调用
+    void push(T *item)
+    {
+        int64_t b = bottom_.load(std::memory_order_relaxed);
+        int64_t t = top_.load(std::memory_order_acquire);
+        Array *a = array_.load(std::memory_order_relaxed);
+        if (b - t > a->capacity - 1)
+        {
+            a = grow(a, b, t);
+        }
+        a->put(b, item);
+        std::atomic_thread_fence(std::memory_order_release);
+        bottom_.store(b + 1, std::memory_order_relaxed);
+    }
+
+    // 只能owner调用，LIFO，空了返回nullptr
+    T *pop()
+    {
+        int64_t b = bottom_.load(std::memory_order_relaxed) - 1;
+        Array *a = array_.load(std::memory_order_relaxed);
+        bottom_.store(b, std::memory_order_relaxed);
+        std::atomic_thread_fence(std::memory_order_seq_cst);
+        int64_t t = top_.load(std::memory_order_relaxed);
+        T *item = nullptr;
+        if (t <= b)
+        {
+            item = a->get(b);
+            if (t == b)
+            {
+                // 最后一个元素，和steal抢
+                if (!top_.compare_exchange_strong(t, t + 1, std::memory_order_seq_cst, std::memory_order_relaxed))
+                {
+                    item = nullptr;
+                }
+                bottom_.store(b + 1, std::memory_order_relaxed);
+            }
+        }
+        else
+        {
+            bottom_.store(b + 1, std::memory_order_relaxed);
+        }
+        return item;
+    }
+
+    // 任何线程调用，FIFO，空了或者抢失败了返回nullptr
+    T *steal()
+    {
+        int64_t t = top_.load(std::memory_order_acquire);
+        std::atomic_thread_fence(std::memory_order_seq_cst);
+        int64_t b = bottom_.load(std::memory_order_acquire);
+        if (t < b)
+        {
+            Array *a = array_.load(std::memory_order_acquire);
+            T *item = a->get(t);
+            if (top_.compare_exchange_strong(t, t + 1, std::memory_order_seq_cst, std::memory_order_relaxed))
+            {
+                return item;
+            }
+        }
+        return nullptr;
+    }
+
+    bool empty() const
+    {
+        return bottom_.load(std::memory_order_relaxed) <= top_.load(std::memory_order_relaxed);
+    }
+
+private:
+    struct Array
+    {
+        explicit Array(int64_t cap) : capacity(cap), mask(cap - 1), slots(new std::atomic<T *>[cap]) {}
+        T *get(int64_t i) const { return slots[i & mask].load(std::memory_order_relaxed); }
+        void put(int64_t i, T *item) { slots[i & mask].store(item, std::memory_order_relaxed); }
+        const int64_t capacity; // 2的幂
+        const int64_t mask;
+        std::unique_ptr<std::atomic<T *>[]> slots;
+    };
+
+    Array *grow(Array *old, int64_t b, int64_t t)
+    {
+        Array *a = new Array(old->capacity * 2);
+        for (int64_t i = t; i < b; ++i)
+        {
+            a->put(i, old->get(i));
+        }
+        garbage_.push_back(std::unique_ptr<Array>(a));
+        array_.store(a, std::memory_order_release);
+        return a;
+    }
+
+    char pad0_[64];
+    std::atomic<int64_t> top_;
+    char pad1_[64];
+    std::atomic<int64_t> bottom_;
+    std::atomic<Array *> array_;
+    std::vector<std::unique_ptr<Array>> garbage_; // 只有owner在grow时写
+};
+
+/**
+ * [工作窃取线程池]  每个worker一个Chase-Lev队列：
+ * - worker线程里submit的任务(比如一个请求拆出来的子任务)直接进自己的队列，无锁
+ * - 外部线程(IO loop)submit的任务随机投到某个worker的收件箱，锁分散到各个worker上，不是一把全局锁
+ * - 自己没活了随机挑worker偷，队列顶部和收件箱都可以偷
+ * - 都没活就用futex睡在一个eventcount上。submit时只有在有人睡、且没有worker正在找活的时候才唤醒，
+ *   找到活的worker再去叫醒下一个，避免每个任务都触发一次futex唤醒
+ * 任务之间没有顺序保证
+ */
+class WorkStealingExecutor : noncopyable
+{
+public:
+    using Task = std::function<void()>;
+
+    explicit WorkStealingExecutor(const std::string &name = std::string("WorkStealing"));
+    ~WorkStealingExecutor();
+
+    void setThreadNum(int numThreads) { numThreads_ = numThreads; } // start之前设置
+    int threadNum() const { return numThreads_; }
+
+    void start();
+    // 先拒绝新的外部submit、等正在submit的返回，再让worker把队列里剩下的任务做完后退出
+    void stop();
+
+    // 线程安全。start之前、stop之后(worker线程以外)返回false，任务不会执行
+    bool submit(Task task);
+
+    // 当前线程在这个线程池里是第几个worker，不是返回-1
+    int currentWorker() const;
+
+private:
+    struct Worker
+    {
+        Worker() : inboxSize(0), rng(0) {}
+        WorkStealingDeque<Task> deque;
+        std::mutex inboxMutex;
+        std::vector<Task *> inbox;
+        std::atomic<size_t> inboxSize; // 不加锁判断收件箱是否为空
+        uint64_t rng;                  // 选偷取对象的xorshift状态
+        std::unique_ptr<Thread> thread;
+    };
+
+    void runInThread(int index);
+    Task *findTask(int index);
+    Task *takeInbox(Worker *worker);
+    bool hasWork() const;
+    void notify();
+
+    std::string name_;
+    int numThreads_;
+    std::vector<std::unique_ptr<Worker>> workers_;
+    std::atomic<bool> running_;
+    std::atomic<int> submitting_; // 正在submit的外部线程数，stop等它归零以后才能动workers_
+    std::atomic<uint32_t> nextInbox_;
+    // eventcount：睡眠前记下epoch_，submit递增epoch_并futex唤醒
+    std::atomic<uint32_t> epoch_;
+    std::atomic<int> sleepers_;
+    std::atomic<int> searching_; // 正在偷活、还没睡下的worker数
+};
@@ -0,0 +1,314 @@
+#include "ZeroCopyQueue.h"
+#include "Timestamp.h"
+#include "EventLoop.h"
+
+#include <errno.h>
+#include <string.h>
+#include <unistd.h>
+#include <netinet/in.h>
+#include <sys/socket.h>
+#include <linux/errqueue.h>
+
+#ifndef MSG_ZEROCOPY
+#define MSG_ZEROCOPY 0x4000000 // linux 4.14
+#endif
+#ifndef SO_EE_ORIGIN_ZEROCOPY
+#define SO_EE_ORIGIN_ZEROCOPY 5
+#endif
+#ifndef SO_EE_CODE_ZEROCOPY_COPIED
+#define SO_EE_CODE_ZEROCOPY_COPIED 1
+#endif
+
+namespace
+{
+    const size_t kMaxPooled = 8;                               // 每个线程池里最多留几块
+    const size_t kMaxPooledCapacity = 64 * 1024 * 1024;        // 太大的块不留
+    // [连接没等到完成通知就销毁时]  钉住的块多留一会儿再释放：close以后内核还会把发送队列里剩下的发完，
+    // 局域网上一般几百毫秒内确认完；对端一直不确认的孤儿连接由tcp_orphan_retries兜底，不为它无限期占内存
+    const int64_t kRetireDelayUs = 10 * 1000 * 1000LL;
+    const size_t kMaxRetired = 256;                        // 超过块数或者字节数上限就提前释放最老的
+    const size_t kMaxRetiredBytes = 64 * 1024 * 1024;
+
+    /**
+     * [线程本地的块池]  完成的块回到这里，append(Buffer*)换给调用方；
+     * 连接销毁时还没完成的块不能马上复用(内核可能还在重传这些页)，放到retired里过一段时间再释放。
+     * retired有块数和字节数上限，由loop上的定时器到期释放，不依赖之后还有没有acquire
+     */
+    struct ChunkPool
+    {
+        ChunkPool() : retiredBytes(0), reapScheduled(false) {}
+
+        struct Retired
+        {
+            int64_t deadlineUs;
+            Buffer data;
+        };
+
+        std::vector<Buffer> free;
+        std::deque<Retired> retired;
+        size_t retiredBytes;
+        bool reapScheduled; // 已经在本线程的loop上登记了到期释放的定时器
+
+        Buffer acquire()
+        {
+            reap();
+            if (free.empty())
+            {
+                return Buffer();
+            }
+            Buffer buf(std::move(free.back()));
+            free.pop_back();
+            return buf;
+        }
+        void put(Buffer &&buf)
+        {
+            if (free.size() < kMaxPooled && buf.capacity() <= kMaxPooledCapacity)
+            {
+                buf.retrieveAll();
+                free.push_back(std::move(buf));
+            }
+        }
+        void retire(Buffer &&buf, EventLoop *loop)
+        {
+            reap();
+            Retired r;
+            r.deadlineUs = Timestamp::monotonicMicros() + kRetireDelayUs;
+            r.data = std::move(buf);
+            retiredBytes += r.data.capacity();
+            retired.push_back(std::move(r));
+            // 断开得太多：最老的最可能已经发完，先放掉它们，内存有上限
+            while (retired.size() > kMaxRetired || retiredBytes > kMaxRetiredBytes)
+            {
+                popRetired();
+            }
+            // 定时器回调在loop线程里执行，拿到的是那个线程的池；不在loop线程里析构的连接靠之后的reap
+            if (!retired.empty() && !reapScheduled && loop != nullptr && loop->isInLoopThread())
+            {
+                scheduleReap(loop);
+            }
+        }
+        void reap()
+        {
+            if (retired.empty())
+            {
+                return;
+            }
+            int64_t now = Timestamp::monotonicMicros();
+            while (!retired.empty() && retired.front().deadlineUs <= now)
+            {
+                popRetired();
+            }
+        }
+        void popRetired()
+        {
+            retiredBytes -= retired.front().data.capacity();
+            retired.pop_front();
+        }
+        void scheduleReap(EventLoop *loop);
+    };
+
+    ChunkPool &chunkPool()
+    {
+        static thread_local ChunkPool pool;
+        return pool;
+    }
+
+    void ChunkPool::scheduleReap(EventLoop *loop)
+    {
+        reapScheduled = true;
+        int64_t delayUs = retired.front().deadlineUs - Timestamp::monotonicMicros();
+        loop->runAfter(delayUs > 0 ? delayUs / 1e6 : 0.0, [loop]()
+                       {
+            ChunkPool &pool = chunkPool();
+            pool.reapScheduled = false;
+            pool.reap();
+            if (!pool.retired.empty())
+            {
+                pool.scheduleReap(loop);
+            } });
+    }
+}
+
+ZeroCopyQueue::ZeroCopyQueue(EventLoop *loop, bool zerocopy)
+    : loop_(loop),
+      queuedBytes_(0),
+      nextId_(0),
+      completedId_(0),
+      anyCompleted_(false),
+      zerocopy_(zerocopy),
+      zerocopySends_(0),
+      completions_(0),
+      copied_(0)
+{
+}
+
+ZeroCopyQueue::~ZeroCopyQueue()
+{
+    ChunkPool &pool = chunkPool();
+    for (Chunk &chunk : chunks_)
+    {
+        if (chunk.handedOff)
+        {
+            pool.retire(std::move(chunk.data), loop_);
+        }
+        else
+        {
+            pool.put(std::move(chunk.data));
+        }
+    }
+    for (Chunk &chunk : pinned_)
+    {
+        pool.retire(std::move(chunk.data), loop_);
+    }
+}
+
+void ZeroCopyQueue::append(Buffer *buf)
+{
+    size_t len = buf->readableBytes();
+    if (len == 0)
+    {
+        return;
+    }
+    Chunk chunk;
+    chunk.data = chunkPool().acquire();
+    chunk.data.swap(*buf); // 调用方拿到池里的空Buffer
+    chunk.pinned = true;
+    chunk.handedOff = false;
+    chunk.lastId = 0;
+    chunks_.push_back(std::move(chunk));
+    queuedBytes_ += len;
+}
+
+void ZeroCopyQueue::append(const void *data, size_t len, bool pinned)
+{
+    if (len == 0)
+    {
+        return;
+    }
+    // 队尾是普通块就接在后面；普通块不会被钉住，扩容搬家也没关系
+    if (!pinned && !chunks_.empty() && !chunks_.back().pinned)
+    {
+        chunks_.back().data.append(static_cast<const char *>(data), len);
+    }
+    else
+    {
+        Chunk chunk;
+        chunk.data = chunkPool().acquire();
+        chunk.data.append(static_cast<const char *>(data), len);
+        chunk.pinned = pinned;
+        chunk.handedOff = false;
+        chunk.lastId = 0;
+        chunks_.push_back(std::move(chunk));
+    }
+    queuedBytes_ += len;
+}
+
+ssize_t ZeroCopyQueue::write(int fd, int *savedErrno)
+{
+    ssize_t total = 0;
+    while (!chunks_.empty())
+    {
+        Chunk &chunk = chunks_.front();
+        size_t len = chunk.data.readableBytes();
+        bool zerocopy = zerocopy_ && chunk.pinned;
+        ssize_t n = zerocopy ? ::send(fd, chunk.data.peek(), len, MSG_ZEROCOPY)
+                             : ::write(fd, chunk.data.peek(), len);
+        if (n < 0 && zerocopy && errno == ENOBUFS)
+        {
+            // 没完成的通知太多，超过了net.core.optmem_max：这一次退回普通拷贝
+            zerocopy = false;
+            n = ::write(fd, chunk.data.peek(), len);
+        }
+        if (n < 0)
+        {
+            if (total == 0)
+            {
+                *savedErrno = errno;
+                return -1;
+            }
+            break;
+        }
+        if (zerocopy)
+        {
+            chunk.handedOff = true;
+            chunk.lastId = nextId_++;
+            ++zerocopySends_;
+        }
+        chunk.data.retrieve(n); // 只移动下标，不碰内存
+        queuedBytes_ -= n;
+        total += n;
+        if (static_cast<size_t>(n) < len)
+        {
+            break; // socket发送缓冲区满了
+        }
+
+        if (!chunk.handedOff)
+        {
+            chunkPool().put(std::move(chunk.data));
+        }
+        else if (anyCompleted_ && static_cast<int32_t>(chunk.lastId - completedId_) <= 0)
+        {
+            chunkPool().put(std::move(chunk.data)); // 最后一段的通知已经先到了
+        }
+        else
+        {
+            pinned_.push_back(std::move(chunk));
+        }
+        chunks_.pop_front();
+    }
+    return total;
+}
+
+int ZeroCopyQueue::handleCompletions(int fd)
+{
+    int handled = 0;
+    while (true)
+    {
+        char control[128];
+        msghdr msg;
+        memset(&msg, 0, sizeof msg);
+        msg.msg_control = control;
+        msg.msg_controllen = sizeof control;
+        if (::recvmsg(fd, &msg, MSG_ERRQUEUE | MSG_DONTWAIT) < 0)
+        {
+            break; // EAGAIN：读完了
+        }
+        for (cmsghdr *cmsg = CMSG_FIRSTHDR(&msg); cmsg != nullptr; cmsg = CMSG_NXTHDR(&msg, cmsg))
+        {
+            if (!((cmsg->cmsg_level == SOL_IP && cmsg->cmsg_type == IP_RECVERR) ||
+                  (cmsg->cmsg_level == SOL_IPV6 && cmsg->cmsg_type == IPV6_RECVERR)))
+            {
+                continue;
+            }
+            sock_extended_err err;
+            memcpy(&err, CMSG_DATA(cmsg), sizeof err);
+            if (err.ee_origin != SO_EE_ORIGIN_ZEROCOPY || err.ee_errno != 0)
+            {
+                continue;
+            }
+            // [ee_info, ee_data]这一段序号的send都完成了
+            uint32_t count = err.ee_data - err.ee_info + 1;
+            completions_ += count;
+            if (err.ee_code & SO_EE_CODE_ZEROCOPY_COPIED)
+            {
+                copied_ += count;
+                zerocopy_ = false; // 内核没能零拷贝，继续用只会多出钉页和通知的开销
+            }
+            release(err.ee_data);
+            ++handled;
+        }
+    }
+    return handled;
+}
+
+void ZeroCopyQueue::release(uint32_t completedId)
+{
+    completedId_ = completedId;
+    anyCompleted_ = true;
+    ChunkPool &pool = chunkPool();
+    while (!pinned_.empty() && static_cast<int32_t>(pinned_.front().lastId - completedId) <= 0)
+    {
+        pool.put(std::move(pinned_.front().data));
+        pinned_.pop_front();
+    }
+}
@@ -0,0 +1,71 @@
+#pragma once
+
+#include "noncopyable.h"
+#include "Buffer.h"
+
+#include <deque>
+#include <stdint.h>
+#include <sys/types.h>
+
+class EventLoop;
+
+/**
+ * [MSG_ZEROCOPY发送队列]  一个连接一个，只在loop线程里用。大块数据整块进队列(Buffer交换进来，不拷贝)，
+ * 用send(MSG_ZEROCOPY)发：内核直接引用这块内存的页，不再拷贝到socket缓冲区。
+ * 交给内核以后这块内存就被"钉住"了，要等错误队列(MSG_ERRQUEUE)上的完成通知才能改写或者释放，
+ * 完成以后Buffer回到线程本地的池里，下一次send(Buffer*)换给调用方继续用，不用重新分配、缺页。
+ *
+ * 队列非空时后来的小数据也拷贝进队尾，保证字节顺序；它们走普通write。
+ * 内核报告"其实拷贝了"(回环、网卡不支持SG)时不再用MSG_ZEROCOPY，只保留整块转交的好处。
+ * 只适用于TCP：完成通知按序号顺序到达
+ */
+class ZeroCopyQueue : noncopyable
+{
+public:
+    // zerocopy=false时(socket不支持SO_ZEROCOPY)只做整块转交，用普通write；
+    // loop是连接所在的loop，析构时还钉住的块在它上面定时释放
+    ZeroCopyQueue(EventLoop *loop, bool zerocopy);
+    ~ZeroCopyQueue();
+
+    // 拿走buf里的全部可读数据(交换底层存储)，buf换成池里的一个空Buffer
+    void append(Buffer *buf);
+    // 拷贝一份进队尾；pinned为true时这一段单独成块、用MSG_ZEROCOPY发
+    void append(const void *data, size_t len, bool pinned);
+    // 按顺序写到socket发不动为止，返回写了多少；一个字节都没写出去时返回-1，errno在savedErrno里
+    ssize_t write(int fd, int *savedErrno);
+    // 读完错误队列上的完成通知，释放已经完成的块；返回处理了几条通知
+    int handleCompletions(int fd);
+
+    bool empty() const { return chunks_.empty(); } // 没有待发送的数据(钉住的不算)
+    size_t queuedBytes() const { return queuedBytes_; }
+    size_t pinnedChunks() const { return pinned_.size(); }
+    bool zerocopy() const { return zerocopy_; }
+
+    // [统计]  loop线程里读
+    uint64_t zerocopySends() const { return zerocopySends_; }   // 带MSG_ZEROCOPY的send次数
+    uint64_t completions() const { return completions_; }       // 完成通知覆盖的send次数
+    uint64_t copiedCompletions() const { return copied_; }      // 其中内核实际做了拷贝的
+
+private:
+    struct Chunk
+    {
+        Buffer data;
+        bool pinned;       // 用MSG_ZEROCOPY发
+        bool handedOff;    // 已经有一部分用MSG_ZEROCOPY交给了内核，完成之前不能动
+        uint32_t lastId;   // 最后一次MSG_ZEROCOPY send的序号
+    };
+
+    void release(uint32_t completedId);
+
+    EventLoop *loop_;
+    std::deque<Chunk> chunks_; // 待发送
+    std::deque<Chunk> pinned_; // 发完了，等完成通知
+    size_t queuedBytes_;
+    uint32_t nextId_; // 内核给每次成功的MSG_ZEROCOPY send编号，从0开始
+    uint32_t completedId_; // 已经完成到哪个序号(含)，anyCompleted_为true时有效
+    bool anyCompleted_;
+    bool zerocopy_;
+    uint64_t zerocopySends_;
+    uint64_t completions_;
+    uint64_t copied_;
+};
@@ -23,7 +23,13 @@ if [ ! -d /usr/include/mymuduo ]; then
     mkdir /usr/include/mymuduo
 fi
 
-for header in `ls *.h`  #把当前目录下面的头文件拷贝到系统头文件mymuduo下面
+headers="*.h http/*.h redis/*.h"
+# CMake找到OpenSSL时库里编译了tls模块(链接了libssl)，它的头文件也要装上
+if ldd `pwd`/lib/libmymuduo.so | grep -q libssl; then
+    headers="$headers tls/*.h"
+fi
+
+for header in `ls $headers`  #把当前目录和http、redis(、tls)模块的头文件拷贝到系统头文件mymuduo下面
 do
     cp $header /usr/include/mymuduo
 done
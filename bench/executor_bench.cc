@@ -0,0 +1,177 @@
+/**
+ * [计算线程池压测]  模拟fan-out型的请求：外部线程(相当于IO loop)提交请求，
+ * 请求在线程池里拆成fanout个子任务，子任务全部完成请求才算完成。
+ * 对比 WorkStealingExecutor 和 一把mutex+condvar的全局队列，线程数从1翻倍到maxThreads。
+ * 输出:  executor_bench <实现> threads=.. requests=.. tasks/s=.. requests/s=..
+ *
+ * 用法: ./executor_bench [最大线程数=64] [请求数=20000] [fanout=16] [子任务计算量=2000] [提交线程数=2]
+ */
+#include "WorkStealingExecutor.h"
+
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+#include <stdio.h>
+#include <stdlib.h>
+
+namespace
+{
+    // [对照组]  所有线程共用一个队列
+    class CentralQueueExecutor
+    {
+    public:
+        using Task = std::function<void()>;
+
+        explicit CentralQueueExecutor(int numThreads) : running_(true)
+        {
+            for (int i = 0; i < numThreads; ++i)
+            {
+                threads_.emplace_back([this]()
+                                      { run(); });
+            }
+        }
+        ~CentralQueueExecutor()
+        {
+            {
+                std::unique_lock<std::mutex> lock(mutex_);
+                running_ = false;
+                notEmpty_.notify_all();
+            }
+            for (std::thread &t : threads_)
+                t.join();
+        }
+        void submit(Task task)
+        {
+            std::unique_lock<std::mutex> lock(mutex_);
+            queue_.push_back(std::move(task));
+            notEmpty_.notify_one();
+        }
+
+    private:
+        void run()
+        {
+            while (true)
+            {
+                Task task;
+                {
+                    std::unique_lock<std::mutex> lock(mutex_);
+                    while (queue_.empty() && running_)
+                        notEmpty_.wait(lock);
+                    if (!running_)
+                        return;
+                    task = std::move(queue_.front());
+                    queue_.pop_front();
+                }
+                task();
+            }
+        }
+
+        std::mutex mutex_;
+        std::condition_variable notEmpty_;
+        std::deque<Task> queue_;
+        bool running_;
+        std::vector<std::thread> threads_;
+    };
+
+    struct Workload
+    {
+        long requests;
+        int fanout;
+        int work;
+        int producers;
+    };
+
+    std::atomic<uint64_t> g_sink(0);
+
+    void spin(int n)
+    {
+        uint64_t x = 88172645463325252ULL;
+        for (int i = 0; i < n; ++i)
+        {
+            x ^= x << 13;
+            x ^= x >> 7;
+            x ^= x << 17;
+        }
+        g_sink.fetch_add(x & 1, std::memory_order_relaxed);
+    }
+
+    template <typename Executor>
+    double runOnce(Executor *executor, const Workload &w)
+    {
+        std::atomic<long> completed(0);
+        std::mutex mutex;
+        std::condition_variable done;
+
+        auto request = [executor, &w, &completed, &mutex, &done]()
+        {
+            std::shared_ptr<std::atomic<int>> remaining = std::make_shared<std::atomic<int>>(w.fanout);
+            for (int i = 0; i < w.fanout; ++i)
+            {
+                executor->submit([remaining, &w, &completed, &mutex, &done]()
+                                 {
+                    spin(w.work);
+                    if (remaining->fetch_sub(1) == 1 && completed.fetch_add(1) + 1 == w.requests)
+                    {
+                        std::unique_lock<std::mutex> lock(mutex);
+                        done.notify_one();
+                    } });
+            }
+        };
+
+        auto start = std::chrono::steady_clock::now();
+        std::vector<std::thread> producers;
+        for (int p = 0; p < w.producers; ++p)
+        {
+            producers.emplace_back([executor, &w, &request, p]()
+                                   {
+                for (long i = p; i < w.requests; i += w.producers)
+                    executor->submit(request); });
+        }
+        for (std::thread &t : producers)
+            t.join();
+        {
+            std::unique_lock<std::mutex> lock(mutex);
+            while (completed.load() < w.requests)
+                done.wait(lock);
+        }
+        return std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    }
+
+    void report(const char *impl, int threads, const Workload &w, double seconds)
+    {
+        printf("executor_bench %-13s threads=%-2d requests=%ld fanout=%d seconds=%.3f tasks/s=%.0f requests/s=%.0f\n",
+               impl, threads, w.requests, w.fanout, seconds,
+               w.requests * (w.fanout + 1) / seconds, w.requests / seconds);
+        fflush(stdout);
+    }
+}
+
+int main(int argc, char *argv[])
+{
+    int maxThreads = argc > 1 ? atoi(argv[1]) : 64;
+    Workload w;
+    w.requests = argc > 2 ? atol(argv[2]) : 20000;
+    w.fanout = argc > 3 ? atoi(argv[3]) : 16;
+    w.work = argc > 4 ? atoi(argv[4]) : 2000;
+    w.producers = argc > 5 ? atoi(argv[5]) : 2;
+
+    for (int threads = 1; threads <= maxThreads; threads *= 2)
+    {
+        {
+            WorkStealingExecutor executor("bench");
+            executor.setThreadNum(threads);
+            executor.start();
+            report("work-stealing", threads, w, runOnce(&executor, w));
+        }
+        {
+            CentralQueueExecutor executor(threads);
+            report("central-queue", threads, w, runOnce(&executor, w));
+        }
+    }
+    return 0;
+}
@@ -0,0 +1,193 @@
+/**
+ * [HttpServer吞吐压测]  进程内启动HttpServer，再用裸epoll写的压测客户端打本地端口。
+ * 每个连接一次发送depth个pipelined请求，收齐响应后再发下一批。
+ * 输出:  http_bench threads=.. conns=.. depth=.. requests=.. rps=..
+ *
+ * 用法: ./http_bench [loop线程数=1] [客户端线程数=1] [每线程连接数=32] [pipeline深度=1] [秒数=5] [端口=9981]
+ */
+#include "HttpServer.h"
+#include "EventLoop.h"
+#include "Logger.h"
+
+#include <atomic>
+#include <chrono>
+#include <string>
+#include <thread>
+#include <vector>
+#include <errno.h>
+#include <fcntl.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <sys/epoll.h>
+#include <sys/socket.h>
+
+namespace
+{
+    const char kRequest[] = "GET /hello HTTP/1.1\r\nHost: localhost\r\nUser-Agent: http_bench\r\n\r\n";
+    const char kBody[] = "hello, world!\n";
+
+    void onRequest(const HttpRequest &req, HttpResponse *resp)
+    {
+        if (req.path() == "/hello")
+        {
+            resp->setContentType("text/plain");
+            resp->setBody(kBody);
+        }
+        else
+        {
+            resp->setStatusCode(HttpResponse::k404NotFound);
+        }
+    }
+
+    int connectTo(uint16_t port)
+    {
+        int fd = ::socket(AF_INET, SOCK_STREAM | SOCK_CLOEXEC, 0);
+        sockaddr_in addr;
+        memset(&addr, 0, sizeof addr);
+        addr.sin_family = AF_INET;
+        addr.sin_port = htons(port);
+        addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+        if (::connect(fd, reinterpret_cast<sockaddr *>(&addr), sizeof addr) < 0)
+        {
+            ::close(fd);
+            return -1;
+        }
+        int one = 1;
+        ::setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &one, sizeof one);
+        ::fcntl(fd, F_SETFL, ::fcntl(fd, F_GETFL) | O_NONBLOCK);
+        return fd;
+    }
+
+    // 先用阻塞方式发一个请求，拿到一个完整响应的字节数，后面按字节数计数
+    size_t probeResponseSize(uint16_t port)
+    {
+        int fd = connectTo(port);
+        if (fd < 0)
+            return 0;
+        ::fcntl(fd, F_SETFL, ::fcntl(fd, F_GETFL) & ~O_NONBLOCK);
+        ::write(fd, kRequest, sizeof kRequest - 1);
+        std::string resp;
+        char buf[4096];
+        while (true)
+        {
+            ssize_t n = ::read(fd, buf, sizeof buf);
+            if (n <= 0)
+                break;
+            resp.append(buf, n);
+            size_t headerEnd = resp.find("\r\n\r\n");
+            if (headerEnd != std::string::npos && resp.size() >= headerEnd + 4 + sizeof kBody - 1)
+                break;
+        }
+        ::close(fd);
+        return resp.size();
+    }
+
+    struct ClientConn
+    {
+        int fd;
+        size_t pendingBytes; // 这一批还没收到的响应字节数
+    };
+
+    void clientThread(uint16_t port, int conns, int depth, size_t respSize,
+                      std::atomic<bool> *stop, std::atomic<long> *total)
+    {
+        int epfd = ::epoll_create1(EPOLL_CLOEXEC);
+        std::vector<ClientConn> clients(conns);
+        std::string batch;
+        for (int i = 0; i < depth; ++i)
+            batch.append(kRequest, sizeof kRequest - 1);
+
+        for (int i = 0; i < conns; ++i)
+        {
+            clients[i].fd = connectTo(port);
+            if (clients[i].fd < 0)
+            {
+                perror("connect");
+                return;
+            }
+            epoll_event ev;
+            ev.events = EPOLLIN;
+            ev.data.ptr = &clients[i];
+            ::epoll_ctl(epfd, EPOLL_CTL_ADD, clients[i].fd, &ev);
+            ::write(clients[i].fd, batch.data(), batch.size());
+            clients[i].pendingBytes = respSize * depth;
+        }
+
+        long done = 0;
+        std::vector<epoll_event> events(conns);
+        char buf[65536];
+        while (!stop->load(std::memory_order_relaxed))
+        {
+            int n = ::epoll_wait(epfd, events.data(), conns, 100);
+            for (int i = 0; i < n; ++i)
+            {
+                ClientConn *c = static_cast<ClientConn *>(events[i].data.ptr);
+                ssize_t r = ::read(c->fd, buf, sizeof buf);
+                if (r <= 0)
+                    continue;
+                c->pendingBytes -= r;
+                if (c->pendingBytes == 0)
+                {
+                    done += depth;
+                    ::write(c->fd, batch.data(), batch.size());
+                    c->pendingBytes = respSize * depth;
+                }
+            }
+        }
+        total->fetch_add(done);
+        for (ClientConn &c : clients)
+            ::close(c.fd);
+        ::close(epfd);
+    }
+}
+
+int main(int argc, char *argv[])
+{
+    int loops = argc > 1 ? atoi(argv[1]) : 1;
+    int threads = argc > 2 ? atoi(argv[2]) : 1;
+    int conns = argc > 3 ? atoi(argv[3]) : 32;
+    int depth = argc > 4 ? atoi(argv[4]) : 1;
+    int seconds = argc > 5 ? atoi(argv[5]) : 5;
+    uint16_t port = static_cast<uint16_t>(argc > 6 ? atoi(argv[6]) : 9981);
+
+    EventLoop loop;
+    HttpServer server(&loop, InetAddress(port), "http_bench");
+    server.setHttpCallback(onRequest);
+    server.setThreadNum(loops);
+    server.start();
+
+    std::atomic<bool> stop(false);
+    std::atomic<long> total(0);
+    std::thread driver([&]()
+                       {
+        // 等base loop开始监听
+        std::this_thread::sleep_for(std::chrono::milliseconds(200));
+        size_t respSize = probeResponseSize(port);
+        if (respSize == 0)
+        {
+            fprintf(stderr, "probe failed\n");
+            loop.quit();
+            return;
+        }
+        std::vector<std::thread> clients;
+        for (int i = 0; i < threads; ++i)
+            clients.emplace_back(clientThread, port, conns, depth, respSize, &stop, &total);
+        std::this_thread::sleep_for(std::chrono::seconds(seconds));
+        stop = true;
+        for (std::thread &t : clients)
+            t.join();
+        loop.quit(); });
+
+    loop.loop();
+    driver.join();
+
+    long requests = total.load();
+    printf("http_bench loops=%d threads=%d conns=%d depth=%d seconds=%d requests=%ld rps=%.0f\n",
+           loops, threads, conns, depth, seconds, requests, static_cast<double>(requests) / seconds);
+    return 0;
+}
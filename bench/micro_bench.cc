@@ -0,0 +1,321 @@
+/**
+ * [组件级微基准]  不依赖第三方库的小型计时框架，覆盖Buffer、queueInLoop、Poller和Channel的热路径，
+ * 改这几个类的时候用来拿改动前后的数据。每一项输出一行JSON:
+ *   {"bench":"micro","name":"buffer/append_retrieve","param":64,"iters":..,"ns_per_op":..,"ops_per_s":..}
+ *
+ * - buffer/append_retrieve   append size字节再retrieveAll，稳态下不扩容
+ * - buffer/sliding           保持512字节未读，每次append/retrieve size字节，触发makeSpace里的前移
+ * - buffer/grow              新Buffer按1KB一块append到param字节，整轮算一次，衡量扩容拷贝
+ * - buffer/readFd            socketpair一端write size字节，另一端readFd(含一次write系统调用)
+ * - loop/queueInLoop         param个生产者线程同时向一个loop投递空任务，按全部执行完计时
+ * - poller/update            已注册param个channel时，对其中一个做EPOLL_CTL_MOD
+ * - poller/add_remove        已注册param个channel时，新增一个channel再删掉
+ * - channel/dispatch         handleEvent到readCallback的开销，param=1表示tie过(要lock一次weak_ptr)
+ *
+ * 用法: ./micro_bench [名字过滤子串] [每项最少运行秒数=0.5]
+ */
+#include "Buffer.h"
+#include "Channel.h"
+#include "EventLoop.h"
+#include "EventLoopThread.h"
+#include "Timestamp.h"
+
+#include <atomic>
+#include <future>
+#include <memory>
+#include <string>
+#include <thread>
+#include <vector>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
+#include <sys/resource.h>
+#include <sys/socket.h>
+
+namespace
+{
+    const char *g_filter = "";
+    double g_minSeconds = 0.5;
+
+    template <typename T>
+    inline void doNotOptimize(const T &value)
+    {
+        asm volatile("" : : "r,m"(value) : "memory");
+    }
+
+    bool selected(const char *name)
+    {
+        return strstr(name, g_filter) != nullptr;
+    }
+
+    void report(const char *name, long param, long iters, double seconds)
+    {
+        double ns = seconds * 1e9 / iters;
+        printf("{\"bench\":\"micro\",\"name\":\"%s\",\"param\":%ld,\"iters\":%ld,\"ns_per_op\":%.1f,\"ops_per_s\":%.0f}\n",
+               name, param, iters, ns, iters / seconds);
+        fflush(stdout);
+    }
+
+    /**
+     * [自动确定迭代次数]  body(n)执行n次被测操作。先翻倍试探到单轮超过10ms，
+     * 再按比例放大到g_minSeconds跑正式的一轮
+     */
+    template <typename Body>
+    void run(const char *name, long param, Body body)
+    {
+        if (!selected(name))
+            return;
+        long iters = 1;
+        double seconds = 0;
+        while (true)
+        {
+            int64_t start = Timestamp::monotonicNanos();
+            body(iters);
+            seconds = (Timestamp::monotonicNanos() - start) / 1e9;
+            if (seconds >= 0.01)
+                break;
+            iters *= 2;
+        }
+        long target = static_cast<long>(iters * (g_minSeconds / seconds)) + 1;
+        int64_t start = Timestamp::monotonicNanos();
+        body(target);
+        seconds = (Timestamp::monotonicNanos() - start) / 1e9;
+        report(name, param, target, seconds);
+    }
+
+    void raiseFdLimit()
+    {
+        rlimit rl;
+        ::getrlimit(RLIMIT_NOFILE, &rl);
+        rl.rlim_cur = rl.rlim_max;
+        ::setrlimit(RLIMIT_NOFILE, &rl);
+    }
+
+    void benchBuffer()
+    {
+        const size_t sizes[] = {16, 64, 1024, 16384};
+        std::string data(65536, 'x');
+        for (size_t size : sizes)
+        {
+            Buffer buf;
+            run("buffer/append_retrieve", static_cast<long>(size), [&](long n)
+                {
+                for (long i = 0; i < n; ++i)
+                {
+                    buf.append(data.data(), size);
+                    doNotOptimize(buf.peek());
+                    buf.retrieveAll();
+                } });
+        }
+        for (size_t size : sizes)
+        {
+            Buffer buf;
+            buf.append(data.data(), 512);
+            run("buffer/sliding", static_cast<long>(size), [&](long n)
+                {
+                for (long i = 0; i < n; ++i)
+                {
+                    buf.append(data.data(), size);
+                    buf.retrieve(size);
+                    doNotOptimize(buf.peek());
+                } });
+        }
+        const size_t totals[] = {64 * 1024, 1024 * 1024};
+        for (size_t total : totals)
+        {
+            run("buffer/grow", static_cast<long>(total), [&](long n)
+                {
+                for (long i = 0; i < n; ++i)
+                {
+                    Buffer buf;
+                    for (size_t len = 0; len < total; len += 1024)
+                        buf.append(data.data(), 1024);
+                    doNotOptimize(buf.peek());
+                } });
+        }
+
+        const size_t readSizes[] = {512, 4096, 65536};
+        for (size_t size : readSizes)
+        {
+            int fds[2];
+            if (::socketpair(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0, fds) < 0)
+            {
+                perror("socketpair");
+                return;
+            }
+            int sndbuf = 1024 * 1024;
+            ::setsockopt(fds[0], SOL_SOCKET, SO_SNDBUF, &sndbuf, sizeof sndbuf);
+            Buffer buf;
+            run("buffer/readFd", static_cast<long>(size), [&](long n)
+                {
+                int savedErrno = 0;
+                for (long i = 0; i < n; ++i)
+                {
+                    ::write(fds[0], data.data(), size);
+                    size_t got = 0;
+                    while (got < size)
+                    {
+                        ssize_t r = buf.readFd(fds[1], &savedErrno);
+                        if (r <= 0)
+                            break;
+                        got += r;
+                    }
+                    buf.retrieveAll();
+                } });
+            ::close(fds[0]);
+            ::close(fds[1]);
+        }
+    }
+
+    // 不走run()：生产者和loop线程并发执行，按全部任务执行完的时间计算吞吐
+    void benchQueueInLoop()
+    {
+        const char *name = "loop/queueInLoop";
+        if (!selected(name))
+            return;
+        EventLoopThread thread;
+        EventLoop *loop = thread.startLoop();
+        const int producers[] = {1, 2, 4, 8};
+        for (int p : producers)
+        {
+            long perProducer = 1;
+            double seconds = 0;
+            // 和run()一样先试探再放大
+            for (int round = 0; round < 2; ++round)
+            {
+                if (round == 1)
+                    perProducer = static_cast<long>(perProducer * (g_minSeconds / seconds)) + 1;
+                while (true)
+                {
+                    std::atomic<long> remaining(perProducer * p);
+                    std::promise<void> done;
+                    std::future<void> finished = done.get_future();
+                    int64_t start = Timestamp::monotonicNanos();
+                    std::vector<std::thread> threads;
+                    for (int t = 0; t < p; ++t)
+                    {
+                        threads.emplace_back([&]()
+                                             {
+                            for (long i = 0; i < perProducer; ++i)
+                            {
+                                loop->queueInLoop([&]()
+                                                  {
+                                    if (remaining.fetch_sub(1, std::memory_order_relaxed) == 1)
+                                        done.set_value(); });
+                            } });
+                    }
+                    for (std::thread &t : threads)
+                        t.join();
+                    finished.wait();
+                    seconds = (Timestamp::monotonicNanos() - start) / 1e9;
+                    if (round == 1 || seconds >= 0.01)
+                        break;
+                    perProducer *= 2;
+                }
+            }
+            report(name, p, perProducer * p, seconds);
+        }
+    }
+
+    struct ChannelSet
+    {
+        explicit ChannelSet(EventLoop *loop) : loop(loop) {}
+        ~ChannelSet() { resize(0); }
+
+        void resize(size_t n)
+        {
+            while (channels.size() > n)
+            {
+                Channel *ch = channels.back().get();
+                ch->disableAll();
+                ch->remove();
+                ::close(ch->fd());
+                channels.pop_back();
+            }
+            while (channels.size() < n)
+            {
+                int fd = ::eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+                channels.push_back(std::unique_ptr<Channel>(new Channel(loop, fd)));
+                channels.back()->enableReading();
+            }
+        }
+
+        EventLoop *loop;
+        std::vector<std::unique_ptr<Channel>> channels;
+    };
+
+    // loop不运行，直接在构造它的线程里调用updateChannel，只测epoll_ctl和Poller里的查表
+    void benchPoller(EventLoop *loop)
+    {
+        raiseFdLimit();
+        ChannelSet set(loop);
+        const size_t counts[] = {1, 100, 1000, 10000};
+        for (size_t count : counts)
+        {
+            set.resize(count);
+            run("poller/update", static_cast<long>(count), [&](long n)
+                {
+                for (long i = 0; i < n; ++i)
+                {
+                    Channel *ch = set.channels[i % count].get();
+                    if (ch->isWriting())
+                        ch->disableWriting();
+                    else
+                        ch->enableWriting();
+                } });
+            int fd = ::eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+            run("poller/add_remove", static_cast<long>(count), [&](long n)
+                {
+                for (long i = 0; i < n; ++i)
+                {
+                    Channel ch(loop, fd);
+                    ch.enableReading();
+                    ch.disableAll();
+                    ch.remove();
+                } });
+            ::close(fd);
+        }
+    }
+
+    void benchChannel(EventLoop *loop)
+    {
+        int fd = ::eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+        for (int tied = 0; tied <= 1; ++tied)
+        {
+            Channel ch(loop, fd);
+            long calls = 0;
+            ch.setReadCallback([&calls](Timestamp)
+                               { ++calls; });
+            std::shared_ptr<int> owner = std::make_shared<int>(0);
+            if (tied)
+                ch.tie(owner);
+            ch.set_revents(EPOLLIN);
+            Timestamp now = Timestamp::now();
+            run("channel/dispatch", tied, [&](long n)
+                {
+                for (long i = 0; i < n; ++i)
+                    ch.handleEvent(now);
+                doNotOptimize(calls); });
+        }
+        ::close(fd);
+    }
+}
+
+int main(int argc, char *argv[])
+{
+    if (argc > 1)
+        g_filter = argv[1];
+    if (argc > 2)
+        g_minSeconds = atof(argv[2]);
+
+    benchBuffer();
+    benchQueueInLoop();
+    EventLoop loop;
+    benchPoller(&loop);
+    benchChannel(&loop);
+    return 0;
+}
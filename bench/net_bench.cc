@@ -0,0 +1,785 @@
+/**
+ * [网络层基准测试]  进程内启动一个echo TcpServer，再用裸epoll写的多线程压测客户端打本地端口，
+ * 覆盖EventLoop/Buffer/TcpConnection的主要路径。每个场景在stdout输出一行JSON，方便脚本收集和对比：
+ *   pingpong    每个连接一次只有一条消息在路上，统计往返延迟的分位数
+ *   throughput  每个连接保持window字节在路上，统计echo回来的字节数
+ *   idle        建立conns个空闲连接，统计每个连接占用的进程内存(RSS增量)
+ *   churn       短连接：connect、发一条消息、收到echo、close，统计每秒完成的连接数
+ *   bulk        大响应：每个连接发1字节请求，服务端用send(Buffer*)回response字节，收齐再发下一个，
+ *               统计下行MB/s；zerocopy=<阈值>打开TcpServer::setZeroCopy，结果带上MSG_ZEROCOPY的计数
+ *   all         依次跑上面全部场景(不含bulk)
+ *
+ * 用法: ./net_bench <场景> [key=value ...]
+ *   loops=1 threads=1 conns=32 size=64 seconds=5 warmup=1 window=262144 idle_conns=10000 port=9982
+ *   pieces=1 cork=0  服务端把每次收到的数据拆成pieces次send回去，cork=1时打开TcpServer::setAutoCork
+ *   busy_poll=0  io loop忙轮询的预算(微秒)，pingpong结果里带上spin_*指标
+ *   family=inet  inet(127.0.0.1) / inet6(::1) / unix(抽象命名空间@mymuduo-net_bench-<port>)，
+ *                比较同一台机器上Unix域socket和回环TCP的开销
+ *   response=1048576 zerocopy=0  bulk场景的响应大小和MSG_ZEROCOPY阈值(0关闭)
+ *   backlog=1024 defer_accept=0 fastopen=0 nodelay=0  监听socket和每个连接的选项(TcpServer::setListenBacklog等)；
+ *                fastopen>0时客户端也用TCP_FASTOPEN_CONNECT，churn结果带上内核的ListenOverflows/TFO计数
+ *   out=<文件>  结果追加写到文件里，默认写stdout(会和库的INFO日志混在一起)
+ *   10万个idle连接需要足够的fd上限(程序会把soft limit提到hard limit)，
+ *   源地址轮流用127.0.0.x，避开单个源IP的临时端口数限制
+ */
+#include "TcpServer.h"
+#include "EventLoop.h"
+#include "Buffer.h"
+#include "Timestamp.h"
+#include "Logger.h"
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <map>
+#include <string>
+#include <thread>
+#include <vector>
+#include <errno.h>
+#include <fcntl.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <sys/epoll.h>
+#include <sys/resource.h>
+#include <sys/socket.h>
+
+namespace
+{
+    class Options
+    {
+    public:
+        Options(int argc, char *argv[])
+        {
+            for (int i = 2; i < argc; ++i)
+            {
+                const char *eq = strchr(argv[i], '=');
+                if (eq != nullptr)
+                    values_[std::string(argv[i], eq - argv[i])] = eq + 1;
+            }
+        }
+        long get(const char *key, long def) const
+        {
+            std::map<std::string, std::string>::const_iterator it = values_.find(key);
+            return it == values_.end() ? def : atol(it->second.c_str());
+        }
+        std::string getString(const char *key) const
+        {
+            std::map<std::string, std::string>::const_iterator it = values_.find(key);
+            return it == values_.end() ? std::string() : it->second;
+        }
+
+    private:
+        std::map<std::string, std::string> values_;
+    };
+
+    struct Config
+    {
+        int loops;
+        int threads;
+        int conns;
+        int idleConns;
+        size_t size;
+        int seconds;
+        int warmup;
+        size_t window;
+        uint16_t port;
+        int pieces;
+        bool cork;
+        int busyPollUs;
+        std::string family;
+        InetAddress server;
+        size_t response;
+        size_t zerocopy;
+        int backlog;
+        int deferAccept;
+        int fastOpen;
+        bool noDelay;
+    };
+
+    // /proc/net/netstat里TcpExt的一个计数，读不到时返回0
+    long tcpExtCounter(const char *name)
+    {
+        FILE *f = ::fopen("/proc/net/netstat", "r");
+        if (f == nullptr)
+            return 0;
+        char names[8192];
+        char values[8192];
+        long result = 0;
+        while (::fgets(names, sizeof names, f) != nullptr && ::fgets(values, sizeof values, f) != nullptr)
+        {
+            if (strncmp(names, "TcpExt:", 7) != 0)
+                continue;
+            char *nameSave = nullptr;
+            char *valueSave = nullptr;
+            char *n = strtok_r(names, " \n", &nameSave);
+            char *v = strtok_r(values, " \n", &valueSave);
+            while (n != nullptr && v != nullptr)
+            {
+                if (strcmp(n, name) == 0)
+                    result = atol(v);
+                n = strtok_r(nullptr, " \n", &nameSave);
+                v = strtok_r(nullptr, " \n", &valueSave);
+            }
+        }
+        ::fclose(f);
+        return result;
+    }
+
+    // [bulk场景服务端的MSG_ZEROCOPY计数]  连接关闭时在它的loop线程里累加
+    std::atomic<uint64_t> g_zcSends(0);
+    std::atomic<uint64_t> g_zcCompletions(0);
+    std::atomic<uint64_t> g_zcCopied(0);
+
+    // srcIp只对IPv4有效
+    int connectTo(const Config &cfg, uint32_t srcIp)
+    {
+        int fd = ::socket(cfg.server.family(), SOCK_STREAM | SOCK_CLOEXEC, 0);
+        if (fd < 0)
+            return -1;
+        if (srcIp != INADDR_LOOPBACK && cfg.server.family() == AF_INET)
+        {
+            sockaddr_in src;
+            memset(&src, 0, sizeof src);
+            src.sin_family = AF_INET;
+            src.sin_addr.s_addr = htonl(srcIp);
+            if (::bind(fd, reinterpret_cast<sockaddr *>(&src), sizeof src) < 0)
+            {
+                ::close(fd);
+                return -1;
+            }
+        }
+        if (cfg.fastOpen > 0 && !cfg.server.isUnix())
+        {
+            // connect马上返回，第一次write的数据放进SYN(有cookie以后)
+            int one = 1;
+            ::setsockopt(fd, IPPROTO_TCP, TCP_FASTOPEN_CONNECT, &one, sizeof one);
+        }
+        if (::connect(fd, cfg.server.getSockAddr(), cfg.server.getSockLen()) < 0)
+        {
+            ::close(fd);
+            return -1;
+        }
+        if (!cfg.server.isUnix())
+        {
+            int one = 1;
+            ::setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &one, sizeof one);
+        }
+        return fd;
+    }
+
+    void setNonBlocking(int fd)
+    {
+        ::fcntl(fd, F_SETFL, ::fcntl(fd, F_GETFL) | O_NONBLOCK);
+    }
+
+    // 非阻塞fd上遇到EAGAIN就原地重试，只用来发小消息
+    bool writeAll(int fd, const char *data, size_t len)
+    {
+        while (len > 0)
+        {
+            ssize_t n = ::write(fd, data, len);
+            if (n < 0 && errno == EAGAIN)
+                continue;
+            if (n <= 0)
+                return false;
+            data += n;
+            len -= n;
+        }
+        return true;
+    }
+
+    long rssKb()
+    {
+        FILE *fp = ::fopen("/proc/self/status", "r");
+        if (fp == nullptr)
+            return -1;
+        char line[256];
+        long kb = -1;
+        while (::fgets(line, sizeof line, fp) != nullptr)
+        {
+            if (::sscanf(line, "VmRSS: %ld kB", &kb) == 1)
+                break;
+        }
+        ::fclose(fp);
+        return kb;
+    }
+
+    // [延迟样本]  每个线程各自收集纳秒样本，结束后合并排序取精确分位数
+    struct Latencies
+    {
+        std::vector<int64_t> samples;
+
+        void merge(const Latencies &other)
+        {
+            samples.insert(samples.end(), other.samples.begin(), other.samples.end());
+        }
+        // 排序后调用，返回微秒
+        double percentile(double p) const
+        {
+            if (samples.empty())
+                return 0;
+            size_t idx = static_cast<size_t>(p * (samples.size() - 1) + 0.5);
+            return samples[idx] / 1000.0;
+        }
+        std::string toJson()
+        {
+            std::sort(samples.begin(), samples.end());
+            char buf[256];
+            snprintf(buf, sizeof buf,
+                     "\"p50_us\":%.1f,\"p90_us\":%.1f,\"p99_us\":%.1f,\"p999_us\":%.1f,\"max_us\":%.1f",
+                     percentile(0.5), percentile(0.9), percentile(0.99), percentile(0.999),
+                     samples.empty() ? 0.0 : samples.back() / 1000.0);
+            return buf;
+        }
+    };
+
+    struct ClientConn
+    {
+        int fd;
+        size_t sent;
+        size_t received;
+        int64_t sendTime;
+        bool wantWrite;
+    };
+
+    std::vector<ClientConn> openClients(const Config &cfg, int epfd, uint32_t events)
+    {
+        std::vector<ClientConn> clients(cfg.conns);
+        for (ClientConn &c : clients)
+        {
+            c.fd = connectTo(cfg, INADDR_LOOPBACK);
+            if (c.fd < 0)
+            {
+                perror("connect");
+                ::exit(1);
+            }
+            setNonBlocking(c.fd);
+            c.sent = c.received = 0;
+            c.sendTime = 0;
+            c.wantWrite = false;
+            epoll_event ev;
+            ev.events = events;
+            ev.data.ptr = &c;
+            ::epoll_ctl(epfd, EPOLL_CTL_ADD, c.fd, &ev);
+        }
+        return clients;
+    }
+
+    // [pingpong客户端线程]  收齐size字节的echo算一次往返，马上发下一条
+    void pingpongThread(const Config &cfg, int64_t measureStart, int64_t deadline,
+                        Latencies *lat, long *rounds)
+    {
+        int epfd = ::epoll_create1(EPOLL_CLOEXEC);
+        std::vector<ClientConn> clients = openClients(cfg, epfd, EPOLLIN);
+        std::string msg(cfg.size, 'x');
+        std::vector<char> buf(std::max<size_t>(cfg.size, 65536));
+        for (ClientConn &c : clients)
+        {
+            c.sendTime = Timestamp::monotonicNanos();
+            writeAll(c.fd, msg.data(), msg.size());
+        }
+        std::vector<epoll_event> events(cfg.conns);
+        long n = 0;
+        while (true)
+        {
+            int64_t now = Timestamp::monotonicNanos();
+            if (now >= deadline)
+                break;
+            int ready = ::epoll_wait(epfd, events.data(), cfg.conns, 10);
+            for (int i = 0; i < ready; ++i)
+            {
+                ClientConn *c = static_cast<ClientConn *>(events[i].data.ptr);
+                ssize_t r = ::read(c->fd, buf.data(), buf.size());
+                if (r <= 0)
+                    continue;
+                c->received += r;
+                if (c->received < cfg.size)
+                    continue;
+                int64_t done = Timestamp::monotonicNanos();
+                if (c->sendTime >= measureStart)
+                {
+                    lat->samples.push_back(done - c->sendTime);
+                    ++n;
+                }
+                c->received = 0;
+                c->sendTime = done;
+                writeAll(c->fd, msg.data(), msg.size());
+            }
+        }
+        *rounds = n;
+        for (ClientConn &c : clients)
+            ::close(c.fd);
+        ::close(epfd);
+    }
+
+    // [throughput客户端线程]  每个连接保持最多window字节在路上，发送被阻塞时才关心EPOLLOUT
+    void throughputThread(const Config &cfg, int64_t measureStart, int64_t deadline, long *bytes)
+    {
+        int epfd = ::epoll_create1(EPOLL_CLOEXEC);
+        std::vector<ClientConn> clients = openClients(cfg, epfd, EPOLLIN);
+        std::string block(std::min<size_t>(cfg.window, std::max<size_t>(cfg.size, 16384)), 'x');
+        std::vector<char> buf(65536);
+        long counted = 0;
+
+        auto pump = [&](ClientConn *c)
+        {
+            while (c->sent - c->received < cfg.window)
+            {
+                size_t len = std::min(block.size(), cfg.window - (c->sent - c->received));
+                ssize_t n = ::write(c->fd, block.data(), len);
+                if (n < 0)
+                {
+                    if (errno == EAGAIN && !c->wantWrite)
+                    {
+                        c->wantWrite = true;
+                        epoll_event ev;
+                        ev.events = EPOLLIN | EPOLLOUT;
+                        ev.data.ptr = c;
+                        ::epoll_ctl(epfd, EPOLL_CTL_MOD, c->fd, &ev);
+                    }
+                    return;
+                }
+                c->sent += n;
+            }
+            if (c->wantWrite)
+            {
+                c->wantWrite = false;
+                epoll_event ev;
+                ev.events = EPOLLIN;
+                ev.data.ptr = c;
+                ::epoll_ctl(epfd, EPOLL_CTL_MOD, c->fd, &ev);
+            }
+        };
+
+        for (ClientConn &c : clients)
+            pump(&c);
+        std::vector<epoll_event> events(cfg.conns);
+        while (true)
+        {
+            int64_t now = Timestamp::monotonicNanos();
+            if (now >= deadline)
+                break;
+            int ready = ::epoll_wait(epfd, events.data(), cfg.conns, 10);
+            bool measuring = Timestamp::monotonicNanos() >= measureStart;
+            for (int i = 0; i < ready; ++i)
+            {
+                ClientConn *c = static_cast<ClientConn *>(events[i].data.ptr);
+                if (events[i].events & EPOLLIN)
+                {
+                    ssize_t r = ::read(c->fd, buf.data(), buf.size());
+                    if (r > 0)
+                    {
+                        c->received += r;
+                        if (measuring)
+                            counted += r;
+                    }
+                }
+                pump(c);
+            }
+        }
+        *bytes = counted;
+        for (ClientConn &c : clients)
+            ::close(c.fd);
+        ::close(epfd);
+    }
+
+    // [bulk客户端线程]  每个连接一次一个请求，收齐response字节再发下一个
+    void bulkThread(const Config &cfg, int64_t measureStart, int64_t deadline, long *bytes)
+    {
+        int epfd = ::epoll_create1(EPOLL_CLOEXEC);
+        std::vector<ClientConn> clients = openClients(cfg, epfd, EPOLLIN);
+        std::vector<char> buf(256 * 1024);
+        for (ClientConn &c : clients)
+            writeAll(c.fd, "b", 1);
+        std::vector<epoll_event> events(cfg.conns);
+        long counted = 0;
+        while (true)
+        {
+            int64_t now = Timestamp::monotonicNanos();
+            if (now >= deadline)
+                break;
+            int ready = ::epoll_wait(epfd, events.data(), cfg.conns, 10);
+            bool measuring = Timestamp::monotonicNanos() >= measureStart;
+            for (int i = 0; i < ready; ++i)
+            {
+                ClientConn *c = static_cast<ClientConn *>(events[i].data.ptr);
+                ssize_t r = ::read(c->fd, buf.data(), buf.size());
+                if (r <= 0)
+                    continue;
+                c->received += r;
+                if (measuring)
+                    counted += r;
+                if (c->received >= cfg.response)
+                {
+                    c->received -= cfg.response;
+                    writeAll(c->fd, "b", 1);
+                }
+            }
+        }
+        *bytes = counted;
+        for (ClientConn &c : clients)
+            ::close(c.fd);
+        ::close(epfd);
+    }
+
+    // [churn客户端线程]  阻塞socket，一个连接走完 connect -> 发送 -> 收齐echo -> close
+    void churnThread(const Config &cfg, int64_t measureStart, int64_t deadline,
+                     Latencies *lat, long *completed, long *failed)
+    {
+        std::string msg(cfg.size, 'x');
+        std::vector<char> buf(std::max<size_t>(cfg.size, 4096));
+        long ok = 0;
+        long bad = 0;
+        while (true)
+        {
+            int64_t start = Timestamp::monotonicNanos();
+            if (start >= deadline)
+                break;
+            int fd = connectTo(cfg, INADDR_LOOPBACK);
+            bool success = fd >= 0 && writeAll(fd, msg.data(), msg.size());
+            size_t received = 0;
+            while (success && received < cfg.size)
+            {
+                ssize_t r = ::read(fd, buf.data(), buf.size());
+                if (r <= 0)
+                    success = false;
+                else
+                    received += r;
+            }
+            if (fd >= 0)
+                ::close(fd);
+            if (start < measureStart)
+                continue;
+            if (success)
+            {
+                lat->samples.push_back(Timestamp::monotonicNanos() - start);
+                ++ok;
+            }
+            else
+            {
+                ++bad;
+            }
+        }
+        *completed = ok;
+        *failed = bad;
+    }
+
+    class Bench
+    {
+    public:
+        Bench(TcpServer *server, const Config &cfg, FILE *out)
+            : server_(server), cfg_(cfg), out_(out) {}
+
+        void run(const std::string &scenario)
+        {
+            if (scenario == "pingpong" || scenario == "all")
+                pingpong();
+            if (scenario == "throughput" || scenario == "all")
+                throughput();
+            if (scenario == "idle" || scenario == "all")
+                idle();
+            if (scenario == "churn" || scenario == "all")
+                churn();
+            if (scenario == "bulk")
+                bulk();
+        }
+
+    private:
+        int64_t measureStart() const
+        {
+            return Timestamp::monotonicNanos() + static_cast<int64_t>(cfg_.warmup) * 1000000000;
+        }
+        int64_t deadline(int64_t start) const
+        {
+            return start + static_cast<int64_t>(cfg_.seconds) * 1000000000;
+        }
+
+        void pingpong()
+        {
+            int64_t start = measureStart();
+            LoopMetricsSnapshot before = server_->threadPool()->metrics();
+            std::vector<Latencies> lats(cfg_.threads);
+            std::vector<long> rounds(cfg_.threads);
+            std::vector<std::thread> threads;
+            for (int i = 0; i < cfg_.threads; ++i)
+                threads.emplace_back(pingpongThread, std::cref(cfg_), start, deadline(start), &lats[i], &rounds[i]);
+            Latencies all;
+            long total = 0;
+            for (int i = 0; i < cfg_.threads; ++i)
+            {
+                threads[i].join();
+                all.merge(lats[i]);
+                total += rounds[i];
+            }
+            // 包括warmup，只用来看忙轮询的命中率和空转成本
+            LoopMetricsSnapshot after = server_->threadPool()->metrics();
+            fprintf(out_, "{\"bench\":\"pingpong\",\"family\":\"%s\",\"loops\":%d,\"threads\":%d,\"conns\":%d,\"size\":%zu,\"seconds\":%d,"
+                   "\"pieces\":%d,\"cork\":%d,\"busy_poll\":%d,\"rounds\":%ld,\"rps\":%.0f,%s,"
+                   "\"spin_polls\":%llu,\"spin_hits\":%llu,\"spin_idle_ms\":%.1f}\n",
+                   cfg_.family.c_str(), cfg_.loops, cfg_.threads, cfg_.conns * cfg_.threads, cfg_.size, cfg_.seconds,
+                   cfg_.pieces, cfg_.cork ? 1 : 0, cfg_.busyPollUs,
+                   total, static_cast<double>(total) / cfg_.seconds, all.toJson().c_str(),
+                   static_cast<unsigned long long>(after.spinPolls - before.spinPolls),
+                   static_cast<unsigned long long>(after.spinHits - before.spinHits),
+                   (after.spinIdleUs - before.spinIdleUs) / 1000.0);
+            fflush(out_);
+        }
+
+        void throughput()
+        {
+            int64_t start = measureStart();
+            std::vector<long> bytes(cfg_.threads);
+            std::vector<std::thread> threads;
+            for (int i = 0; i < cfg_.threads; ++i)
+                threads.emplace_back(throughputThread, std::cref(cfg_), start, deadline(start), &bytes[i]);
+            long total = 0;
+            for (int i = 0; i < cfg_.threads; ++i)
+            {
+                threads[i].join();
+                total += bytes[i];
+            }
+            double mbps = static_cast<double>(total) / cfg_.seconds / (1024 * 1024);
+            fprintf(out_, "{\"bench\":\"throughput\",\"family\":\"%s\",\"loops\":%d,\"threads\":%d,\"conns\":%d,\"window\":%zu,\"seconds\":%d,"
+                   "\"bytes\":%ld,\"mib_per_s\":%.1f}\n",
+                   cfg_.family.c_str(), cfg_.loops, cfg_.threads, cfg_.conns * cfg_.threads, cfg_.window, cfg_.seconds, total, mbps);
+            fflush(out_);
+        }
+
+        void idle()
+        {
+            int target = cfg_.idleConns;
+            rlimit rl;
+            ::getrlimit(RLIMIT_NOFILE, &rl);
+            rl.rlim_cur = rl.rlim_max;
+            ::setrlimit(RLIMIT_NOFILE, &rl);
+            // 客户端和服务端的fd都在这个进程里
+            long maxConns = (static_cast<long>(rl.rlim_cur) - 64) / 2;
+            if (target > maxConns)
+            {
+                fprintf(stderr, "idle: fd limit %ld only allows %ld connections\n",
+                        static_cast<long>(rl.rlim_cur), maxConns);
+                target = static_cast<int>(maxConns);
+            }
+
+            waitForConnections(0);
+            long before = rssKb();
+            std::vector<int> fds;
+            fds.reserve(target);
+            int64_t connectStart = Timestamp::monotonicNanos();
+            for (int i = 0; i < target; ++i)
+            {
+                // 每个源IP最多用2万个临时端口
+                uint32_t src = INADDR_LOOPBACK + static_cast<uint32_t>(i / 20000);
+                int fd = connectTo(cfg_, src);
+                if (fd < 0)
+                {
+                    fprintf(stderr, "idle: connect #%d failed: %s\n", i, strerror(errno));
+                    break;
+                }
+                fds.push_back(fd);
+            }
+            int opened = static_cast<int>(fds.size());
+            waitForConnections(static_cast<size_t>(opened));
+            double connectSeconds = (Timestamp::monotonicNanos() - connectStart) / 1e9;
+            long after = rssKb();
+            for (int fd : fds)
+                ::close(fd);
+            waitForConnections(0);
+            fprintf(out_, "{\"bench\":\"idle\",\"family\":\"%s\",\"loops\":%d,\"conns\":%d,\"connect_per_s\":%.0f,"
+                   "\"rss_before_kb\":%ld,\"rss_after_kb\":%ld,\"bytes_per_conn\":%.0f}\n",
+                   cfg_.family.c_str(), cfg_.loops, opened, opened / connectSeconds, before, after,
+                   opened == 0 ? 0.0 : (after - before) * 1024.0 / opened);
+            fflush(out_);
+        }
+
+        void churn()
+        {
+            int64_t start = measureStart();
+            long overflowsBefore = tcpExtCounter("ListenOverflows");
+            long tfoBefore = tcpExtCounter("TCPFastOpenPassive");
+            std::vector<Latencies> lats(cfg_.threads);
+            std::vector<long> completed(cfg_.threads);
+            std::vector<long> failed(cfg_.threads);
+            std::vector<std::thread> threads;
+            for (int i = 0; i < cfg_.threads; ++i)
+                threads.emplace_back(churnThread, std::cref(cfg_), start, deadline(start),
+                                     &lats[i], &completed[i], &failed[i]);
+            Latencies all;
+            long ok = 0;
+            long bad = 0;
+            for (int i = 0; i < cfg_.threads; ++i)
+            {
+                threads[i].join();
+                all.merge(lats[i]);
+                ok += completed[i];
+                bad += failed[i];
+            }
+            // 包括warmup；计数是整个网络命名空间的
+            long overflows = tcpExtCounter("ListenOverflows") - overflowsBefore;
+            long tfo = tcpExtCounter("TCPFastOpenPassive") - tfoBefore;
+            fprintf(out_, "{\"bench\":\"churn\",\"family\":\"%s\",\"loops\":%d,\"threads\":%d,\"size\":%zu,\"seconds\":%d,"
+                   "\"backlog\":%d,\"defer_accept\":%d,\"fastopen\":%d,\"nodelay\":%d,"
+                   "\"conns\":%ld,\"failed\":%ld,\"conns_per_s\":%.0f,%s,\"listen_overflows\":%ld,\"tfo_passive\":%ld}\n",
+                   cfg_.family.c_str(), cfg_.loops, cfg_.threads, cfg_.size, cfg_.seconds,
+                   cfg_.backlog, cfg_.deferAccept, cfg_.fastOpen, cfg_.noDelay ? 1 : 0, ok, bad,
+                   static_cast<double>(ok) / cfg_.seconds, all.toJson().c_str(), overflows, tfo);
+            fflush(out_);
+        }
+
+        void bulk()
+        {
+            int64_t start = measureStart();
+            std::vector<long> bytes(cfg_.threads);
+            std::vector<std::thread> threads;
+            for (int i = 0; i < cfg_.threads; ++i)
+                threads.emplace_back(bulkThread, std::cref(cfg_), start, deadline(start), &bytes[i]);
+            long total = 0;
+            for (int i = 0; i < cfg_.threads; ++i)
+            {
+                threads[i].join();
+                total += bytes[i];
+            }
+            waitForConnections(0); // 计数在连接关闭时累加
+            double mbps = static_cast<double>(total) / cfg_.seconds / (1024 * 1024);
+            fprintf(out_, "{\"bench\":\"bulk\",\"family\":\"%s\",\"loops\":%d,\"threads\":%d,\"conns\":%d,\"response\":%zu,"
+                   "\"zerocopy\":%zu,\"seconds\":%d,\"bytes\":%ld,\"mib_per_s\":%.1f,"
+                   "\"zc_sends\":%llu,\"zc_completions\":%llu,\"zc_copied\":%llu}\n",
+                   cfg_.family.c_str(), cfg_.loops, cfg_.threads, cfg_.conns * cfg_.threads, cfg_.response,
+                   cfg_.zerocopy, cfg_.seconds, total, mbps,
+                   static_cast<unsigned long long>(g_zcSends.load()),
+                   static_cast<unsigned long long>(g_zcCompletions.load()),
+                   static_cast<unsigned long long>(g_zcCopied.load()));
+            fflush(out_);
+        }
+
+        // 等服务端的连接数变成n
+        void waitForConnections(size_t n)
+        {
+            for (int i = 0; i < 3000; ++i)
+            {
+                if (server_->numConnections() == n)
+                    return;
+                std::this_thread::sleep_for(std::chrono::milliseconds(10));
+            }
+            fprintf(stderr, "timeout waiting for %zu connections\n", n);
+        }
+
+        TcpServer *server_;
+        Config cfg_;
+        FILE *out_;
+    };
+}
+
+int main(int argc, char *argv[])
+{
+    if (argc < 2)
+    {
+        fprintf(stderr, "usage: %s pingpong|throughput|idle|churn|bulk|all [key=value ...]\n", argv[0]);
+        return 1;
+    }
+    std::string scenario = argv[1];
+    Options opts(argc, argv);
+    Config cfg;
+    cfg.loops = static_cast<int>(opts.get("loops", 1));
+    cfg.threads = static_cast<int>(opts.get("threads", 1));
+    cfg.conns = static_cast<int>(opts.get("conns", 32));
+    cfg.idleConns = static_cast<int>(opts.get("idle_conns", 10000));
+    cfg.size = static_cast<size_t>(opts.get("size", 64));
+    cfg.seconds = static_cast<int>(opts.get("seconds", 5));
+    cfg.warmup = static_cast<int>(opts.get("warmup", 1));
+    cfg.window = static_cast<size_t>(opts.get("window", 256 * 1024));
+    cfg.port = static_cast<uint16_t>(opts.get("port", 9982));
+    cfg.pieces = std::max(1, static_cast<int>(opts.get("pieces", 1)));
+    cfg.cork = opts.get("cork", 0) != 0;
+    cfg.busyPollUs = static_cast<int>(opts.get("busy_poll", 0));
+    cfg.response = std::max<size_t>(1, static_cast<size_t>(opts.get("response", 1024 * 1024)));
+    cfg.zerocopy = static_cast<size_t>(opts.get("zerocopy", 0));
+    cfg.backlog = static_cast<int>(opts.get("backlog", 1024));
+    cfg.deferAccept = static_cast<int>(opts.get("defer_accept", 0));
+    cfg.fastOpen = static_cast<int>(opts.get("fastopen", 0));
+    cfg.noDelay = opts.get("nodelay", 0) != 0;
+    cfg.family = opts.getString("family");
+    if (cfg.family == "inet6")
+        cfg.server = InetAddress(cfg.port, "::1");
+    else if (cfg.family == "unix")
+        cfg.server = InetAddress::fromUnixPath("@mymuduo-net_bench-" + std::to_string(cfg.port));
+    else
+    {
+        cfg.family = "inet";
+        cfg.server = InetAddress(cfg.port);
+    }
+
+    std::string outPath = opts.getString("out");
+    FILE *out = outPath.empty() ? stdout : ::fopen(outPath.c_str(), "a");
+    if (out == nullptr)
+    {
+        perror("fopen");
+        return 1;
+    }
+
+    EventLoop loop;
+    TcpServer server(&loop, cfg.server, "net_bench");
+    server.setConnectionCallback([](const TcpConnectionPtr &conn)
+                                 {
+        const ZeroCopyQueue *zc = conn->zeroCopy();
+        if (!conn->connected() && zc != nullptr)
+        {
+            g_zcSends += zc->zerocopySends();
+            g_zcCompletions += zc->completions();
+            g_zcCopied += zc->copiedCompletions();
+        } });
+    const int pieces = cfg.pieces;
+    const bool bulk = scenario == "bulk";
+    const std::string body(cfg.response, 'y');
+    server.setMessageCallback([pieces, bulk, &body](const TcpConnectionPtr &conn, Buffer *buf, Timestamp)
+                              {
+        if (bulk)
+        {
+            // 每个请求字节回一个response大小的响应，每次都重新生成到Buffer里
+            static thread_local Buffer response;
+            size_t requests = buf->readableBytes();
+            buf->retrieveAll();
+            for (size_t i = 0; i < requests; ++i)
+            {
+                response.append(body.data(), body.size());
+                conn->send(&response);
+            }
+            return;
+        }
+        // 模拟响应头、正文、尾分几次send
+        size_t piece = buf->readableBytes() / pieces;
+        for (int i = 1; i < pieces && piece > 0; ++i)
+        {
+            conn->send(buf->peek(), piece);
+            buf->retrieve(piece);
+        }
+        conn->send(buf); });
+    server.setAutoCork(cfg.cork);
+    server.setBusyPoll(cfg.busyPollUs);
+    server.setZeroCopy(cfg.zerocopy);
+    server.setListenBacklog(cfg.backlog);
+    server.setDeferAccept(cfg.deferAccept);
+    server.setFastOpen(cfg.fastOpen);
+    server.setTcpNoDelay(cfg.noDelay);
+    server.setThreadNum(cfg.loops);
+    server.start();
+
+    Bench bench(&server, cfg, out);
+    std::thread driver([&]()
+                       {
+        // 等base loop开始监听
+        std::this_thread::sleep_for(std::chrono::milliseconds(200));
+        bench.run(scenario);
+        loop.quit(); });
+
+    loop.loop();
+    driver.join();
+    if (out != stdout)
+        ::fclose(out);
+    return 0;
+}
@@ -0,0 +1,137 @@
+/**
+ * [跨loop消息传递压测]  每个loop向其他loop发请求，对方处理完把回复送回来，
+ * 对比 ShardRouter::call(SPSC队列) 和 runInLoop(mutex + std::function + eventfd)。
+ * 每个loop保持window个请求在路上，一共跑rounds个请求。
+ * 输出:  router_bench <实现> loops=.. msgs=.. seconds=.. msgs/s=..
+ *
+ * 用法: ./router_bench [loop数=4] [每个loop的请求数=200000] [窗口=64]
+ */
+#include "ShardRouter.h"
+#include "EventLoop.h"
+#include "EventLoopThreadPool.h"
+
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <mutex>
+#include <stdio.h>
+#include <stdlib.h>
+
+namespace
+{
+    struct Driver
+    {
+        EventLoopThreadPool *pool;
+        ShardRouter *router; // nullptr表示用runInLoop
+        std::vector<EventLoop *> loops;
+        long perLoop;
+        int window;
+        std::vector<long> sent;
+        std::vector<long> received;
+        std::atomic<int> finished;
+        std::mutex mutex;
+        std::condition_variable cond;
+    };
+
+    void sendOne(Driver *d, size_t from);
+
+    void onReply(Driver *d, size_t from, long value)
+    {
+        (void)value;
+        if (++d->received[from] == d->perLoop)
+        {
+            if (++d->finished == static_cast<int>(d->loops.size()))
+            {
+                std::lock_guard<std::mutex> lock(d->mutex);
+                d->cond.notify_one();
+            }
+            return;
+        }
+        if (d->sent[from] < d->perLoop)
+        {
+            sendOne(d, from);
+        }
+    }
+
+    void sendOne(Driver *d, size_t from)
+    {
+        size_t n = d->loops.size();
+        size_t to = (from + 1 + d->sent[from] % (n - 1)) % n;
+        long value = d->sent[from]++;
+        if (d->router != nullptr)
+        {
+            d->router->call(to, [value]()
+                            { return value + 1; },
+                            [d, from](long result)
+                            { onReply(d, from, result); });
+        }
+        else
+        {
+            EventLoop *back = d->loops[from];
+            d->loops[to]->runInLoop([d, from, back, value]()
+                                    {
+                long result = value + 1;
+                back->runInLoop([d, from, result]()
+                                { onReply(d, from, result); }); });
+        }
+    }
+
+    double run(EventLoopThreadPool *pool, ShardRouter *router, long perLoop, int window)
+    {
+        Driver d;
+        d.pool = pool;
+        d.router = router;
+        d.loops = pool->getAllLoops();
+        d.perLoop = perLoop;
+        d.window = window;
+        d.sent.assign(d.loops.size(), 0);
+        d.received.assign(d.loops.size(), 0);
+        d.finished = 0;
+
+        auto start = std::chrono::steady_clock::now();
+        for (size_t i = 0; i < d.loops.size(); ++i)
+        {
+            Driver *dp = &d;
+            d.loops[i]->runInLoop([dp, i]()
+                                  {
+                for (int k = 0; k < dp->window && dp->sent[i] < dp->perLoop; ++k)
+                    sendOne(dp, i); });
+        }
+        std::unique_lock<std::mutex> lock(d.mutex);
+        d.cond.wait(lock, [&d]()
+                    { return d.finished == static_cast<int>(d.loops.size()); });
+        return std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    }
+}
+
+int main(int argc, char *argv[])
+{
+    int loops = argc > 1 ? atoi(argv[1]) : 4;
+    long perLoop = argc > 2 ? atol(argv[2]) : 200000;
+    int window = argc > 3 ? atoi(argv[3]) : 64;
+    if (loops < 2)
+    {
+        fprintf(stderr, "need at least 2 loops\n");
+        return 1;
+    }
+
+    EventLoop base;
+    EventLoopThreadPool pool(&base, "router");
+    pool.setThreadNum(loops);
+    pool.start();
+
+    double seconds = run(&pool, nullptr, perLoop, window);
+    long msgs = perLoop * loops * 2; // 请求+回复
+    printf("router_bench runInLoop  loops=%d msgs=%ld seconds=%.3f msgs/s=%.0f\n",
+           loops, msgs, seconds, msgs / seconds);
+
+    {
+        ShardRouter router(&pool);
+        seconds = run(&pool, &router, perLoop, window);
+        printf("router_bench ShardRouter loops=%d msgs=%ld seconds=%.3f msgs/s=%.0f ring=%llu overflow=%llu\n",
+               loops, msgs, seconds, msgs / seconds,
+               static_cast<unsigned long long>(router.ringPushes()),
+               static_cast<unsigned long long>(router.overflowPushes()));
+    }
+    return 0;
+}
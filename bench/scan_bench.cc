@@ -0,0 +1,224 @@
+/**
+ * [Buffer分隔符扫描的微基准]
+ * 对比 memchr / std::search / simd::findDelim(scalar、sse2、avx2) 以及字符类扫描，
+ * 输出一行一个结果：  scan <场景> <实现> <MB/s>，方便脚本收集对比
+ *
+ * 用法: ./scan_bench [总扫描字节数MB, 默认512]
+ */
+#include "SimdScan.h"
+#include "Buffer.h"
+
+#include <algorithm>
+#include <chrono>
+#include <functional>
+#include <random>
+#include <string>
+#include <vector>
+#include <stdio.h>
+#include <stdlib.h>
+
+static double nowSeconds()
+{
+    return std::chrono::duration<double>(
+               std::chrono::steady_clock::now().time_since_epoch())
+        .count();
+}
+
+// 生成类似HTTP头部的文本：每行 "Name: value\r\n"，长度随机
+static std::string makeHeaders(size_t total, unsigned seed)
+{
+    std::mt19937 rng(seed);
+    std::string s;
+    s.reserve(total + 128);
+    while (s.size() < total)
+    {
+        int nameLen = 4 + rng() % 16;
+        int valueLen = 8 + rng() % 64;
+        for (int i = 0; i < nameLen; ++i)
+            s.push_back('A' + rng() % 26);
+        s.append(": ");
+        for (int i = 0; i < valueLen; ++i)
+            s.push_back('a' + rng() % 26);
+        s.append("\r\n");
+    }
+    return s;
+}
+
+// 生成一个很长、只有末尾才有分隔符的body(大的RESP bulk string之类)
+static std::string makeLongLine(size_t total, unsigned seed)
+{
+    std::mt19937 rng(seed);
+    std::string s(total, 'x');
+    for (size_t i = 0; i < total; ++i)
+        s[i] = 'a' + rng() % 26;
+    s.append("\r\n");
+    return s;
+}
+
+using ScanFunc = std::function<const char *(const char *, const char *)>;
+
+// 反复扫描data直到处理了totalBytes字节，返回MB/s；同时返回命中次数防止被优化掉
+static double run(const std::string &data, size_t totalBytes, const ScanFunc &scan, size_t *hits)
+{
+    const char *begin = data.data();
+    const char *end = begin + data.size();
+    size_t scanned = 0;
+    size_t found = 0;
+    double start = nowSeconds();
+    while (scanned < totalBytes)
+    {
+        const char *p = begin;
+        while (p < end)
+        {
+            const char *hit = scan(p, end);
+            if (hit == nullptr)
+                break;
+            ++found;
+            p = hit + 1;
+        }
+        scanned += data.size();
+    }
+    double elapsed = nowSeconds() - start;
+    *hits = found;
+    return scanned / elapsed / (1024.0 * 1024.0);
+}
+
+static void report(const char *scenario, const char *impl, double mbps, size_t hits)
+{
+    printf("scan %-12s %-14s %10.1f MB/s  (hits=%zu)\n", scenario, impl, mbps, hits);
+}
+
+static void benchScenario(const char *scenario, const std::string &data, size_t totalBytes)
+{
+    static const char kCRLF[] = "\r\n";
+    size_t hits = 0;
+
+    // 基线1：memchr找'\r'再检查下一个字节
+    double mbps = run(data, totalBytes, [](const char *b, const char *e) -> const char * {
+        while (b < e)
+        {
+            const char *p = static_cast<const char *>(memchr(b, '\r', e - b));
+            if (p == nullptr || p + 1 >= e)
+                return nullptr;
+            if (p[1] == '\n')
+                return p;
+            b = p + 1;
+        }
+        return nullptr;
+    }, &hits);
+    report(scenario, "memchr", mbps, hits);
+
+    // 基线2：std::search(muduo原版的findCRLF就是这么写的)
+    mbps = run(data, totalBytes, [](const char *b, const char *e) -> const char * {
+        const char *p = std::search(b, e, kCRLF, kCRLF + 2);
+        return p == e ? nullptr : p;
+    }, &hits);
+    report(scenario, "std::search", mbps, hits);
+
+    static const char kEnd[] = "\r\n\r\n";
+    mbps = run(data, totalBytes, [](const char *b, const char *e) -> const char * {
+        const char *p = std::search(b, e, kEnd, kEnd + 4);
+        return p == e ? nullptr : p;
+    }, &hits);
+    report(scenario, "std::search4", mbps, hits);
+
+    // simd::findDelim 的各个级别
+    const simd::Level levels[] = {simd::kScalar, simd::kSse2, simd::kAvx2};
+    for (simd::Level level : levels)
+    {
+        if (simd::setLevel(level) != level)
+            continue; // CPU不支持
+        mbps = run(data, totalBytes, [](const char *b, const char *e) {
+            return simd::findDelim(b, e, kCRLF, 2);
+        }, &hits);
+        std::string name = std::string("findDelim/") + simd::levelName(level);
+        report(scenario, name.c_str(), mbps, hits);
+
+        // HTTP头部结束标记，首字节'\r'在每一行都会出现
+        mbps = run(data, totalBytes, [](const char *b, const char *e) {
+            return simd::findDelim(b, e, "\r\n\r\n", 4);
+        }, &hits);
+        name = std::string("findDelim4/") + simd::levelName(level);
+        report(scenario, name.c_str(), mbps, hits);
+
+        // 字符类扫描：找头部里的 ':' 或 '\r'
+        simd::CharClass cc(":\r");
+        mbps = run(data, totalBytes, [&cc](const char *b, const char *e) {
+            return simd::findFirstOf(b, e, cc);
+        }, &hits);
+        name = std::string("findFirstOf/") + simd::levelName(level);
+        report(scenario, name.c_str(), mbps, hits);
+    }
+}
+
+// 各个级别的结果必须一致
+static bool verify()
+{
+    std::string data = makeHeaders(1 << 16, 7) + makeLongLine(1000, 9);
+    simd::CharClass cc(":\r");
+    std::vector<const char *> expectDelim, expectClass;
+    simd::setLevel(simd::kScalar);
+    for (size_t off = 0; off < 200; ++off)
+    {
+        const char *b = data.data() + off;
+        const char *e = data.data() + data.size() - off;
+        expectDelim.push_back(simd::findDelim(b, e, "\r\n", 2));
+        expectDelim.push_back(simd::findDelim(b, e, "\r\n\r\n", 4));
+        expectClass.push_back(simd::findFirstOf(b, e, cc));
+    }
+    const simd::Level levels[] = {simd::kSse2, simd::kAvx2};
+    for (simd::Level level : levels)
+    {
+        if (simd::setLevel(level) != level)
+            continue;
+        size_t d = 0, c = 0;
+        for (size_t off = 0; off < 200; ++off)
+        {
+            const char *b = data.data() + off;
+            const char *e = data.data() + data.size() - off;
+            if (simd::findDelim(b, e, "\r\n", 2) != expectDelim[d++] ||
+                simd::findDelim(b, e, "\r\n\r\n", 4) != expectDelim[d++] ||
+                simd::findFirstOf(b, e, cc) != expectClass[c++])
+            {
+                fprintf(stderr, "mismatch at level %s offset %zu\n", simd::levelName(level), off);
+                return false;
+            }
+        }
+    }
+    return true;
+}
+
+int main(int argc, char *argv[])
+{
+    size_t totalMb = argc > 1 ? static_cast<size_t>(atoi(argv[1])) : 512;
+    size_t totalBytes = totalMb * 1024 * 1024;
+
+    if (!verify())
+    {
+        return 1;
+    }
+
+    benchScenario("headers", makeHeaders(64 * 1024, 1), totalBytes);
+    benchScenario("long-line", makeLongLine(1024 * 1024, 2), totalBytes);
+
+    // 通过Buffer接口逐行解析：findCRLF + retrieveUntil，不产生任何string拷贝
+    simd::setLevel(simd::kAvx2);
+    std::string headers = makeHeaders(64 * 1024, 3);
+    Buffer buf;
+    size_t scanned = 0, lines = 0;
+    double start = nowSeconds();
+    while (scanned < totalBytes)
+    {
+        buf.append(headers.data(), headers.size());
+        const char *crlf;
+        while ((crlf = buf.findCRLF()) != nullptr)
+        {
+            ++lines;
+            buf.retrieveUntil(crlf + 2);
+        }
+        scanned += headers.size();
+    }
+    double elapsed = nowSeconds() - start;
+    report("headers", "Buffer::findCRLF", scanned / elapsed / (1024.0 * 1024.0), lines);
+    return 0;
+}
@@ -0,0 +1,321 @@
+/**
+ * [TLS基准测试]  进程内启动一个挂了TlsContext的TcpServer，客户端用阻塞socket + OpenSSL打本地端口。
+ * 证书是启动时现生成的P-256自签名证书。每个场景在stdout输出一行JSON:
+ *   handshake  每个客户端线程不停地 connect -> 完整握手(不复用session) -> close，统计每秒握手数
+ *   bulk       服务端在每个连接上不停地send size字节的块(writeComplete里续上)，客户端只收，统计MB/s；
+ *              这是服务端加密发送的路径，ktls=1时看kTLS有没有生效(结果里的ktls_conns)
+ *   all        依次跑上面两个
+ *
+ * 用法: ./tls_bench <场景> [key=value ...]
+ *   loops=1 threads=1 seconds=5 size=65536 port=9443
+ *   ktls=0   打开TlsContext::setKernelTls
+ *   plain=0  不挂TLS，用同样的客户端收明文，作为对照
+ */
+#include "TcpServer.h"
+#include "EventLoop.h"
+#include "Buffer.h"
+#include "Timestamp.h"
+#include "TlsContext.h"
+#include "TlsFilter.h"
+
+#include <openssl/err.h>
+#include <openssl/evp.h>
+#include <openssl/pem.h>
+#include <openssl/ssl.h>
+#include <openssl/x509.h>
+
+#include <atomic>
+#include <chrono>
+#include <map>
+#include <string>
+#include <thread>
+#include <vector>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <sys/socket.h>
+
+namespace
+{
+    std::map<std::string, std::string> g_options;
+
+    long option(const char *key, long def)
+    {
+        std::map<std::string, std::string>::const_iterator it = g_options.find(key);
+        return it == g_options.end() ? def : atol(it->second.c_str());
+    }
+
+    struct Config
+    {
+        int loops;
+        int threads;
+        int seconds;
+        size_t size;
+        uint16_t port;
+        bool ktls;
+        bool plain;
+    };
+
+    // 生成自签名证书和私钥，写到临时文件里给TlsContext::useCertificate
+    bool makeCertificate(std::string *certPath, std::string *keyPath)
+    {
+        EVP_PKEY *pkey = EVP_EC_gen("P-256");
+        X509 *x509 = X509_new();
+        if (pkey == nullptr || x509 == nullptr)
+            return false;
+        X509_set_version(x509, 2);
+        ASN1_INTEGER_set(X509_get_serialNumber(x509), 1);
+        X509_gmtime_adj(X509_getm_notBefore(x509), 0);
+        X509_gmtime_adj(X509_getm_notAfter(x509), 24 * 3600);
+        X509_set_pubkey(x509, pkey);
+        X509_NAME *name = X509_get_subject_name(x509);
+        X509_NAME_add_entry_by_txt(name, "CN", MBSTRING_ASC, reinterpret_cast<const unsigned char *>("localhost"), -1, -1, 0);
+        X509_set_issuer_name(x509, name);
+        X509_sign(x509, pkey, EVP_sha256());
+
+        char certTemplate[] = "/tmp/tls_bench_crtXXXXXX";
+        char keyTemplate[] = "/tmp/tls_bench_keyXXXXXX";
+        int certFd = ::mkstemp(certTemplate);
+        int keyFd = ::mkstemp(keyTemplate);
+        FILE *certFile = certFd < 0 ? nullptr : ::fdopen(certFd, "w");
+        FILE *keyFile = keyFd < 0 ? nullptr : ::fdopen(keyFd, "w");
+        bool ok = certFile != nullptr && keyFile != nullptr &&
+                  PEM_write_X509(certFile, x509) == 1 &&
+                  PEM_write_PrivateKey(keyFile, pkey, nullptr, nullptr, 0, nullptr, nullptr) == 1;
+        if (certFile != nullptr)
+            ::fclose(certFile);
+        if (keyFile != nullptr)
+            ::fclose(keyFile);
+        X509_free(x509);
+        EVP_PKEY_free(pkey);
+        *certPath = certTemplate;
+        *keyPath = keyTemplate;
+        return ok;
+    }
+
+    int connectTo(uint16_t port)
+    {
+        int fd = ::socket(AF_INET, SOCK_STREAM | SOCK_CLOEXEC, 0);
+        if (fd < 0)
+            return -1;
+        sockaddr_in addr;
+        memset(&addr, 0, sizeof addr);
+        addr.sin_family = AF_INET;
+        addr.sin_port = htons(port);
+        addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+        if (::connect(fd, reinterpret_cast<sockaddr *>(&addr), sizeof addr) < 0)
+        {
+            ::close(fd);
+            return -1;
+        }
+        int one = 1;
+        ::setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &one, sizeof one);
+        return fd;
+    }
+
+    // [客户端的一个连接]  plain时不走SSL，read/write直接用fd
+    class Client
+    {
+    public:
+        Client(SSL_CTX *ctx, uint16_t port) : fd_(connectTo(port)), ssl_(nullptr)
+        {
+            if (fd_ < 0 || ctx == nullptr)
+                return;
+            ssl_ = SSL_new(ctx);
+            SSL_set_fd(ssl_, fd_);
+            if (SSL_connect(ssl_) != 1)
+            {
+                SSL_free(ssl_);
+                ssl_ = nullptr;
+                ::close(fd_);
+                fd_ = -1;
+            }
+        }
+        ~Client()
+        {
+            if (ssl_ != nullptr)
+                SSL_free(ssl_); // 不发close_notify，直接关，和大多数压测客户端一样
+            if (fd_ >= 0)
+                ::close(fd_);
+        }
+        bool ok() const { return fd_ >= 0; }
+        ssize_t read(char *buf, size_t len)
+        {
+            return ssl_ != nullptr ? SSL_read(ssl_, buf, static_cast<int>(len)) : ::read(fd_, buf, len);
+        }
+
+    private:
+        int fd_;
+        SSL *ssl_;
+    };
+
+    class Bench
+    {
+    public:
+        Bench(const Config &cfg, SSL_CTX *clientCtx, std::atomic<bool> *streaming, std::atomic<int> *ktlsConns)
+            : cfg_(cfg), clientCtx_(clientCtx), streaming_(streaming), ktlsConns_(ktlsConns) {}
+
+        void run(const std::string &scenario)
+        {
+            if (scenario == "handshake" || scenario == "all")
+                handshake();
+            if (scenario == "bulk" || scenario == "all")
+                bulk();
+        }
+
+    private:
+        void handshake()
+        {
+            std::atomic<long> done(0);
+            std::atomic<long> failed(0);
+            int64_t deadline = Timestamp::monotonicNanos() + static_cast<int64_t>(cfg_.seconds) * 1000000000;
+            std::vector<std::thread> threads;
+            for (int i = 0; i < cfg_.threads; ++i)
+            {
+                threads.emplace_back([&]()
+                                     {
+                    while (Timestamp::monotonicNanos() < deadline)
+                    {
+                        Client client(clientCtx_, cfg_.port);
+                        if (client.ok())
+                            done.fetch_add(1, std::memory_order_relaxed);
+                        else
+                            failed.fetch_add(1, std::memory_order_relaxed);
+                    } });
+            }
+            for (std::thread &t : threads)
+                t.join();
+            printf("{\"bench\":\"tls_handshake\",\"loops\":%d,\"threads\":%d,\"seconds\":%d,\"plain\":%d,"
+                   "\"handshakes\":%ld,\"failed\":%ld,\"per_s\":%.0f}\n",
+                   cfg_.loops, cfg_.threads, cfg_.seconds, cfg_.plain ? 1 : 0,
+                   done.load(), failed.load(), static_cast<double>(done.load()) / cfg_.seconds);
+            fflush(stdout);
+        }
+
+        void bulk()
+        {
+            ktlsConns_->store(0);
+            streaming_->store(true);
+            std::atomic<long> bytes(0);
+            int64_t deadline = Timestamp::monotonicNanos() + static_cast<int64_t>(cfg_.seconds) * 1000000000;
+            std::vector<std::thread> threads;
+            for (int i = 0; i < cfg_.threads; ++i)
+            {
+                threads.emplace_back([&]()
+                                     {
+                    Client client(clientCtx_, cfg_.port);
+                    if (!client.ok())
+                        return;
+                    std::vector<char> buf(256 * 1024);
+                    long got = 0;
+                    while (Timestamp::monotonicNanos() < deadline)
+                    {
+                        ssize_t n = client.read(buf.data(), buf.size());
+                        if (n <= 0)
+                            break;
+                        got += n;
+                    }
+                    bytes.fetch_add(got, std::memory_order_relaxed); });
+            }
+            for (std::thread &t : threads)
+                t.join();
+            streaming_->store(false);
+            printf("{\"bench\":\"tls_bulk\",\"loops\":%d,\"conns\":%d,\"size\":%zu,\"seconds\":%d,\"plain\":%d,"
+                   "\"ktls\":%d,\"ktls_conns\":%d,\"bytes\":%ld,\"mb_per_s\":%.1f}\n",
+                   cfg_.loops, cfg_.threads, cfg_.size, cfg_.seconds, cfg_.plain ? 1 : 0, cfg_.ktls ? 1 : 0,
+                   ktlsConns_->load(), bytes.load(), bytes.load() / (1024.0 * 1024.0) / cfg_.seconds);
+            fflush(stdout);
+        }
+
+        Config cfg_;
+        SSL_CTX *clientCtx_;
+        std::atomic<bool> *streaming_; // bulk期间服务端才往连接上灌数据
+        std::atomic<int> *ktlsConns_;
+    };
+}
+
+int main(int argc, char *argv[])
+{
+    if (argc < 2)
+    {
+        fprintf(stderr, "usage: %s handshake|bulk|all [key=value ...]\n", argv[0]);
+        return 1;
+    }
+    std::string scenario = argv[1];
+    for (int i = 2; i < argc; ++i)
+    {
+        const char *eq = strchr(argv[i], '=');
+        if (eq != nullptr)
+            g_options[std::string(argv[i], eq - argv[i])] = eq + 1;
+    }
+    Config cfg;
+    cfg.loops = static_cast<int>(option("loops", 1));
+    cfg.threads = static_cast<int>(option("threads", 1));
+    cfg.seconds = static_cast<int>(option("seconds", 5));
+    cfg.size = static_cast<size_t>(option("size", 65536));
+    cfg.port = static_cast<uint16_t>(option("port", 9443));
+    cfg.ktls = option("ktls", 0) != 0;
+    cfg.plain = option("plain", 0) != 0;
+
+    std::shared_ptr<TlsContext> tls;
+    SSL_CTX *clientCtx = nullptr;
+    if (!cfg.plain)
+    {
+        std::string certPath, keyPath;
+        tls = std::make_shared<TlsContext>();
+        bool ok = makeCertificate(&certPath, &keyPath) && tls->useCertificate(certPath, keyPath);
+        ::unlink(certPath.c_str());
+        ::unlink(keyPath.c_str());
+        if (!ok)
+        {
+            fprintf(stderr, "failed to create certificate\n");
+            return 1;
+        }
+        tls->setKernelTls(cfg.ktls);
+        clientCtx = SSL_CTX_new(TLS_client_method());
+        SSL_CTX_set_session_cache_mode(clientCtx, SSL_SESS_CACHE_OFF); // 每次都是完整握手
+    }
+
+    std::atomic<bool> streaming(false);
+    std::atomic<int> ktlsConns(0);
+    const std::string block(cfg.size, 'x');
+    EventLoop loop;
+    TcpServer server(&loop, InetAddress(cfg.port), "tls_bench");
+    server.setConnectionCallback([&](const TcpConnectionPtr &conn)
+                                 {
+        if (!conn->connected())
+            return;
+        TlsFilter *filter = static_cast<TlsFilter *>(conn->filter());
+        if (filter != nullptr && filter->kernelTx())
+            ktlsConns.fetch_add(1, std::memory_order_relaxed);
+        if (streaming.load(std::memory_order_relaxed))
+            conn->send(block); });
+    // 客户端不发数据，这里只是为了握手以外的读事件有地方去
+    server.setMessageCallback([](const TcpConnectionPtr &, Buffer *buf, Timestamp)
+                              { buf->retrieveAll(); });
+    server.setWriteCompleteCallback([&](const TcpConnectionPtr &conn)
+                                    {
+        if (conn->connected() && streaming.load(std::memory_order_relaxed))
+            conn->send(block); });
+    server.setThreadNum(cfg.loops);
+    if (tls)
+        TlsContext::enable(&server, tls);
+    server.start();
+
+    Bench bench(cfg, clientCtx, &streaming, &ktlsConns);
+    std::thread driver([&]()
+                       {
+        std::this_thread::sleep_for(std::chrono::milliseconds(200));
+        bench.run(scenario);
+        loop.quit(); });
+
+    loop.loop();
+    driver.join();
+    if (clientCtx != nullptr)
+        SSL_CTX_free(clientCtx);
+    return 0;
+}
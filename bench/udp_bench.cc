@@ -0,0 +1,327 @@
+/**
+ * [UDP包速率基准]  进程内启动一个echo UdpServer，多线程客户端用sendmmsg/recvmmsg打本地端口，
+ * 每个客户端socket保持window个包在路上，统计每秒echo回来的包数。结果在stdout输出一行JSON
+ *
+ * 用法: ./udp_bench [key=value ...]
+ *   loops=1 threads=1 conns=4 size=64 window=32 seconds=5 warmup=1 port=9983
+ *   batch=64     服务端一次recvmmsg的包数，batch=1相当于逐包recvfrom/sendto
+ *   gro=0 gso=0  服务端打开UDP_GRO/UDP_SEGMENT
+ *   client_gso=0 客户端把一个窗口的包用UDP_SEGMENT一次发出，服务端开gro时整批合并上来
+ *   out=<文件>   结果追加写到文件里，默认stdout
+ */
+#include "UdpServer.h"
+#include "EventLoop.h"
+#include "Timestamp.h"
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <map>
+#include <string>
+#include <thread>
+#include <vector>
+#include <errno.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <netinet/udp.h>
+#include <sys/epoll.h>
+#include <sys/socket.h>
+
+#ifndef SOL_UDP
+#define SOL_UDP 17
+#endif
+#ifndef UDP_SEGMENT
+#define UDP_SEGMENT 103
+#endif
+
+namespace
+{
+    class Options
+    {
+    public:
+        Options(int argc, char *argv[])
+        {
+            for (int i = 1; i < argc; ++i)
+            {
+                const char *eq = strchr(argv[i], '=');
+                if (eq != nullptr)
+                    values_[std::string(argv[i], eq - argv[i])] = eq + 1;
+            }
+        }
+        long get(const char *key, long def) const
+        {
+            std::map<std::string, std::string>::const_iterator it = values_.find(key);
+            return it == values_.end() ? def : atol(it->second.c_str());
+        }
+        std::string getString(const char *key) const
+        {
+            std::map<std::string, std::string>::const_iterator it = values_.find(key);
+            return it == values_.end() ? std::string() : it->second;
+        }
+
+    private:
+        std::map<std::string, std::string> values_;
+    };
+
+    struct Config
+    {
+        int loops;
+        int threads;
+        int conns;
+        size_t size;
+        int window;
+        int seconds;
+        int warmup;
+        uint16_t port;
+        int batch;
+        bool gro;
+        bool gso;
+        bool clientGso;
+    };
+
+    const int64_t kLossTimeoutNs = 50 * 1000 * 1000; // 一个socket 50ms没收到回包，就把在路上的算丢了
+    const size_t kRecvSlot = 2048;
+
+    struct ClientSocket
+    {
+        int fd;
+        int inflight;
+        int64_t lastProgress;
+    };
+
+    int connectUdp(uint16_t port)
+    {
+        int fd = ::socket(AF_INET, SOCK_DGRAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+        if (fd < 0)
+            return -1;
+        sockaddr_in addr;
+        memset(&addr, 0, sizeof addr);
+        addr.sin_family = AF_INET;
+        addr.sin_port = htons(port);
+        addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+        if (::connect(fd, reinterpret_cast<sockaddr *>(&addr), sizeof addr) < 0)
+        {
+            ::close(fd);
+            return -1;
+        }
+        return fd;
+    }
+
+    // [客户端线程]  每个socket补满window个包，收到多少补多少
+    void clientThread(const Config &cfg, int64_t measureStart, int64_t deadline, long *packets, long *lost)
+    {
+        int epfd = ::epoll_create1(EPOLL_CLOEXEC);
+        std::vector<ClientSocket> socks(cfg.conns);
+        for (ClientSocket &s : socks)
+        {
+            s.fd = connectUdp(cfg.port);
+            if (s.fd < 0)
+            {
+                perror("connect");
+                ::exit(1);
+            }
+            s.inflight = 0;
+            s.lastProgress = Timestamp::monotonicNanos();
+            epoll_event ev;
+            ev.events = EPOLLIN;
+            ev.data.ptr = &s;
+            ::epoll_ctl(epfd, EPOLL_CTL_ADD, s.fd, &ev);
+        }
+
+        const int window = cfg.window;
+        std::string payload(cfg.size, 'u');
+        std::vector<mmsghdr> sendMsgs(window);
+        std::vector<iovec> sendIov(window);
+        for (int i = 0; i < window; ++i)
+        {
+            sendIov[i].iov_base = &payload[0];
+            sendIov[i].iov_len = payload.size();
+        }
+        std::vector<char> recvData(window * kRecvSlot);
+        std::vector<mmsghdr> recvMsgs(window);
+        std::vector<iovec> recvIov(window);
+        for (int i = 0; i < window; ++i)
+        {
+            recvIov[i].iov_base = &recvData[i * kRecvSlot];
+            recvIov[i].iov_len = kRecvSlot;
+        }
+        char control[CMSG_SPACE(sizeof(uint16_t))];
+
+        auto pump = [&](ClientSocket *s)
+        {
+            int need = window - s->inflight;
+            if (need <= 0)
+                return;
+            int sent = 0;
+            if (cfg.clientGso && need > 1)
+            {
+                // 整个窗口一条消息，内核按size切段
+                msghdr hdr;
+                memset(&hdr, 0, sizeof hdr);
+                hdr.msg_iov = sendIov.data();
+                hdr.msg_iovlen = need;
+                hdr.msg_control = control;
+                hdr.msg_controllen = sizeof control;
+                cmsghdr *cmsg = CMSG_FIRSTHDR(&hdr);
+                cmsg->cmsg_level = SOL_UDP;
+                cmsg->cmsg_type = UDP_SEGMENT;
+                cmsg->cmsg_len = CMSG_LEN(sizeof(uint16_t));
+                uint16_t segment = static_cast<uint16_t>(cfg.size);
+                memcpy(CMSG_DATA(cmsg), &segment, sizeof segment);
+                if (::sendmsg(s->fd, &hdr, 0) > 0)
+                    sent = need;
+            }
+            else
+            {
+                for (int i = 0; i < need; ++i)
+                {
+                    memset(&sendMsgs[i].msg_hdr, 0, sizeof(msghdr));
+                    sendMsgs[i].msg_hdr.msg_iov = &sendIov[i];
+                    sendMsgs[i].msg_hdr.msg_iovlen = 1;
+                }
+                int n = ::sendmmsg(s->fd, sendMsgs.data(), need, 0);
+                if (n > 0)
+                    sent = n;
+            }
+            s->inflight += sent;
+        };
+
+        for (ClientSocket &s : socks)
+            pump(&s);
+        std::vector<epoll_event> events(cfg.conns);
+        long counted = 0;
+        long dropped = 0;
+        while (true)
+        {
+            int64_t now = Timestamp::monotonicNanos();
+            if (now >= deadline)
+                break;
+            int ready = ::epoll_wait(epfd, events.data(), cfg.conns, 10);
+            now = Timestamp::monotonicNanos();
+            bool measuring = now >= measureStart;
+            for (int i = 0; i < ready; ++i)
+            {
+                ClientSocket *s = static_cast<ClientSocket *>(events[i].data.ptr);
+                while (true)
+                {
+                    for (int k = 0; k < window; ++k)
+                    {
+                        memset(&recvMsgs[k].msg_hdr, 0, sizeof(msghdr));
+                        recvMsgs[k].msg_hdr.msg_iov = &recvIov[k];
+                        recvMsgs[k].msg_hdr.msg_iovlen = 1;
+                    }
+                    int n = ::recvmmsg(s->fd, recvMsgs.data(), window, MSG_DONTWAIT, nullptr);
+                    if (n <= 0)
+                        break;
+                    s->inflight = std::max(0, s->inflight - n);
+                    s->lastProgress = now;
+                    if (measuring)
+                        counted += n;
+                }
+                pump(s);
+            }
+            for (ClientSocket &s : socks)
+            {
+                if (s.inflight > 0 && now - s.lastProgress > kLossTimeoutNs)
+                {
+                    if (measuring)
+                        dropped += s.inflight;
+                    s.inflight = 0;
+                    s.lastProgress = now;
+                    pump(&s);
+                }
+            }
+        }
+        *packets = counted;
+        *lost = dropped;
+        for (ClientSocket &s : socks)
+            ::close(s.fd);
+        ::close(epfd);
+    }
+}
+
+int main(int argc, char *argv[])
+{
+    Options opts(argc, argv);
+    Config cfg;
+    cfg.loops = static_cast<int>(opts.get("loops", 1));
+    cfg.threads = static_cast<int>(opts.get("threads", 1));
+    cfg.conns = static_cast<int>(opts.get("conns", 4));
+    cfg.size = static_cast<size_t>(std::min(opts.get("size", 64), static_cast<long>(kRecvSlot)));
+    cfg.window = std::max(1, std::min(64, static_cast<int>(opts.get("window", 32))));
+    cfg.seconds = static_cast<int>(opts.get("seconds", 5));
+    cfg.warmup = static_cast<int>(opts.get("warmup", 1));
+    cfg.port = static_cast<uint16_t>(opts.get("port", 9983));
+    cfg.batch = std::max(1, static_cast<int>(opts.get("batch", 64)));
+    cfg.gro = opts.get("gro", 0) != 0;
+    cfg.gso = opts.get("gso", 0) != 0;
+    cfg.clientGso = opts.get("client_gso", 0) != 0;
+
+    std::string outPath = opts.getString("out");
+    FILE *out = outPath.empty() ? stdout : ::fopen(outPath.c_str(), "a");
+    if (out == nullptr)
+    {
+        perror("fopen");
+        return 1;
+    }
+
+    EventLoop loop;
+    UdpServer server(&loop, InetAddress(cfg.port), "udp_bench");
+    UdpChannel::Options options;
+    options.batchSize = cfg.batch;
+    options.gro = cfg.gro;
+    options.gso = cfg.gso;
+    options.gsoMaxSegment = 65507; // loopback的MTU是64KB
+    server.setOptions(options);
+    server.setMessageCallback([](UdpChannel *channel, const char *data, size_t len, const InetAddress &peer, Timestamp)
+                              { channel->send(peer, data, len); });
+    server.setThreadNum(cfg.loops);
+    server.start();
+
+    std::thread driver([&]()
+                       {
+        std::this_thread::sleep_for(std::chrono::milliseconds(200));
+        int64_t start = Timestamp::monotonicNanos();
+        int64_t measureStart = start + static_cast<int64_t>(cfg.warmup) * 1000000000;
+        int64_t deadline = measureStart + static_cast<int64_t>(cfg.seconds) * 1000000000;
+        std::vector<long> packets(cfg.threads), lost(cfg.threads);
+        std::vector<std::thread> threads;
+        for (int i = 0; i < cfg.threads; ++i)
+            threads.emplace_back(clientThread, std::cref(cfg), measureStart, deadline, &packets[i], &lost[i]);
+        std::this_thread::sleep_until(std::chrono::steady_clock::time_point(std::chrono::nanoseconds(measureStart)));
+        UdpStatsSnapshot before = server.stats();
+        long total = 0, totalLost = 0;
+        for (int i = 0; i < cfg.threads; ++i)
+        {
+            threads[i].join();
+            total += packets[i];
+            totalLost += lost[i];
+        }
+        UdpStatsSnapshot after = server.stats();
+        uint64_t recvCalls = after.recvCalls - before.recvCalls;
+        uint64_t packetsIn = after.packetsIn - before.packetsIn;
+        fprintf(out, "{\"bench\":\"udp_echo\",\"loops\":%d,\"threads\":%d,\"conns\":%d,\"size\":%zu,\"window\":%d,"
+                     "\"batch\":%d,\"gro\":%d,\"gso\":%d,\"client_gso\":%d,\"seconds\":%d,"
+                     "\"packets\":%ld,\"pps\":%.0f,\"lost\":%ld,\"srv_recv_calls\":%llu,\"srv_pkts_per_recv\":%.1f,"
+                     "\"srv_send_calls\":%llu,\"srv_gso_sends\":%llu,\"srv_drops\":%llu}\n",
+                cfg.loops, cfg.threads, cfg.conns, cfg.size, cfg.window, cfg.batch,
+                server.channels()[0]->groEnabled() ? 1 : 0, server.channels()[0]->gsoEnabled() ? 1 : 0,
+                cfg.clientGso ? 1 : 0, cfg.seconds, total, static_cast<double>(total) / cfg.seconds, totalLost,
+                static_cast<unsigned long long>(recvCalls),
+                recvCalls == 0 ? 0.0 : static_cast<double>(packetsIn) / recvCalls,
+                static_cast<unsigned long long>(after.sendCalls - before.sendCalls),
+                static_cast<unsigned long long>(after.gsoSends - before.gsoSends),
+                static_cast<unsigned long long>(after.sendDrops - before.sendDrops));
+        fflush(out);
+        loop.quit(); });
+
+    loop.loop();
+    driver.join();
+    if (out != stdout)
+        ::fclose(out);
+    return 0;
+}
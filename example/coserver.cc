@@ -0,0 +1,55 @@
+#include <mymuduo/Coroutine.h>
+#include <mymuduo/Logger.h>
+
+#include <string>
+#include <stdlib.h>
+
+/**
+ * [用协程写的行回显服务器]  需要 -std=c++20
+ * - 按行读，"sleep <ms>"先在本loop上睡一会再回复，"quit"关闭连接，其他行原样回显
+ * - 读写都是co_await，连接断开时挂起的读写会被唤醒，协程自然结束
+ */
+co::Task<bool> handleLine(co::Connection &conn, const std::string &line)
+{
+    if (line.compare(0, 6, "sleep ") == 0)
+    {
+        co_await co::sleep(conn.getLoop(), atoi(line.c_str() + 6) / 1000.0);
+        co_return co_await conn.write("ok\r\n");
+    }
+    if (line == "quit\r\n")
+    {
+        co_await conn.write("bye\r\n");
+        co_return false;
+    }
+    co_return co_await conn.write(line);
+}
+
+co::Task<> session(co::Connection conn)
+{
+    std::string greeting = "hello " + conn.get()->peerAddress().toIpPort() + "\r\n";
+    if (!co_await conn.write(greeting))
+    {
+        co_return;
+    }
+    while (true)
+    {
+        std::string line = co_await conn.readUntil("\r\n");
+        if (line.empty() || !co_await handleLine(conn, line))
+        {
+            break;
+        }
+    }
+    conn.shutdown();
+}
+
+int main(int argc, char *argv[])
+{
+    uint16_t port = static_cast<uint16_t>(argc > 1 ? atoi(argv[1]) : 8001);
+    EventLoop loop;
+    TcpServer server(&loop, InetAddress(port), "CoServer");
+    co::serve(&server, session);
+    server.setThreadNum(argc > 2 ? atoi(argv[2]) : 2);
+    server.start();
+    loop.loop();
+    return 0;
+}
@@ -0,0 +1,315 @@
+#include <mymuduo/TcpServer.h>
+#include <mymuduo/EventLoopThreadPool.h>
+#include <mymuduo/ShardRouter.h>
+#include <mymuduo/RespCodec.h>
+#include <mymuduo/Logger.h>
+
+#include <functional>
+#include <map>
+#include <memory>
+#include <string>
+#include <unordered_map>
+#include <vector>
+#include <stdlib.h>
+#include <strings.h>
+
+/**
+ * [按subloop分片的内存KV服务器，说RESP协议，redis-cli/redis-benchmark可以直接连]
+ * - 每个subloop持有一个哈希分片，分片只在自己的loop线程里访问，不需要加锁
+ * - key落在当前连接所在的loop上就直接执行；否则通过ShardRouter(loop之间的SPSC队列)把命令交给
+ *   分片所在的loop，结果再送回连接的loop
+ * - 同一个连接上pipelined命令可能落到不同分片，按序号重排后再回复，保证顺序和请求一致
+ *
+ * 支持: PING ECHO GET SET DEL EXISTS INCR COMMAND QUIT
+ */
+class KvServer
+{
+public:
+    KvServer(EventLoop *loop, const InetAddress &addr, int numThreads)
+        : server_(loop, addr, "KvServer")
+    {
+        server_.setConnectionCallback(
+            std::bind(&KvServer::onConnection, this, std::placeholders::_1));
+        server_.setMessageCallback(
+            std::bind(&KvServer::onMessage, this,
+                      std::placeholders::_1, std::placeholders::_2, std::placeholders::_3));
+        server_.setThreadNum(numThreads);
+    }
+
+    void start()
+    {
+        server_.start();
+        // 线程池启动以后才能拿到所有subloop，一个loop一个分片
+        router_.reset(new ShardRouter(server_.threadPool().get()));
+        for (size_t i = 0; i < router_->shardCount(); ++i)
+        {
+            shards_.push_back(std::unique_ptr<Shard>(new Shard));
+        }
+    }
+
+private:
+    struct Shard
+    {
+        std::unordered_map<std::string, std::string> data;
+    };
+
+    // [每个连接的状态]  只在连接所在的loop线程里访问
+    struct Session
+    {
+        Session() : nextSeq(0), nextReply(0), quit(false) {}
+        RespParser parser;
+        uint64_t nextSeq;                    // 下一个命令的序号
+        uint64_t nextReply;                  // 下一个该回复的序号
+        std::map<uint64_t, std::string> ready; // 已经算好、但前面还有命令没回复的结果
+        bool quit;
+    };
+
+    static Buffer &outputBuffer()
+    {
+        static thread_local Buffer output;
+        return output;
+    }
+
+    size_t shardFor(const StringPiece &key)
+    {
+        // FNV-1a，不用std::hash是为了不构造string
+        uint64_t h = 14695981039346656037ULL;
+        for (size_t i = 0; i < key.size(); ++i)
+        {
+            h = (h ^ static_cast<unsigned char>(key[i])) * 1099511628211ULL;
+        }
+        return h % shards_.size();
+    }
+
+    static bool isCommand(const StringPiece &arg, const char *name)
+    {
+        size_t len = strlen(name);
+        return arg.size() == len && ::strncasecmp(arg.data(), name, len) == 0;
+    }
+
+    void onConnection(const TcpConnectionPtr &conn)
+    {
+        if (conn->connected())
+        {
+            conn->setContext(std::make_shared<Session>());
+        }
+    }
+
+    void onMessage(const TcpConnectionPtr &conn, Buffer *buf, Timestamp)
+    {
+        Session *session = static_cast<Session *>(conn->getContext().get());
+        while (!session->quit)
+        {
+            RespParser::ParseResult result = session->parser.parse(buf);
+            if (result == RespParser::kNeedMore)
+            {
+                break;
+            }
+            if (result == RespParser::kError)
+            {
+                // 错误回复也占一个序号：前面还在别的分片上算的命令要先回复
+                uint64_t seq = session->nextSeq++;
+                Buffer *reply = replyBuffer(session, seq);
+                resp::appendError(reply, session->parser.error());
+                complete(session, seq, reply);
+                buf->retrieveAll();
+                session->quit = true;
+                break;
+            }
+            const std::vector<StringPiece> &args = session->parser.args();
+            if (!args.empty())
+            {
+                dispatch(conn, session, args);
+            }
+            buf->retrieve(session->parser.frameLength());
+            session->parser.reset();
+        }
+        flush(conn, session);
+    }
+
+    // [一条命令]  不涉及key的命令和落在本loop分片上的命令当场执行，其他的转发给分片所在的loop
+    void dispatch(const TcpConnectionPtr &conn, Session *session, const std::vector<StringPiece> &args)
+    {
+        uint64_t seq = session->nextSeq++;
+        const StringPiece &cmd = args[0];
+        if (isCommand(cmd, "PING") || isCommand(cmd, "ECHO") || isCommand(cmd, "COMMAND") ||
+            isCommand(cmd, "QUIT") || args.size() < 2)
+        {
+            Buffer *reply = replyBuffer(session, seq);
+            executeLocal(session, args, reply);
+            complete(session, seq, reply);
+            return;
+        }
+
+        size_t index = shardFor(args[1]);
+        Shard *shard = shards_[index].get();
+        if (static_cast<int>(index) == router_->currentShard())
+        {
+            Buffer *reply = replyBuffer(session, seq);
+            executeOnShard(shard, args, reply);
+            complete(session, seq, reply);
+            return;
+        }
+
+        // 跨loop：参数要拷贝一份，inputBuffer里的数据马上就被retrieve了
+        std::vector<std::string> copied;
+        copied.reserve(args.size());
+        for (const StringPiece &arg : args)
+        {
+            copied.push_back(arg.as_string());
+        }
+        router_->call(
+            index,
+            [this, shard, copied]()
+            {
+                std::vector<StringPiece> views(copied.begin(), copied.end());
+                Buffer reply;
+                executeOnShard(shard, views, &reply);
+                return reply.retrieveAllAsString();
+            },
+            [this, conn, seq](const std::string &result)
+            {
+                if (!conn->connected())
+                {
+                    return;
+                }
+                Session *session = static_cast<Session *>(conn->getContext().get());
+                session->ready.insert(std::make_pair(seq, result));
+                flush(conn, session);
+            });
+    }
+
+    // [回复写到哪里]  前面的命令都回复过了就直接写进发送Buffer，否则先写到临时Buffer里存起来
+    Buffer *replyBuffer(Session *session, uint64_t seq)
+    {
+        if (seq == session->nextReply)
+        {
+            return &outputBuffer();
+        }
+        static thread_local Buffer scratch;
+        return &scratch;
+    }
+
+    void complete(Session *session, uint64_t seq, Buffer *reply)
+    {
+        if (reply == &outputBuffer())
+        {
+            ++session->nextReply;
+        }
+        else
+        {
+            session->ready.insert(std::make_pair(seq, reply->retrieveAllAsString()));
+        }
+    }
+
+    void flush(const TcpConnectionPtr &conn, Session *session)
+    {
+        Buffer &output = outputBuffer();
+        std::map<uint64_t, std::string>::iterator it = session->ready.begin();
+        while (it != session->ready.end() && it->first == session->nextReply)
+        {
+            output.append(it->second);
+            ++session->nextReply;
+            it = session->ready.erase(it);
+        }
+        if (output.readableBytes() > 0)
+        {
+            conn->send(&output);
+        }
+        if (session->quit && session->nextReply == session->nextSeq)
+        {
+            conn->shutdown();
+        }
+    }
+
+    void executeLocal(Session *session, const std::vector<StringPiece> &args, Buffer *reply)
+    {
+        const StringPiece &cmd = args[0];
+        if (isCommand(cmd, "PING"))
+        {
+            if (args.size() > 1)
+                resp::appendBulkString(reply, args[1]);
+            else
+                resp::appendSimpleString(reply, "PONG");
+        }
+        else if (isCommand(cmd, "ECHO") && args.size() == 2)
+        {
+            resp::appendBulkString(reply, args[1]);
+        }
+        else if (isCommand(cmd, "COMMAND"))
+        {
+            resp::appendArrayHeader(reply, 0); // redis-cli启动时会发COMMAND DOCS
+        }
+        else if (isCommand(cmd, "QUIT"))
+        {
+            resp::appendSimpleString(reply, "OK");
+            session->quit = true;
+        }
+        else
+        {
+            std::string msg = "ERR unknown command or wrong number of arguments for '" + cmd.as_string() + "'";
+            resp::appendError(reply, msg);
+        }
+    }
+
+    // 只在shard->loop线程里调用
+    void executeOnShard(Shard *shard, const std::vector<StringPiece> &args, Buffer *reply)
+    {
+        const StringPiece &cmd = args[0];
+        std::string key = args[1].as_string();
+        if (isCommand(cmd, "GET") && args.size() == 2)
+        {
+            auto it = shard->data.find(key);
+            if (it == shard->data.end())
+                resp::appendNullBulkString(reply);
+            else
+                resp::appendBulkString(reply, it->second);
+        }
+        else if (isCommand(cmd, "SET") && args.size() == 3)
+        {
+            args[2].CopyToString(&shard->data[key]);
+            resp::appendSimpleString(reply, "OK");
+        }
+        else if (isCommand(cmd, "DEL") && args.size() == 2)
+        {
+            resp::appendInteger(reply, static_cast<int64_t>(shard->data.erase(key)));
+        }
+        else if (isCommand(cmd, "EXISTS") && args.size() == 2)
+        {
+            resp::appendInteger(reply, shard->data.count(key) ? 1 : 0);
+        }
+        else if (isCommand(cmd, "INCR") && args.size() == 2)
+        {
+            std::string &value = shard->data[key];
+            char *end = nullptr;
+            long long n = value.empty() ? 0 : strtoll(value.c_str(), &end, 10);
+            if (!value.empty() && *end != '\0')
+            {
+                resp::appendError(reply, "ERR value is not an integer or out of range");
+                return;
+            }
+            value = std::to_string(++n);
+            resp::appendInteger(reply, n);
+        }
+        else
+        {
+            std::string msg = "ERR unknown command or wrong number of arguments for '" + cmd.as_string() + "'";
+            resp::appendError(reply, msg);
+        }
+    }
+
+    TcpServer server_;
+    std::unique_ptr<ShardRouter> router_;
+    std::vector<std::unique_ptr<Shard>> shards_;
+};
+
+int main(int argc, char *argv[])
+{
+    uint16_t port = static_cast<uint16_t>(argc > 1 ? atoi(argv[1]) : 6379);
+    int threads = argc > 2 ? atoi(argv[2]) : 4;
+    EventLoop loop;
+    KvServer server(&loop, InetAddress(port), threads);
+    server.start();
+    loop.loop();
+    return 0;
+}
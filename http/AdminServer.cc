@@ -0,0 +1,460 @@
+#include "AdminServer.h"
+#include "HttpContext.h"
+#include "EventLoop.h"
+#include "Logger.h"
+
+#include <stdio.h>
+
+namespace
+{
+    const char kContentType[] = "text/plain; version=0.0.4; charset=utf-8";
+
+    std::string escapeLabel(const std::string &value)
+    {
+        std::string escaped;
+        escaped.reserve(value.size());
+        for (char c : value)
+        {
+            if (c == '\\' || c == '"')
+            {
+                escaped.push_back('\\');
+                escaped.push_back(c);
+            }
+            else if (c == '\n')
+            {
+                escaped.append("\\n");
+            }
+            else
+            {
+                escaped.push_back(c);
+            }
+        }
+        return escaped;
+    }
+
+    void appendHeader(std::string *out, const char *name, const char *type, const char *help)
+    {
+        *out += "# HELP ";
+        *out += name;
+        *out += ' ';
+        *out += help;
+        *out += "\n# TYPE ";
+        *out += name;
+        *out += ' ';
+        *out += type;
+        *out += '\n';
+    }
+
+    void appendSample(std::string *out, const char *name, const std::string &labels, double value)
+    {
+        char buf[64];
+        snprintf(buf, sizeof buf, "%.17g", value);
+        *out += name;
+        if (!labels.empty())
+        {
+            *out += '{';
+            *out += labels;
+            *out += '}';
+        }
+        *out += ' ';
+        *out += buf;
+        *out += '\n';
+    }
+}
+
+// [每个管理连接的状态]  一次只处理一个请求，采集完回复之后再解析下一个，保证pipelined请求的回复顺序
+struct AdminServer::Session
+{
+    Session() : busy(false) {}
+    HttpContext context;
+    bool busy;
+};
+
+AdminServer::AdminServer(EventLoop *loop, const InetAddress &listenAddr, const std::string &name)
+    : loop_(loop),
+      server_(loop, listenAddr, name),
+      topN_(10),
+      topKey_(TcpServer::kByBytesOut),
+      inflight_(std::make_shared<Inflight>())
+{
+    // 不设置线程数，管理连接都在baseLoop里处理
+    server_.setConnectionCallback(
+        std::bind(&AdminServer::onConnection, this, std::placeholders::_1));
+    server_.setMessageCallback(
+        std::bind(&AdminServer::onMessage, this,
+                  std::placeholders::_1, std::placeholders::_2, std::placeholders::_3));
+}
+
+AdminServer::~AdminServer()
+{
+    // 和~TcpServer、~UdpServer一样，返回之前保证不会再有投递出去的任务访问this
+    std::unique_lock<std::mutex> lock(inflight_->mutex);
+    inflight_->cancelled = true;
+    while (inflight_->running > 0)
+    {
+        inflight_->cond.wait(lock);
+    }
+}
+
+void AdminServer::onConnection(const TcpConnectionPtr &conn)
+{
+    if (conn->connected())
+    {
+        conn->setContext(std::make_shared<Session>());
+    }
+}
+
+void AdminServer::onMessage(const TcpConnectionPtr &conn, Buffer *, Timestamp)
+{
+    processRequests(conn);
+}
+
+void AdminServer::processRequests(const TcpConnectionPtr &conn)
+{
+    Session *session = static_cast<Session *>(conn->getContext().get());
+    Buffer *buf = conn->inputBuffer();
+    while (!session->busy && conn->connected())
+    {
+        HttpContext::ParseResult result = session->context.parseRequest(buf, conn->getLoop()->pollReturnTime());
+        if (result == HttpContext::kNeedMore)
+        {
+            break;
+        }
+        if (result == HttpContext::kError)
+        {
+            buf->retrieveAll();
+            reply(conn, session->context.errorCode(), std::string(), true, true);
+            break;
+        }
+
+        // retrieve之后request里的视图就失效了，先取出需要的
+        const HttpRequest &request = session->context.request();
+        bool close = !session->context.keepAlive();
+        bool withBody = request.method() != HttpRequest::kHead;
+        bool metrics = request.path() == "/metrics";
+        bool index = request.path() == "/";
+        buf->retrieve(session->context.requestLength());
+        session->context.reset();
+
+        if (metrics)
+        {
+            session->busy = true;
+            std::shared_ptr<Collection> collection = std::make_shared<Collection>();
+            collection->conn = conn;
+            collection->close = close;
+            collection->withBody = withBody;
+            collection->pending = 0;
+            collect(collection);
+        }
+        else if (index)
+        {
+            reply(conn, HttpResponse::k200Ok, "mymuduo admin\n/metrics  Prometheus text format\n", close, withBody);
+        }
+        else
+        {
+            reply(conn, HttpResponse::k404NotFound, "not found\n", close, withBody);
+        }
+    }
+}
+
+void AdminServer::collect(const std::shared_ptr<Collection> &collection)
+{
+    // [baseLoop里能直接拿到的]  连接数、计算线程池的原子计数
+    std::vector<EventLoop *> loops;
+    std::vector<size_t> serverOf; // 每个loop槽属于第几个server
+    for (size_t s = 0; s < servers_.size(); ++s)
+    {
+        TcpServer *server = servers_[s];
+        ServerSample sample;
+        sample.name = server->name();
+        sample.connections = server->numConnections();
+        sample.hasComputePool = server->computePool()->started();
+        if (sample.hasComputePool)
+        {
+            sample.compute = server->computePool()->stats();
+        }
+        collection->servers.push_back(sample);
+
+        std::vector<EventLoop *> serverLoops = server->threadPool()->getAllLoops();
+        for (size_t i = 0; i < serverLoops.size(); ++i)
+        {
+            loops.push_back(serverLoops[i]);
+            serverOf.push_back(s);
+            LoopSample loopSample;
+            loopSample.server = sample.name;
+            loopSample.index = static_cast<int>(i);
+            loopSample.connections = 0;
+            loopSample.bufferBytes = 0;
+            collection->loops.push_back(loopSample);
+        }
+    }
+
+    // [每个loop的快照在loop自己的线程里取]  连接表和Buffer都只能在那里读，topN也在那里先选一遍；
+    // 先把pending设好再投递，baseLoop自己也在列表里时runInLoop会当场执行
+    collection->pending = static_cast<int>(loops.size());
+    if (collection->pending == 0)
+    {
+        finish(collection);
+        return;
+    }
+    EventLoop *baseLoop = loop_;
+    std::shared_ptr<Inflight> inflight = inflight_;
+    for (size_t slot = 0; slot < loops.size(); ++slot)
+    {
+        EventLoop *loop = loops[slot];
+        TcpServer *server = servers_[serverOf[slot]];
+        size_t serverIndex = serverOf[slot];
+        size_t topN = topN_;
+        TcpServer::ConnectionSortKey topKey = topKey_;
+        loop->runInLoop([this, inflight, collection, slot, loop, server, serverIndex, baseLoop, topN, topKey]()
+                        {
+            {
+                std::unique_lock<std::mutex> lock(inflight->mutex);
+                if (inflight->cancelled)
+                {
+                    return; // AdminServer已经析构，server也可能不在了
+                }
+                ++inflight->running;
+            }
+            LoopMetricsSnapshot metrics = loop->metrics().snapshot();
+            std::vector<TcpConnectionPtr> conns = server->connectionsInLoop(loop);
+            size_t bufferBytes = 0;
+            for (const TcpConnectionPtr &conn : conns)
+            {
+                bufferBytes += conn->inputBuffer()->capacity() + conn->outputBuffer()->capacity();
+            }
+            size_t connections = conns.size();
+            std::vector<ConnectionStatsSnapshot> top = server->topConnectionsInLoop(loop, topN, topKey);
+            {
+                std::unique_lock<std::mutex> lock(inflight->mutex);
+                --inflight->running;
+                inflight->cond.notify_all();
+            }
+            // 这一跳在baseLoop里执行；AdminServer在baseLoop线程里析构，cancelled没置位this就还在
+            baseLoop->runInLoop([this, inflight, collection, slot, serverIndex, metrics, connections, bufferBytes, top]()
+                                {
+                {
+                    std::unique_lock<std::mutex> lock(inflight->mutex);
+                    if (inflight->cancelled)
+                    {
+                        return;
+                    }
+                }
+                LoopSample &sample = collection->loops[slot];
+                sample.metrics = metrics;
+                sample.connections = connections;
+                sample.bufferBytes = bufferBytes;
+                std::vector<ConnectionStatsSnapshot> &serverTop = collection->servers[serverIndex].top;
+                serverTop.insert(serverTop.end(), top.begin(), top.end());
+                if (--collection->pending == 0)
+                {
+                    for (ServerSample &s : collection->servers)
+                    {
+                        TcpServer::selectTopConnections(&s.top, topN_, topKey_);
+                    }
+                    finish(collection);
+                } }); });
+    }
+}
+
+// baseLoop线程
+void AdminServer::finish(const std::shared_ptr<Collection> &collection)
+{
+    const TcpConnectionPtr &conn = collection->conn;
+    if (!conn->connected())
+    {
+        return;
+    }
+    reply(conn, HttpResponse::k200Ok, format(*collection), collection->close, collection->withBody);
+    Session *session = static_cast<Session *>(conn->getContext().get());
+    session->busy = false;
+    processRequests(conn); // 采集期间可能又收到了请求
+}
+
+void AdminServer::reply(const TcpConnectionPtr &conn, int code, const std::string &body, bool close, bool withBody)
+{
+    HttpResponse response(close);
+    response.setStatusCode(static_cast<HttpResponse::HttpStatusCode>(code));
+    response.setContentType(code == HttpResponse::k200Ok ? kContentType : "text/plain");
+    response.setBody(body);
+    Buffer output;
+    response.appendToBuffer(&output, withBody);
+    conn->send(&output);
+    if (close)
+    {
+        conn->shutdown();
+    }
+}
+
+std::string AdminServer::format(const Collection &collection) const
+{
+    std::string out;
+    out.reserve(16 * 1024);
+
+    std::vector<std::string> loopLabels;
+    for (const LoopSample &s : collection.loops)
+    {
+        char buf[64];
+        snprintf(buf, sizeof buf, "\",loop=\"%d\",tid=\"%d\"", s.index, static_cast<int>(s.metrics.tid));
+        loopLabels.push_back("server=\"" + escapeLabel(s.server) + buf);
+    }
+
+    struct LoopMetric
+    {
+        const char *name;
+        const char *type;
+        const char *help;
+        double (*get)(const LoopSample &);
+    };
+    static const LoopMetric kLoopMetrics[] = {
+        {"mymuduo_loop_iterations_total", "counter", "Poll calls made by the loop.",
+         [](const LoopSample &s) { return static_cast<double>(s.metrics.iterations); }},
+        {"mymuduo_loop_poll_timeouts_total", "counter", "Polls that returned no events.",
+         [](const LoopSample &s) { return static_cast<double>(s.metrics.pollTimeouts); }},
+        {"mymuduo_loop_events_total", "counter", "Channel events handled.",
+         [](const LoopSample &s) { return static_cast<double>(s.metrics.events); }},
+        {"mymuduo_loop_max_events_per_poll", "gauge", "Most events returned by a single poll.",
+         [](const LoopSample &s) { return static_cast<double>(s.metrics.maxEventsPerPoll); }},
+        {"mymuduo_loop_poll_wait_seconds_total", "counter", "Time spent blocked in poll.",
+         [](const LoopSample &s) { return s.metrics.pollWaitUs / 1e6; }},
+        {"mymuduo_loop_handle_event_seconds_total", "counter", "Time spent in Channel::handleEvent.",
+         [](const LoopSample &s) { return s.metrics.handleEventUs / 1e6; }},
+        {"mymuduo_loop_pending_functors_seconds_total", "counter", "Time spent in doPendingFunctors.",
+         [](const LoopSample &s) { return s.metrics.pendingFunctorsUs / 1e6; }},
+        {"mymuduo_loop_functors_total", "counter", "Queued functors executed.",
+         [](const LoopSample &s) { return static_cast<double>(s.metrics.functorsRun); }},
+        {"mymuduo_loop_max_pending_depth", "gauge", "Largest batch of queued functors.",
+         [](const LoopSample &s) { return static_cast<double>(s.metrics.maxPendingDepth); }},
+        {"mymuduo_loop_queue_in_loop_total", "counter", "queueInLoop calls targeting the loop.",
+         [](const LoopSample &s) { return static_cast<double>(s.metrics.queueInLoopCalls); }},
+        {"mymuduo_loop_wakeups_sent_total", "counter", "eventfd writes targeting the loop.",
+         [](const LoopSample &s) { return static_cast<double>(s.metrics.wakeupsSent); }},
+        {"mymuduo_loop_wakeups_received_total", "counter", "eventfd reads by the loop.",
+         [](const LoopSample &s) { return static_cast<double>(s.metrics.wakeupsReceived); }},
+        {"mymuduo_loop_max_busy_microseconds", "gauge", "Longest stretch between two polls (loop lag).",
+         [](const LoopSample &s) { return static_cast<double>(s.metrics.maxBusyUs); }},
+        {"mymuduo_loop_spin_polls_total", "counter", "Non-blocking polls made inside the busy-poll budget.",
+         [](const LoopSample &s) { return static_cast<double>(s.metrics.spinPolls); }},
+        {"mymuduo_loop_spin_hits_total", "counter", "Busy polls that found work (sleep/wake avoided).",
+         [](const LoopSample &s) { return static_cast<double>(s.metrics.spinHits); }},
+        {"mymuduo_loop_spin_idle_seconds_total", "counter", "CPU time spent in busy polls that found nothing.",
+         [](const LoopSample &s) { return s.metrics.spinIdleUs / 1e6; }},
+        {"mymuduo_loop_connections", "gauge", "Connections owned by the loop.",
+         [](const LoopSample &s) { return static_cast<double>(s.connections); }},
+        {"mymuduo_loop_buffer_bytes", "gauge", "Memory held by connection input/output buffers.",
+         [](const LoopSample &s) { return static_cast<double>(s.bufferBytes); }},
+    };
+    for (const LoopMetric &metric : kLoopMetrics)
+    {
+        appendHeader(&out, metric.name, metric.type, metric.help);
+        for (size_t i = 0; i < collection.loops.size(); ++i)
+        {
+            appendSample(&out, metric.name, loopLabels[i], metric.get(collection.loops[i]));
+        }
+    }
+
+    // 每圈忙碌时间的直方图：第i个桶是[2^(i-1), 2^i)微秒，最后一个桶是溢出桶
+    appendHeader(&out, "mymuduo_loop_busy_microseconds", "histogram", "Busy time per loop iteration.");
+    for (size_t i = 0; i < collection.loops.size(); ++i)
+    {
+        const LoopMetricsSnapshot &m = collection.loops[i].metrics;
+        uint64_t cumulative = 0;
+        for (int b = 0; b < LoopMetricsSnapshot::kBuckets; ++b)
+        {
+            cumulative += m.busyUs[b];
+            char le[32];
+            if (b == LoopMetricsSnapshot::kBuckets - 1)
+                snprintf(le, sizeof le, "+Inf");
+            else
+                snprintf(le, sizeof le, "%llu", b == 0 ? 0ULL : (1ULL << b) - 1);
+            appendSample(&out, "mymuduo_loop_busy_microseconds_bucket",
+                         loopLabels[i] + ",le=\"" + le + "\"", static_cast<double>(cumulative));
+        }
+        appendSample(&out, "mymuduo_loop_busy_microseconds_sum", loopLabels[i],
+                     static_cast<double>(m.handleEventUs + m.pendingFunctorsUs));
+        appendSample(&out, "mymuduo_loop_busy_microseconds_count", loopLabels[i], static_cast<double>(cumulative));
+    }
+
+    appendHeader(&out, "mymuduo_server_connections", "gauge", "Open connections per server.");
+    for (const ServerSample &s : collection.servers)
+    {
+        appendSample(&out, "mymuduo_server_connections", "server=\"" + escapeLabel(s.name) + "\"",
+                     static_cast<double>(s.connections));
+    }
+
+    struct ComputeMetric
+    {
+        const char *name;
+        const char *type;
+        const char *help;
+        double (*get)(const ComputePool::Stats &);
+    };
+    static const ComputeMetric kComputeMetrics[] = {
+        {"mymuduo_compute_submitted_total", "counter", "Tasks accepted by the compute pool.",
+         [](const ComputePool::Stats &s) { return static_cast<double>(s.submitted); }},
+        {"mymuduo_compute_rejected_total", "counter", "Tasks rejected because the queue was full.",
+         [](const ComputePool::Stats &s) { return static_cast<double>(s.rejected); }},
+        {"mymuduo_compute_completed_total", "counter", "Tasks whose completion ran on the loop.",
+         [](const ComputePool::Stats &s) { return static_cast<double>(s.completed); }},
+        {"mymuduo_compute_queue_depth", "gauge", "Tasks waiting for a compute thread.",
+         [](const ComputePool::Stats &s) { return static_cast<double>(s.queueDepth); }},
+        {"mymuduo_compute_avg_queue_microseconds", "gauge", "Average queue wait.",
+         [](const ComputePool::Stats &s) { return s.avgQueueUs; }},
+        {"mymuduo_compute_avg_run_microseconds", "gauge", "Average task run time.",
+         [](const ComputePool::Stats &s) { return s.avgRunUs; }},
+        {"mymuduo_compute_avg_total_microseconds", "gauge", "Average submit-to-completion latency.",
+         [](const ComputePool::Stats &s) { return s.avgTotalUs; }},
+        {"mymuduo_compute_max_total_microseconds", "gauge", "Worst submit-to-completion latency.",
+         [](const ComputePool::Stats &s) { return s.maxTotalUs; }},
+    };
+    for (const ComputeMetric &metric : kComputeMetrics)
+    {
+        bool headerWritten = false;
+        for (const ServerSample &s : collection.servers)
+        {
+            if (!s.hasComputePool)
+                continue;
+            if (!headerWritten)
+            {
+                appendHeader(&out, metric.name, metric.type, metric.help);
+                headerWritten = true;
+            }
+            appendSample(&out, metric.name, "server=\"" + escapeLabel(s.name) + "\"", metric.get(s.compute));
+        }
+    }
+
+    struct ConnMetric
+    {
+        const char *name;
+        const char *type;
+        const char *help;
+        double (*get)(const ConnectionStatsSnapshot &);
+    };
+    static const ConnMetric kConnMetrics[] = {
+        {"mymuduo_top_connection_bytes_in", "gauge", "Bytes received (top connections only).",
+         [](const ConnectionStatsSnapshot &s) { return static_cast<double>(s.bytesIn); }},
+        {"mymuduo_top_connection_bytes_out", "gauge", "Bytes sent (top connections only).",
+         [](const ConnectionStatsSnapshot &s) { return static_cast<double>(s.bytesOut); }},
+        {"mymuduo_top_connection_output_queue_bytes", "gauge", "Bytes waiting in the output buffer.",
+         [](const ConnectionStatsSnapshot &s) { return static_cast<double>(s.outputQueue); }},
+        {"mymuduo_top_connection_write_blocked_seconds", "gauge", "Time spent waiting for EPOLLOUT.",
+         [](const ConnectionStatsSnapshot &s) { return s.writeBlockedUs / 1e6; }},
+        {"mymuduo_top_connection_callback_seconds", "gauge", "Time spent in the message callback.",
+         [](const ConnectionStatsSnapshot &s) { return s.callbackUs / 1e6; }},
+    };
+    for (const ConnMetric &metric : kConnMetrics)
+    {
+        appendHeader(&out, metric.name, metric.type, metric.help);
+        for (const ServerSample &server : collection.servers)
+        {
+            for (const ConnectionStatsSnapshot &s : server.top)
+            {
+                appendSample(&out, metric.name,
+                             "server=\"" + escapeLabel(server.name) + "\",conn=\"" + escapeLabel(s.name) +
+                                 "\",peer=\"" + escapeLabel(s.peer) + "\"",
+                             metric.get(s));
+            }
+        }
+    }
+    return out;
+}
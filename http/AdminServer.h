@@ -0,0 +1,92 @@
+#pragma once
+
+#include "TcpServer.h"
+#include "LoopMetrics.h"
+#include "ConnectionStats.h"
+#include "ComputePool.h"
+
+#include <condition_variable>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+
+/**
+ * [管理端口]  在baseLoop上单独监听一个端口，GET /metrics 返回Prometheus文本格式的指标：
+ * - 每个loop的LoopMetrics、连接数、连接Buffer占用的内存
+ * - 每个被监控TcpServer的连接数、计算线程池统计、topN连接
+ * 采集时给每个subloop投递一个快照任务，在subloop自己的线程里读它的连接，结果再送回baseLoop，
+ * 全部到齐之后才回复；不加锁，也不会让subloop停下来等。
+ *
+ * 被监控的TcpServer要在AdminServer之前start，且生命周期比AdminServer长。
+ * AdminServer要在baseLoop线程里析构：取消还没开始的快照任务、等正在subloop里执行的做完，已经送回baseLoop的结果直接丢弃，
+ * 析构返回以后不会再有任务访问AdminServer和被监控的TcpServer
+ */
+class AdminServer : noncopyable
+{
+public:
+    AdminServer(EventLoop *loop, const InetAddress &listenAddr, const std::string &name = std::string("admin"));
+    ~AdminServer();
+
+    // start之前调用，可以监控多个
+    void addServer(TcpServer *server) { servers_.push_back(server); }
+    void setTopConnections(size_t n, TcpServer::ConnectionSortKey key)
+    {
+        topN_ = n;
+        topKey_ = key;
+    }
+    void start() { server_.start(); }
+
+private:
+    struct LoopSample
+    {
+        std::string server;
+        int index;
+        LoopMetricsSnapshot metrics;
+        size_t connections;
+        size_t bufferBytes;
+    };
+    struct ServerSample
+    {
+        std::string name;
+        size_t connections;
+        bool hasComputePool;
+        ComputePool::Stats compute;
+        std::vector<ConnectionStatsSnapshot> top;
+    };
+    // 一次抓取的全部结果，等所有loop都回复了再输出
+    struct Collection
+    {
+        TcpConnectionPtr conn;
+        bool close;
+        bool withBody;
+        int pending;
+        std::vector<LoopSample> loops;
+        std::vector<ServerSample> servers;
+    };
+    struct Session;
+    // [投递出去的快照任务]  任务里只拿着它的shared_ptr，AdminServer析构时置cancelled并等running归零
+    struct Inflight
+    {
+        Inflight() : running(0), cancelled(false) {}
+        std::mutex mutex;
+        std::condition_variable cond;
+        int running;    // 正在subloop里取快照的任务数
+        bool cancelled; // 之后开始的任务、送回baseLoop的结果都直接返回
+    };
+
+    void onConnection(const TcpConnectionPtr &conn);
+    void onMessage(const TcpConnectionPtr &conn, Buffer *buf, Timestamp receiveTime);
+    void processRequests(const TcpConnectionPtr &conn);
+    void collect(const std::shared_ptr<Collection> &collection);
+    void finish(const std::shared_ptr<Collection> &collection);
+    void reply(const TcpConnectionPtr &conn, int code, const std::string &body, bool close, bool withBody);
+    std::string format(const Collection &collection) const;
+
+    EventLoop *loop_;
+    TcpServer server_;
+    std::vector<TcpServer *> servers_;
+    size_t topN_;
+    TcpServer::ConnectionSortKey topKey_;
+    std::shared_ptr<Inflight> inflight_;
+};
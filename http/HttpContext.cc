@@ -0,0 +1,181 @@
+#include "HttpContext.h"
+#include "Buffer.h"
+#include "SimdScan.h"
+
+#include <strings.h>
+
+namespace
+{
+    const char kCRLF[] = "\r\n";
+    const char kHeaderEnd[] = "\r\n\r\n";
+
+    bool equalsIgnoreCase(const StringPiece &a, const char *b, size_t len)
+    {
+        return a.size() == len && ::strncasecmp(a.data(), b, len) == 0;
+    }
+
+    StringPiece trim(const char *begin, const char *end)
+    {
+        while (begin < end && (*begin == ' ' || *begin == '\t'))
+            ++begin;
+        while (end > begin && (end[-1] == ' ' || end[-1] == '\t'))
+            --end;
+        return StringPiece(begin, end - begin);
+    }
+}
+
+// 请求行:  GET /index.html?a=1 HTTP/1.1
+bool HttpContext::parseRequestLine(const char *begin, const char *end)
+{
+    const char *space = simd::findChar(begin, end, ' ');
+    if (space == nullptr)
+    {
+        return false;
+    }
+    StringPiece method(begin, space - begin);
+    if (method == "GET")
+        request_.setMethod(HttpRequest::kGet);
+    else if (method == "POST")
+        request_.setMethod(HttpRequest::kPost);
+    else if (method == "HEAD")
+        request_.setMethod(HttpRequest::kHead);
+    else if (method == "PUT")
+        request_.setMethod(HttpRequest::kPut);
+    else if (method == "DELETE")
+        request_.setMethod(HttpRequest::kDelete);
+    else
+        return false;
+
+    const char *start = space + 1;
+    space = simd::findChar(start, end, ' ');
+    if (space == nullptr)
+    {
+        return false;
+    }
+    const char *question = simd::findChar(start, space, '?');
+    if (question != nullptr)
+    {
+        request_.setPath(StringPiece(start, question - start));
+        request_.setQuery(StringPiece(question + 1, space - question - 1));
+    }
+    else
+    {
+        request_.setPath(StringPiece(start, space - start));
+    }
+
+    StringPiece version(space + 1, end - space - 1);
+    if (version == "HTTP/1.1")
+        request_.setVersion(HttpRequest::kHttp11);
+    else if (version == "HTTP/1.0")
+        request_.setVersion(HttpRequest::kHttp10);
+    else
+        return false;
+    return true;
+}
+
+// [begin, end)是请求行+所有头部，不含最后的空行
+bool HttpContext::parseHeaders(const char *begin, const char *end)
+{
+    const char *lineEnd = simd::findDelim(begin, end, kCRLF, 2);
+    if (lineEnd == nullptr)
+    {
+        lineEnd = end;
+    }
+    if (!parseRequestLine(begin, lineEnd))
+    {
+        return false;
+    }
+    while (lineEnd < end)
+    {
+        const char *line = lineEnd + 2;
+        lineEnd = simd::findDelim(line, end, kCRLF, 2);
+        if (lineEnd == nullptr)
+        {
+            lineEnd = end;
+        }
+        const char *colon = simd::findChar(line, lineEnd, ':');
+        if (colon == nullptr || colon == line)
+        {
+            return false;
+        }
+        request_.addHeader(StringPiece(line, colon - line), trim(colon + 1, lineEnd));
+    }
+    return true;
+}
+
+HttpContext::ParseResult HttpContext::parseRequest(Buffer *buf, Timestamp receiveTime)
+{
+    if (state_ == kExpectHeaders)
+    {
+        // 上次已经扫描过的部分不再重复扫描，往回退3个字节防止"\r\n\r\n"被两次read切开
+        size_t resume = scanned_ > 3 ? scanned_ - 3 : 0;
+        const char *headerEnd = buf->find(buf->peek() + resume, kHeaderEnd, 4);
+        if (headerEnd == nullptr)
+        {
+            scanned_ = buf->readableBytes();
+            if (scanned_ > kMaxHeaderSize)
+            {
+                return fail(HttpResponse::k431HeaderFieldsTooLarge);
+            }
+            return kNeedMore;
+        }
+        if (!parseHeaders(buf->peek(), headerEnd))
+        {
+            return fail(HttpResponse::k400BadRequest);
+        }
+        request_.setReceiveTime(receiveTime);
+        bodyOffset_ = headerEnd + 4 - buf->peek();
+
+        if (!request_.getHeader("Transfer-Encoding").empty())
+        {
+            return fail(HttpResponse::k501NotImplemented); // 不支持分块编码的请求体
+        }
+        StringPiece contentLength = request_.getHeader("Content-Length");
+        bodyLength_ = 0;
+        for (size_t i = 0; i < contentLength.size(); ++i)
+        {
+            char c = contentLength[i];
+            if (c < '0' || c > '9')
+            {
+                return fail(HttpResponse::k400BadRequest);
+            }
+            bodyLength_ = bodyLength_ * 10 + (c - '0');
+            if (bodyLength_ > kMaxBodySize)
+            {
+                return fail(HttpResponse::k413PayloadTooLarge);
+            }
+        }
+        state_ = kExpectBody;
+        if (buf->readableBytes() < bodyOffset_ + bodyLength_)
+        {
+            // 等body期间Buffer可能扩容或者挪动数据，视图不能跨read保留：
+            // 只记住bodyOffset_/bodyLength_这两个相对peek()的偏移，body到齐后重新解析一遍头部
+            request_.reset();
+            return kNeedMore;
+        }
+    }
+    else
+    {
+        // kExpectBody
+        if (buf->readableBytes() < bodyOffset_ + bodyLength_)
+        {
+            return kNeedMore;
+        }
+        if (!parseHeaders(buf->peek(), buf->peek() + bodyOffset_ - 4))
+        {
+            return fail(HttpResponse::k400BadRequest);
+        }
+    }
+    request_.setBody(StringPiece(buf->peek() + bodyOffset_, bodyLength_));
+    return kGotRequest;
+}
+
+bool HttpContext::keepAlive() const
+{
+    StringPiece connection = request_.getHeader("Connection");
+    if (request_.version() == HttpRequest::kHttp11)
+    {
+        return !equalsIgnoreCase(connection, "close", 5);
+    }
+    return equalsIgnoreCase(connection, "keep-alive", 10);
+}
@@ -0,0 +1,72 @@
+#pragma once
+
+#include "HttpRequest.h"
+#include "HttpResponse.h"
+
+class Buffer;
+
+/**
+ * [每个连接一份的HTTP增量解析状态]  挂在TcpConnection的context上。
+ * 数据不够时记住已经扫描过的位置，下次readFd之后只扫描新来的字节；
+ * 解析出的HttpRequest里全是指向inputBuffer的视图，解析完由调用者retrieve(requestLength())
+ */
+class HttpContext
+{
+public:
+    enum ParseResult
+    {
+        kNeedMore,   // 数据还不完整，等下一次handleRead
+        kGotRequest, // 得到一个完整的请求
+        kError,      // 请求格式错误，errorCode()给出应该回复的状态码
+    };
+
+    static const size_t kMaxHeaderSize = 64 * 1024;
+    static const size_t kMaxBodySize = 64 * 1024 * 1024;
+
+    HttpContext()
+        : state_(kExpectHeaders), scanned_(0), bodyOffset_(0), bodyLength_(0),
+          errorCode_(HttpResponse::kUnknown)
+    {
+    }
+
+    ParseResult parseRequest(Buffer *buf, Timestamp receiveTime);
+
+    const HttpRequest &request() const { return request_; }
+    // [当前请求在Buffer里一共占了多少字节]  kGotRequest之后有效
+    size_t requestLength() const { return bodyOffset_ + bodyLength_; }
+    HttpResponse::HttpStatusCode errorCode() const { return errorCode_; }
+
+    // [是否保持长连接]  HTTP/1.1默认保持，HTTP/1.0默认关闭，Connection头部可以覆盖
+    bool keepAlive() const;
+
+    void reset()
+    {
+        state_ = kExpectHeaders;
+        scanned_ = 0;
+        bodyOffset_ = 0;
+        bodyLength_ = 0;
+        request_.reset();
+    }
+
+private:
+    enum State
+    {
+        kExpectHeaders,
+        kExpectBody,
+    };
+
+    bool parseHeaders(const char *begin, const char *end);
+    bool parseRequestLine(const char *begin, const char *end);
+    ParseResult fail(HttpResponse::HttpStatusCode code)
+    {
+        errorCode_ = code;
+        return kError;
+    }
+
+    State state_;
+    size_t scanned_;     // 已经扫描过、确定没有"\r\n\r\n"的字节数
+    size_t bodyOffset_;  // body相对peek()的偏移，也就是请求行+头部的长度
+    size_t bodyLength_;
+    HttpResponse::HttpStatusCode errorCode_;
+    HttpRequest request_;
+};
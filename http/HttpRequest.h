@@ -0,0 +1,118 @@
+#pragma once
+
+#include "StringPiece.h"
+#include "Timestamp.h"
+
+#include <vector>
+#include <stddef.h>
+#include <utility>
+#include <strings.h>
+
+/**
+ * [一个HTTP请求]  所有字段都是指向连接inputBuffer的StringPiece，解析过程不拷贝任何数据。
+ * 只在HttpServer回调执行期间有效，回调返回后这段数据就会被retrieve掉；
+ * 需要长期保存的字段请自己as_string()拷贝出来
+ */
+class HttpRequest
+{
+public:
+    enum Method
+    {
+        kInvalid,
+        kGet,
+        kPost,
+        kHead,
+        kPut,
+        kDelete,
+    };
+    enum Version
+    {
+        kUnknown,
+        kHttp10,
+        kHttp11,
+    };
+    using Header = std::pair<StringPiece, StringPiece>;
+    using HeaderList = std::vector<Header>;
+
+    HttpRequest()
+        : method_(kInvalid), version_(kUnknown)
+    {
+    }
+
+    void setMethod(Method method) { method_ = method; }
+    Method method() const { return method_; }
+    const char *methodString() const
+    {
+        switch (method_)
+        {
+        case kGet:
+            return "GET";
+        case kPost:
+            return "POST";
+        case kHead:
+            return "HEAD";
+        case kPut:
+            return "PUT";
+        case kDelete:
+            return "DELETE";
+        default:
+            return "UNKNOWN";
+        }
+    }
+
+    void setVersion(Version v) { version_ = v; }
+    Version version() const { return version_; }
+
+    void setPath(const StringPiece &path) { path_ = path; }
+    const StringPiece &path() const { return path_; }
+
+    void setQuery(const StringPiece &query) { query_ = query; }
+    const StringPiece &query() const { return query_; }
+
+    void setBody(const StringPiece &body) { body_ = body; }
+    const StringPiece &body() const { return body_; }
+
+    void setReceiveTime(Timestamp t) { receiveTime_ = t; }
+    Timestamp receiveTime() const { return receiveTime_; }
+
+    void addHeader(const StringPiece &field, const StringPiece &value)
+    {
+        headers_.push_back(Header(field, value));
+    }
+
+    // [头部字段名大小写不敏感]，找不到返回空的StringPiece
+    StringPiece getHeader(const StringPiece &field) const
+    {
+        for (const Header &h : headers_)
+        {
+            if (h.first.size() == field.size() &&
+                ::strncasecmp(h.first.data(), field.data(), field.size()) == 0)
+            {
+                return h.second;
+            }
+        }
+        return StringPiece();
+    }
+
+    const HeaderList &headers() const { return headers_; }
+
+    // [复用对象]  clear不释放headers_的内存，下一个请求接着用
+    void reset()
+    {
+        method_ = kInvalid;
+        version_ = kUnknown;
+        path_.clear();
+        query_.clear();
+        body_.clear();
+        headers_.clear();
+    }
+
+private:
+    Method method_;
+    Version version_;
+    StringPiece path_;
+    StringPiece query_;
+    StringPiece body_;
+    Timestamp receiveTime_;
+    HeaderList headers_;
+};
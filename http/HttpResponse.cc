@@ -0,0 +1,91 @@
+#include "HttpResponse.h"
+#include "Buffer.h"
+
+#include <stdio.h>
+
+void HttpResponse::addHeader(const StringPiece &field, const StringPiece &value)
+{
+    headers_.append(field.data(), field.size());
+    headers_.append(": ", 2);
+    headers_.append(value.data(), value.size());
+    headers_.append("\r\n", 2);
+}
+
+void HttpResponse::appendChunk(const StringPiece &data)
+{
+    if (data.empty())
+    {
+        return; // 长度为0的chunk表示结束，由appendToBuffer统一加
+    }
+    char sizeLine[32];
+    int n = snprintf(sizeLine, sizeof sizeLine, "%zx\r\n", data.size());
+    body_.append(sizeLine, n);
+    body_.append(data.data(), data.size());
+    body_.append("\r\n", 2);
+}
+
+void HttpResponse::appendToBuffer(Buffer *output, bool withBody) const
+{
+    char buf[64];
+    const char *message = statusMessage_ != nullptr ? statusMessage_ : defaultStatusMessage(statusCode_);
+    int n = snprintf(buf, sizeof buf, "HTTP/1.1 %d ", statusCode_);
+    output->append(buf, n);
+    output->append(message);
+    output->append("\r\n", 2);
+
+    if (chunked_)
+    {
+        output->append("Transfer-Encoding: chunked\r\n");
+    }
+    else
+    {
+        n = snprintf(buf, sizeof buf, "Content-Length: %zu\r\n", body_.size());
+        output->append(buf, n);
+    }
+    if (closeConnection_)
+    {
+        output->append("Connection: close\r\n");
+    }
+    else
+    {
+        output->append("Connection: Keep-Alive\r\n");
+    }
+    output->append(headers_);
+    output->append("\r\n", 2);
+
+    if (withBody)
+    {
+        output->append(body_);
+        if (chunked_)
+        {
+            output->append("0\r\n\r\n", 5);
+        }
+    }
+}
+
+const char *HttpResponse::defaultStatusMessage(HttpStatusCode code)
+{
+    switch (code)
+    {
+    case k200Ok:
+        return "OK";
+    case k204NoContent:
+        return "No Content";
+    case k301MovedPermanently:
+        return "Moved Permanently";
+    case k400BadRequest:
+        return "Bad Request";
+    case k404NotFound:
+        return "Not Found";
+    case k413PayloadTooLarge:
+        return "Payload Too Large";
+    case k431HeaderFieldsTooLarge:
+        return "Request Header Fields Too Large";
+    case k500InternalServerError:
+        return "Internal Server Error";
+    case k501NotImplemented:
+        return "Not Implemented";
+    default:
+        return "Unknown";
+    }
+}
@@ -0,0 +1,80 @@
+#pragma once
+
+#include "StringPiece.h"
+
+#include <string>
+
+class Buffer;
+
+/**
+ * [一个HTTP响应]  头部在addHeader时就序列化到headers_里，appendToBuffer直接把
+ * 状态行+头部+body写进连接的发送Buffer，不经过中间的string拼接。
+ * HttpServer每个loop线程复用一个HttpResponse对象，reset不释放内存
+ */
+class HttpResponse
+{
+public:
+    enum HttpStatusCode
+    {
+        kUnknown,
+        k200Ok = 200,
+        k204NoContent = 204,
+        k301MovedPermanently = 301,
+        k400BadRequest = 400,
+        k404NotFound = 404,
+        k413PayloadTooLarge = 413,
+        k431HeaderFieldsTooLarge = 431,
+        k500InternalServerError = 500,
+        k501NotImplemented = 501,
+    };
+
+    explicit HttpResponse(bool close = false)
+        : statusCode_(kUnknown), statusMessage_(nullptr), closeConnection_(close), chunked_(false)
+    {
+    }
+
+    void setStatusCode(HttpStatusCode code) { statusCode_ = code; }
+    HttpStatusCode statusCode() const { return statusCode_; }
+    // message需要是静态字符串，不拷贝；不设置时按状态码取默认的描述
+    void setStatusMessage(const char *message) { statusMessage_ = message; }
+
+    void setCloseConnection(bool on) { closeConnection_ = on; }
+    bool closeConnection() const { return closeConnection_; }
+
+    void setContentType(const StringPiece &contentType) { addHeader("Content-Type", contentType); }
+    void addHeader(const StringPiece &field, const StringPiece &value);
+
+    void setBody(const StringPiece &body) { body.CopyToString(&body_); }
+    const std::string &body() const { return body_; }
+
+    /**
+     * [分块传输]  不知道body总长度时用：setChunked(true)后每次appendChunk编码成一个chunk，
+     * appendToBuffer会自动加上结尾的"0\r\n\r\n"。chunk必须在HttpCallback返回之前追加完
+     */
+    void setChunked(bool on) { chunked_ = on; }
+    bool chunked() const { return chunked_; }
+    void appendChunk(const StringPiece &data);
+
+    // [序列化到output]  withBody=false用于HEAD请求：保留Content-Length但不发送body
+    void appendToBuffer(Buffer *output, bool withBody = true) const;
+
+    void reset(bool close)
+    {
+        statusCode_ = kUnknown;
+        statusMessage_ = nullptr;
+        closeConnection_ = close;
+        chunked_ = false;
+        headers_.clear();
+        body_.clear();
+    }
+
+    static const char *defaultStatusMessage(HttpStatusCode code);
+
+private:
+    HttpStatusCode statusCode_;
+    const char *statusMessage_;
+    bool closeConnection_;
+    bool chunked_;
+    std::string headers_; // 已经序列化好的 "Field: value\r\n"...
+    std::string body_;
+};
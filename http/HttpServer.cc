@@ -0,0 +1,98 @@
+#include "HttpServer.h"
+#include "HttpContext.h"
+#include "Logger.h"
+
+#include <memory>
+
+namespace
+{
+    // 没有设置回调时的默认处理
+    void defaultHttpCallback(const HttpRequest &, HttpResponse *resp)
+    {
+        resp->setStatusCode(HttpResponse::k404NotFound);
+        resp->setCloseConnection(true);
+    }
+
+    // [每个loop线程复用的发送Buffer和响应对象]  HttpCallback都在loop线程里执行，不需要加锁
+    thread_local Buffer t_output;
+    thread_local HttpResponse t_response;
+}
+
+HttpServer::HttpServer(EventLoop *loop,
+                       const InetAddress &listenAddr,
+                       const std::string &name,
+                       TcpServer::Option option)
+    : server_(loop, listenAddr, name, option),
+      httpCallback_(defaultHttpCallback)
+{
+    server_.setConnectionCallback(
+        std::bind(&HttpServer::onConnection, this, std::placeholders::_1));
+    server_.setMessageCallback(
+        std::bind(&HttpServer::onMessage, this,
+                  std::placeholders::_1, std::placeholders::_2, std::placeholders::_3));
+}
+
+void HttpServer::start()
+{
+    LOG_INFO("HttpServer starts listening\n");
+    server_.start();
+}
+
+void HttpServer::onConnection(const TcpConnectionPtr &conn)
+{
+    if (conn->connected())
+    {
+        conn->setContext(std::make_shared<HttpContext>());
+    }
+}
+
+void HttpServer::onMessage(const TcpConnectionPtr &conn, Buffer *buf, Timestamp receiveTime)
+{
+    if (!conn->connected())
+    {
+        return; // 已经决定关闭了，后面的请求丢弃
+    }
+    HttpContext *context = static_cast<HttpContext *>(conn->getContext().get());
+    Buffer &output = t_output;
+    bool close = false;
+
+    // [pipelining]  把这次读到的完整请求全部处理完
+    while (!close)
+    {
+        HttpContext::ParseResult result = context->parseRequest(buf, receiveTime);
+        if (result == HttpContext::kNeedMore)
+        {
+            break;
+        }
+
+        HttpResponse &response = t_response;
+        if (result == HttpContext::kError)
+        {
+            response.reset(true);
+            response.setStatusCode(context->errorCode());
+            response.appendToBuffer(&output);
+            buf->retrieveAll();
+            close = true;
+            break;
+        }
+
+        const HttpRequest &request = context->request();
+        response.reset(!context->keepAlive());
+        response.setStatusCode(HttpResponse::k200Ok);
+        httpCallback_(request, &response);
+        close = response.closeConnection();
+        response.appendToBuffer(&output, request.method() != HttpRequest::kHead);
+
+        buf->retrieve(context->requestLength());
+        context->reset();
+    }
+
+    if (output.readableBytes() > 0)
+    {
+        conn->send(&output); // 所有pipelined响应合并成一次发送
+    }
+    if (close)
+    {
+        conn->shutdown();
+    }
+}
@@ -0,0 +1,39 @@
+#pragma once
+
+#include "TcpServer.h"
+#include "HttpRequest.h"
+#include "HttpResponse.h"
+
+#include <functional>
+#include <string>
+
+/**
+ * [基于TcpServer的HTTP/1.1服务器]
+ * - 请求在inputBuffer上原地增量解析，HttpRequest里全是视图，不拷贝
+ * - 支持keep-alive和pipelining：一次读到的多个请求按顺序处理，
+ *   所有响应先拼到loop线程私有的Buffer里，最后一次send，通常只有一次write系统调用
+ * - HttpCallback在连接所属的subloop线程里执行
+ */
+class HttpServer : noncopyable
+{
+public:
+    using HttpCallback = std::function<void(const HttpRequest &, HttpResponse *)>;
+
+    HttpServer(EventLoop *loop,
+               const InetAddress &listenAddr,
+               const std::string &name,
+               TcpServer::Option option = TcpServer::kNoReusePort);
+
+    void setHttpCallback(const HttpCallback &cb) { httpCallback_ = cb; }
+    void setThreadNum(int numThreads) { server_.setThreadNum(numThreads); }
+    void start();
+    // 底层的TcpServer，比如交给AdminServer监控
+    TcpServer *tcpServer() { return &server_; }
+
+private:
+    void onConnection(const TcpConnectionPtr &conn);
+    void onMessage(const TcpConnectionPtr &conn, Buffer *buf, Timestamp receiveTime);
+
+    TcpServer server_;
+    HttpCallback httpCallback_;
+};
@@ -0,0 +1,203 @@
+#include "RespCodec.h"
+#include "Buffer.h"
+
+#include <algorithm>
+#include <stdio.h>
+
+namespace
+{
+    const size_t kMaxHeaderLine = 64; // "*<n>\r\n"、"$<n>\r\n"这种行不可能很长
+}
+
+/**
+ * 返回1: 解析成功，pos_移到下一行开头
+ * 返回0: 这一行还没收全
+ * 返回-1: 格式错误
+ */
+int RespParser::readLineInteger(const Buffer *buf, char prefix, int64_t *value)
+{
+    const char *base = buf->peek();
+    const size_t readable = buf->readableBytes();
+    if (pos_ >= readable)
+    {
+        return 0;
+    }
+    const char *line = base + pos_;
+    const char *crlf = buf->findCRLF(line);
+    if (crlf == nullptr)
+    {
+        return readable - pos_ > kMaxHeaderLine ? -1 : 0;
+    }
+    if (*line != prefix)
+    {
+        return -1;
+    }
+    const char *p = line + 1;
+    bool negative = false;
+    if (p < crlf && *p == '-')
+    {
+        negative = true;
+        ++p;
+    }
+    if (p == crlf)
+    {
+        return -1;
+    }
+    int64_t n = 0;
+    for (; p < crlf; ++p)
+    {
+        if (*p < '0' || *p > '9' || n > (INT64_MAX - 9) / 10)
+        {
+            return -1;
+        }
+        n = n * 10 + (*p - '0');
+    }
+    *value = negative ? -n : n;
+    pos_ = crlf + 2 - base;
+    return 1;
+}
+
+RespParser::ParseResult RespParser::parseInline(const Buffer *buf)
+{
+    const char *base = buf->peek();
+    const char *eol = buf->findEOL();
+    if (eol == nullptr)
+    {
+        if (buf->readableBytes() > kMaxInlineLength)
+        {
+            return fail("Protocol error: too big inline request");
+        }
+        return kNeedMore;
+    }
+    const char *end = (eol > base && eol[-1] == '\r') ? eol - 1 : eol;
+    const char *p = base;
+    while (p < end)
+    {
+        while (p < end && (*p == ' ' || *p == '\t'))
+            ++p;
+        const char *start = p;
+        while (p < end && *p != ' ' && *p != '\t')
+            ++p;
+        if (p > start)
+        {
+            args_.push_back(StringPiece(start, p - start));
+        }
+    }
+    pos_ = eol + 1 - base;
+    return kGotCommand;
+}
+
+RespParser::ParseResult RespParser::parse(const Buffer *buf)
+{
+    if (state_ == kStart)
+    {
+        if (buf->readableBytes() == 0)
+        {
+            return kNeedMore;
+        }
+        if (*buf->peek() != '*')
+        {
+            return parseInline(buf);
+        }
+        int r = readLineInteger(buf, '*', &argc_);
+        if (r == 0)
+        {
+            return kNeedMore;
+        }
+        if (r < 0 || argc_ > static_cast<int64_t>(kMaxArgs))
+        {
+            return fail("Protocol error: invalid multibulk length");
+        }
+        if (argc_ <= 0)
+        {
+            return kGotCommand; // 空数组，args()为空，调用者直接跳过
+        }
+        // argc_来自客户端，只预留常见命令的长度，参数真正到了再增长，避免一个十字节的头就预分配十几MB
+        offsets_.reserve(static_cast<size_t>(std::min<int64_t>(argc_, 64)));
+        state_ = kBulkHeader;
+    }
+
+    // [从上次断开的参数继续]
+    while (offsets_.size() < static_cast<size_t>(argc_))
+    {
+        if (state_ == kBulkHeader)
+        {
+            int r = readLineInteger(buf, '$', &bulkLen_);
+            if (r == 0)
+            {
+                return kNeedMore;
+            }
+            if (r < 0 || bulkLen_ < 0 || bulkLen_ > static_cast<int64_t>(kMaxBulkLength))
+            {
+                return fail("Protocol error: invalid bulk length");
+            }
+            state_ = kBulkData;
+        }
+        // kBulkData
+        if (buf->readableBytes() < pos_ + bulkLen_ + 2)
+        {
+            return kNeedMore;
+        }
+        const char *data = buf->peek() + pos_;
+        if (data[bulkLen_] != '\r' || data[bulkLen_ + 1] != '\n')
+        {
+            return fail("Protocol error: expected CRLF after bulk data");
+        }
+        offsets_.push_back(std::make_pair(pos_, static_cast<size_t>(bulkLen_)));
+        pos_ += bulkLen_ + 2;
+        state_ = kBulkHeader;
+    }
+
+    // 命令收全了，这时候才把偏移换成视图
+    const char *base = buf->peek();
+    for (const std::pair<size_t, size_t> &off : offsets_)
+    {
+        args_.push_back(StringPiece(base + off.first, off.second));
+    }
+    return kGotCommand;
+}
+
+namespace resp
+{
+    void appendSimpleString(Buffer *output, const StringPiece &str)
+    {
+        output->append("+", 1);
+        output->append(str);
+        output->append("\r\n", 2);
+    }
+
+    void appendError(Buffer *output, const StringPiece &msg)
+    {
+        output->append("-", 1);
+        output->append(msg);
+        output->append("\r\n", 2);
+    }
+
+    void appendInteger(Buffer *output, int64_t value)
+    {
+        char buf[32];
+        int n = snprintf(buf, sizeof buf, ":%lld\r\n", static_cast<long long>(value));
+        output->append(buf, n);
+    }
+
+    void appendBulkString(Buffer *output, const StringPiece &str)
+    {
+        char buf[32];
+        int n = snprintf(buf, sizeof buf, "$%zu\r\n", str.size());
+        output->append(buf, n);
+        output->append(str);
+        output->append("\r\n", 2);
+    }
+
+    void appendNullBulkString(Buffer *output)
+    {
+        output->append("$-1\r\n", 5);
+    }
+
+    void appendArrayHeader(Buffer *output, int64_t count)
+    {
+        char buf[32];
+        int n = snprintf(buf, sizeof buf, "*%lld\r\n", static_cast<long long>(count));
+        output->append(buf, n);
+    }
+}
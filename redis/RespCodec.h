@@ -0,0 +1,90 @@
+#pragma once
+
+#include "StringPiece.h"
+
+#include <vector>
+#include <stddef.h>
+#include <stdint.h>
+
+class Buffer;
+
+/**
+ * [Redis RESP协议的命令解析器]  每个连接一份，挂在TcpConnection的context上。
+ * - 增量解析：数据不完整返回kNeedMore，已经解析过的参数只记录相对peek()的偏移，
+ *   下次handleRead之后从断开的位置继续，不重新扫描，也不怕Buffer扩容搬家
+ * - 零拷贝：解析出的参数是指向inputBuffer的StringPiece，处理完调用者retrieve(frameLength())
+ * - 一次read里的多个pipelined命令由调用者循环parse依次取出
+ * 支持客户端发送的两种格式：多条bulk string组成的数组(redis-cli)和inline命令(telnet)
+ */
+class RespParser
+{
+public:
+    enum ParseResult
+    {
+        kNeedMore,
+        kGotCommand,
+        kError,
+    };
+
+    static const size_t kMaxArgs = 1024 * 1024;
+    static const size_t kMaxBulkLength = 512 * 1024 * 1024; // 和redis的proto-max-bulk-len一致
+    static const size_t kMaxInlineLength = 64 * 1024;
+
+    RespParser() { reset(); }
+
+    ParseResult parse(const Buffer *buf);
+
+    // kGotCommand之后有效，指向Buffer的视图，在retrieve之前使用
+    const std::vector<StringPiece> &args() const { return args_; }
+    size_t frameLength() const { return pos_; }
+    const char *error() const { return error_; }
+
+    void reset()
+    {
+        state_ = kStart;
+        pos_ = 0;
+        argc_ = 0;
+        bulkLen_ = -1;
+        offsets_.clear();
+        args_.clear();
+        error_ = nullptr;
+    }
+
+private:
+    enum State
+    {
+        kStart,
+        kBulkHeader, // 等 $<len>\r\n
+        kBulkData,   // 等 <data>\r\n
+    };
+
+    ParseResult parseInline(const Buffer *buf);
+    ParseResult fail(const char *msg)
+    {
+        error_ = msg;
+        return kError;
+    }
+    // 解析 <prefix><integer>\r\n，成功时把pos_移过这一行
+    int readLineInteger(const Buffer *buf, char prefix, int64_t *value);
+
+    State state_;
+    size_t pos_;     // 下一个要解析的字节相对peek()的偏移
+    int64_t argc_;
+    int64_t bulkLen_;
+    std::vector<std::pair<size_t, size_t>> offsets_; // 每个参数的(偏移, 长度)
+    std::vector<StringPiece> args_;
+    const char *error_;
+};
+
+/**
+ * [RESP回复的序列化]  直接append到发送Buffer里
+ */
+namespace resp
+{
+    void appendSimpleString(Buffer *output, const StringPiece &str); // +OK\r\n
+    void appendError(Buffer *output, const StringPiece &msg);        // -ERR msg\r\n
+    void appendInteger(Buffer *output, int64_t value);               // :1\r\n
+    void appendBulkString(Buffer *output, const StringPiece &str);   // $3\r\nfoo\r\n
+    void appendNullBulkString(Buffer *output);                       // $-1\r\n
+    void appendArrayHeader(Buffer *output, int64_t count);           // *2\r\n 后面跟count个元素
+}
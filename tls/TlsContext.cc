@@ -0,0 +1,65 @@
+#include "TlsContext.h"
+#include "TlsFilter.h"
+#include "TcpServer.h"
+#include "Logger.h"
+
+#include <openssl/err.h>
+#include <openssl/ssl.h>
+
+namespace
+{
+    void logSslErrors(const char *what)
+    {
+        unsigned long err;
+        while ((err = ERR_get_error()) != 0)
+        {
+            // 不能叫buf：LOG_ERROR宏里有同名的局部数组，会把它自己当参数传给snprintf
+            char reason[256];
+            ERR_error_string_n(err, reason, sizeof reason);
+            LOG_ERROR("%s: %s \n", what, reason);
+        }
+    }
+}
+
+TlsContext::TlsContext()
+    : ctx_(SSL_CTX_new(TLS_server_method())), kernelTls_(false)
+{
+    if (ctx_ == nullptr)
+    {
+        LOG_FATAL("SSL_CTX_new failed \n");
+    }
+    SSL_CTX_set_min_proto_version(ctx_, TLS1_2_VERSION);
+    // 内存BIO永远写得进去，SSL_write一次写完整块；outputBuffer扩容时地址会变，不能要求重试时传同一个指针
+    SSL_CTX_set_mode(ctx_, SSL_MODE_ACCEPT_MOVING_WRITE_BUFFER | SSL_MODE_RELEASE_BUFFERS);
+}
+
+TlsContext::~TlsContext()
+{
+    SSL_CTX_free(ctx_);
+}
+
+bool TlsContext::useCertificate(const std::string &certFile, const std::string &keyFile)
+{
+    if (SSL_CTX_use_certificate_chain_file(ctx_, certFile.c_str()) != 1 ||
+        SSL_CTX_use_PrivateKey_file(ctx_, keyFile.c_str(), SSL_FILETYPE_PEM) != 1 ||
+        SSL_CTX_check_private_key(ctx_) != 1)
+    {
+        logSslErrors("TlsContext::useCertificate");
+        return false;
+    }
+    return true;
+}
+
+void TlsContext::setKernelTls(bool on)
+{
+    kernelTls_ = on;
+    // 握手以后服务端发的NewSessionTicket会占用发送序号，关掉才能从0开始交给内核
+    SSL_CTX_set_num_tickets(ctx_, on ? 0 : 2);
+    SSL_CTX_set_keylog_callback(ctx_, on ? &TlsFilter::keylog : nullptr);
+}
+
+void TlsContext::enable(TcpServer *server, const std::shared_ptr<TlsContext> &context)
+{
+    server->setConnectionFilter([context]()
+                                { return std::unique_ptr<ConnectionFilter>(new TlsFilter(context)); });
+}
@@ -0,0 +1,46 @@
+#pragma once
+
+#include "noncopyable.h"
+
+#include <memory>
+#include <string>
+
+typedef struct ssl_ctx_st SSL_CTX;
+class TcpServer;
+
+/**
+ * [服务端TLS配置]  包一个SSL_CTX，所有连接共享，证书、协议版本都在这里配置。
+ * 整个tls目录只有找到OpenSSL时才编译进mymuduo，用户自己链接-lssl -lcrypto
+ *
+ *     std::shared_ptr<TlsContext> tls = std::make_shared<TlsContext>();
+ *     tls->useCertificate("server.crt", "server.key");
+ *     tls->setKernelTls(true);            // 可选
+ *     TlsContext::enable(&server, tls);   // start之前
+ *
+ * 握手完成以后才回调connectionCallback，之后的onMessage/send和明文连接一样
+ */
+class TlsContext : noncopyable
+{
+public:
+    TlsContext(); // TLS1.2及以上
+    ~TlsContext();
+
+    // PEM格式的证书链和私钥，失败打印OpenSSL的错误并返回false
+    bool useCertificate(const std::string &certFile, const std::string &keyFile);
+    /**
+     * [kTLS发送方向]  握手协商到TLS1.3 + AES-GCM、并且内核有tls模块时，把发送方向交给内核加密：
+     * send/sendfile都是明文写socket，少一次用户态加密和拷贝；接收方向仍然由OpenSSL解密。
+     * 条件不满足的连接照常走OpenSSL。打开以后不再发session ticket(要保证发送序号从0开始)
+     */
+    void setKernelTls(bool on);
+    bool kernelTls() const { return kernelTls_; }
+
+    SSL_CTX *native() const { return ctx_; }
+
+    // 给server的每个新连接挂上TLS，start之前调用
+    static void enable(TcpServer *server, const std::shared_ptr<TlsContext> &context);
+
+private:
+    SSL_CTX *ctx_;
+    bool kernelTls_;
+};
@@ -0,0 +1,344 @@
+#include "TlsFilter.h"
+#include "TlsContext.h"
+#include "Buffer.h"
+#include "Logger.h"
+
+#include <openssl/err.h>
+#include <openssl/evp.h>
+#include <openssl/kdf.h>
+#include <openssl/ssl.h>
+
+#include <atomic>
+#include <errno.h>
+#include <string.h>
+#include <unistd.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <sys/socket.h>
+#include <linux/tls.h>
+
+#ifndef SOL_TLS
+#define SOL_TLS 282
+#endif
+#ifndef TCP_ULP
+#define TCP_ULP 31
+#endif
+
+namespace
+{
+    const size_t kReadChunk = 16 * 1024; // 一个TLS记录最多16KB明文
+
+    void logSslErrors(const char *what)
+    {
+        unsigned long err;
+        while ((err = ERR_get_error()) != 0)
+        {
+            // 不能叫buf：LOG_ERROR宏里有同名的局部数组，会把它自己当参数传给snprintf
+            char reason[256];
+            ERR_error_string_n(err, reason, sizeof reason);
+            LOG_ERROR("%s: %s \n", what, reason);
+        }
+    }
+
+    bool parseHex(const char *hex, size_t len, std::string *out)
+    {
+        if (len % 2 != 0)
+        {
+            return false;
+        }
+        out->clear();
+        for (size_t i = 0; i < len; i += 2)
+        {
+            char byte[3] = {hex[i], hex[i + 1], '\0'};
+            char *end = nullptr;
+            long value = strtol(byte, &end, 16);
+            if (end != byte + 2)
+            {
+                return false;
+            }
+            out->push_back(static_cast<char>(value));
+        }
+        return true;
+    }
+
+    // RFC 8446 7.1 HKDF-Expand-Label(secret, label, "", len)
+    bool expandLabel(const EVP_MD *md, const std::string &secret, const char *label,
+                     unsigned char *out, size_t len)
+    {
+        unsigned char info[64];
+        size_t labelLen = 6 + strlen(label); // "tls13 " + label
+        size_t infoLen = 0;
+        info[infoLen++] = static_cast<unsigned char>(len >> 8);
+        info[infoLen++] = static_cast<unsigned char>(len);
+        info[infoLen++] = static_cast<unsigned char>(labelLen);
+        memcpy(info + infoLen, "tls13 ", 6);
+        memcpy(info + infoLen + 6, label, labelLen - 6);
+        infoLen += labelLen;
+        info[infoLen++] = 0; // context为空
+
+        EVP_PKEY_CTX *pctx = EVP_PKEY_CTX_new_id(EVP_PKEY_HKDF, nullptr);
+        size_t outLen = len;
+        bool ok = pctx != nullptr &&
+                  EVP_PKEY_derive_init(pctx) > 0 &&
+                  EVP_PKEY_CTX_set_hkdf_mode(pctx, EVP_PKEY_HKDEF_MODE_EXPAND_ONLY) > 0 &&
+                  EVP_PKEY_CTX_set_hkdf_md(pctx, md) > 0 &&
+                  EVP_PKEY_CTX_set1_hkdf_key(pctx, reinterpret_cast<const unsigned char *>(secret.data()),
+                                             static_cast<int>(secret.size())) > 0 &&
+                  EVP_PKEY_CTX_add1_hkdf_info(pctx, info, static_cast<int>(infoLen)) > 0 &&
+                  EVP_PKEY_derive(pctx, out, &outLen) > 0 && outLen == len;
+        EVP_PKEY_CTX_free(pctx);
+        return ok;
+    }
+
+    // 内核key/iv/salt/rec_seq的布局，AES-GCM-128和256只有key长度不同
+    template <typename CryptoInfo>
+    bool installTx(int fd, unsigned short cipherType, const EVP_MD *md, const std::string &secret)
+    {
+        CryptoInfo info;
+        memset(&info, 0, sizeof info);
+        info.info.version = TLS_1_3_VERSION;
+        info.info.cipher_type = cipherType;
+        unsigned char iv[12]; // TLS1.3的静态IV = salt(4) + iv(8)，内核按记录序号异或
+        if (!expandLabel(md, secret, "key", info.key, sizeof info.key) ||
+            !expandLabel(md, secret, "iv", iv, sizeof iv))
+        {
+            return false;
+        }
+        memcpy(info.salt, iv, sizeof info.salt);
+        memcpy(info.iv, iv + sizeof info.salt, sizeof info.iv);
+        // rec_seq全0：关了session ticket，握手完成以后还没有用应用密钥发过任何记录
+        bool ok = ::setsockopt(fd, SOL_TLS, TLS_TX, &info, sizeof info) == 0;
+        OPENSSL_cleanse(&info, sizeof info);
+        return ok;
+    }
+}
+
+TlsFilter::TlsFilter(const std::shared_ptr<TlsContext> &context)
+    : context_(context),
+      ssl_(SSL_new(context->native())),
+      rbio_(BIO_new(BIO_s_mem())),
+      wbio_(BIO_new(BIO_s_mem())),
+      established_(false),
+      kernelTx_(false),
+      shutdownSent_(false)
+{
+    if (ssl_ == nullptr || rbio_ == nullptr || wbio_ == nullptr)
+    {
+        LOG_FATAL("TlsFilter: SSL_new/BIO_new failed \n");
+    }
+    // 读空的内存BIO返回"重试"而不是EOF，SSL_get_error才会给出WANT_READ
+    BIO_set_mem_eof_return(rbio_, -1);
+    BIO_set_mem_eof_return(wbio_, -1);
+    SSL_set_bio(ssl_, rbio_, wbio_); // 两个BIO归ssl_所有
+    SSL_set_app_data(ssl_, this);
+    SSL_set_accept_state(ssl_);
+}
+
+TlsFilter::~TlsFilter()
+{
+    SSL_free(ssl_);
+    OPENSSL_cleanse(&serverSecret_[0], serverSecret_.size());
+}
+
+ssize_t TlsFilter::readFd(int fd, Buffer *input, Buffer *output, int *savedErrno)
+{
+    char extrabuf[65536]; // 和Buffer::readFd一样先读到栈上，再整块交给rbio_
+    ssize_t n = ::read(fd, extrabuf, sizeof extrabuf);
+    if (n <= 0)
+    {
+        if (n < 0)
+        {
+            *savedErrno = errno;
+        }
+        return n;
+    }
+    ERR_clear_error(); // 错误队列是线程级的，别的连接留下的错误会影响SSL_get_error
+    BIO_write(rbio_, extrabuf, static_cast<int>(n));
+
+    if (!established_)
+    {
+        int ret = SSL_do_handshake(ssl_);
+        if (ret == 1)
+        {
+            established_ = true;
+        }
+        else
+        {
+            int err = SSL_get_error(ssl_, ret);
+            if (err != SSL_ERROR_WANT_READ && err != SSL_ERROR_WANT_WRITE)
+            {
+                logSslErrors("TlsFilter handshake");
+                drainOutput(output); // 把告警发给对端
+                return 0;
+            }
+        }
+    }
+
+    // 握手完成的同一个包里可能已经带着应用数据，一直读到rbio_里不够一个完整记录
+    while (established_)
+    {
+        input->ensureWriteableBytes(kReadChunk);
+        int ret = SSL_read(ssl_, input->beginWrite(), static_cast<int>(input->writableBytes()));
+        if (ret > 0)
+        {
+            input->hasWritten(ret);
+            continue;
+        }
+        int err = SSL_get_error(ssl_, ret);
+        if (err == SSL_ERROR_WANT_READ || err == SSL_ERROR_ZERO_RETURN)
+        {
+            break; // ZERO_RETURN是对端的close_notify，接着对端就会关TCP，读到0再走关闭流程
+        }
+        logSslErrors("TlsFilter SSL_read");
+        drainOutput(output);
+        return 0;
+    }
+    return drainOutput(output) ? n : 0;
+}
+
+void TlsFilter::encode(const void *data, size_t len, Buffer *output)
+{
+    if (kernelTx_)
+    {
+        output->append(static_cast<const char *>(data), len); // 内核负责加密
+        return;
+    }
+    if (!established_)
+    {
+        LOG_ERROR("TlsFilter::encode before handshake, %zu bytes dropped \n", len);
+        return;
+    }
+    ERR_clear_error();
+    const char *p = static_cast<const char *>(data);
+    while (len > 0)
+    {
+        int chunk = len > 1024 * 1024 * 1024 ? 1024 * 1024 * 1024 : static_cast<int>(len);
+        int ret = SSL_write(ssl_, p, chunk); // 写内存BIO不会阻塞，一次写完
+        if (ret <= 0)
+        {
+            logSslErrors("TlsFilter SSL_write");
+            break;
+        }
+        p += ret;
+        len -= ret;
+    }
+    drainOutput(output);
+}
+
+void TlsFilter::encodeShutdown(Buffer *output)
+{
+    // kTLS发告警要走控制消息(cmsg)，这里直接半关闭TCP，不发close_notify
+    if (shutdownSent_ || !established_ || kernelTx_)
+    {
+        return;
+    }
+    shutdownSent_ = true;
+    ERR_clear_error();
+    SSL_shutdown(ssl_);
+    drainOutput(output);
+}
+
+bool TlsFilter::drainOutput(Buffer *output)
+{
+    size_t pending = BIO_ctrl_pending(wbio_);
+    if (pending == 0)
+    {
+        return true;
+    }
+    if (kernelTx_)
+    {
+        // 发送方向已经在内核里，OpenSSL再产生的记录(比如回应对端的KeyUpdate)没法正确加密，只能断开
+        LOG_ERROR("TlsFilter: %zu bytes of post-handshake TLS output with kTLS, closing \n", pending);
+        return false;
+    }
+    output->ensureWriteableBytes(pending);
+    int ret = BIO_read(wbio_, output->beginWrite(), static_cast<int>(pending));
+    if (ret > 0)
+    {
+        output->hasWritten(ret);
+    }
+    return true;
+}
+
+void TlsFilter::onEstablished(int fd, bool outputDrained)
+{
+    if (context_->kernelTls() && outputDrained && !serverSecret_.empty())
+    {
+        kernelTx_ = enableKernelTx(fd);
+    }
+    OPENSSL_cleanse(&serverSecret_[0], serverSecret_.size());
+    serverSecret_.clear();
+}
+
+bool TlsFilter::enableKernelTx(int fd)
+{
+    if (SSL_version(ssl_) != TLS1_3_VERSION)
+    {
+        return false;
+    }
+    const EVP_MD *md = nullptr;
+    unsigned short cipherType = 0;
+    switch (SSL_CIPHER_get_id(SSL_get_current_cipher(ssl_)))
+    {
+    case TLS1_3_CK_AES_128_GCM_SHA256:
+        md = EVP_sha256();
+        cipherType = TLS_CIPHER_AES_GCM_128;
+        break;
+    case TLS1_3_CK_AES_256_GCM_SHA384:
+        md = EVP_sha384();
+        cipherType = TLS_CIPHER_AES_GCM_256;
+        break;
+    default:
+        return false;
+    }
+
+    if (::setsockopt(fd, IPPROTO_TCP, TCP_ULP, "tls", sizeof "tls") < 0)
+    {
+        static std::atomic_bool warned(false); // 内核没有tls模块时每个连接都会失败，只报一次
+        if (!warned.exchange(true))
+        {
+            LOG_INFO("TlsFilter: kernel TLS unavailable (TCP_ULP errno=%d), using OpenSSL \n", errno);
+        }
+        return false;
+    }
+    bool ok = cipherType == TLS_CIPHER_AES_GCM_128
+                  ? installTx<tls12_crypto_info_aes_gcm_128>(fd, cipherType, md, serverSecret_)
+                  : installTx<tls12_crypto_info_aes_gcm_256>(fd, cipherType, md, serverSecret_);
+    if (!ok)
+    {
+        // 只挂了ULP没配密钥时socket照常收发明文，继续由OpenSSL加密
+        LOG_ERROR("TlsFilter: TLS_TX setsockopt failed errno=%d, using OpenSSL \n", errno);
+    }
+    return ok;
+}
+
+const char *TlsFilter::version() const
+{
+    return SSL_get_version(ssl_);
+}
+
+const char *TlsFilter::cipher() const
+{
+    return SSL_get_cipher_name(ssl_);
+}
+
+void TlsFilter::keylog(const SSL *ssl, const char *line)
+{
+    // "SERVER_TRAFFIC_SECRET_0 <client_random> <secret>"，其他密钥不需要
+    static const char kLabel[] = "SERVER_TRAFFIC_SECRET_0 ";
+    if (strncmp(line, kLabel, sizeof kLabel - 1) != 0)
+    {
+        return;
+    }
+    TlsFilter *filter = static_cast<TlsFilter *>(SSL_get_app_data(ssl));
+    const char *secret = strchr(line + sizeof kLabel - 1, ' ');
+    if (filter == nullptr || secret == nullptr)
+    {
+        return;
+    }
+    ++secret;
+    if (!parseHex(secret, strlen(secret), &filter->serverSecret_))
+    {
+        filter->serverSecret_.clear();
+    }
+}
@@ -0,0 +1,49 @@
+#pragma once
+
+#include "noncopyable.h"
+#include "ConnectionFilter.h"
+
+#include <memory>
+#include <string>
+
+typedef struct ssl_st SSL;
+typedef struct bio_st BIO;
+class TlsContext;
+
+/**
+ * [一个连接上的TLS]  OpenSSL不直接碰socket：读到的密文写进内存BIO(rbio_)，SSL_read解密到inputBuffer；
+ * SSL_write加密到内存BIO(wbio_)，再取出来交给TcpConnection的outputBuffer。
+ * 这样读写仍然是TcpConnection的非阻塞读写和高水位、auto-cork这些逻辑，TLS只是中间一层变换
+ */
+class TlsFilter : public ConnectionFilter, noncopyable
+{
+public:
+    explicit TlsFilter(const std::shared_ptr<TlsContext> &context);
+    ~TlsFilter() override;
+
+    ssize_t readFd(int fd, Buffer *input, Buffer *output, int *savedErrno) override;
+    void encode(const void *data, size_t len, Buffer *output) override;
+    void encodeShutdown(Buffer *output) override;
+    bool established() const override { return established_; }
+    void onEstablished(int fd, bool outputDrained) override;
+
+    bool kernelTx() const { return kernelTx_; } // 发送方向已经交给内核(kTLS)
+    const char *version() const;                // "TLSv1.3"
+    const char *cipher() const;                 // "TLS_AES_128_GCM_SHA256"
+
+    // TlsContext开kTLS时装到SSL_CTX上，从这里拿到TLS1.3的发送密钥
+    static void keylog(const SSL *ssl, const char *line);
+
+private:
+    bool drainOutput(Buffer *output);
+    bool enableKernelTx(int fd);
+
+    std::shared_ptr<TlsContext> context_;
+    SSL *ssl_;
+    BIO *rbio_; // 收到的密文，SSL从这里读
+    BIO *wbio_; // SSL产生的密文，drainOutput取走
+    bool established_;
+    bool kernelTx_;
+    bool shutdownSent_;
+    std::string serverSecret_; // TLS1.3的SERVER_TRAFFIC_SECRET_0，只在开了kTLS时记录，用完清掉
+};